@@ -0,0 +1,84 @@
+#include <string>
+#include "benchmark/benchmark.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_bench_fixture.h"
+
+using namespace v8;
+
+// The other benchmarks open a HandleScope per iteration, so this is also
+// their baseline.
+BENCHMARK_F(V8BenchFixture, HandleScopeOpenClose)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  for (auto _ : state) {
+    HandleScope handle_scope(isolate_);
+  }
+}
+
+// Opening and closing a HandleScope with a handle created in it, which is
+// what makes the scope allocate a handle block on first use.
+BENCHMARK_F(V8BenchFixture, HandleScopeWithHandle)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  for (auto _ : state) {
+    HandleScope handle_scope(isolate_);
+    benchmark::DoNotOptimize(Integer::New(isolate_, 4711));
+  }
+}
+
+BENCHMARK_DEFINE_F(V8BenchFixture, StringNewFromUtf8)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  // range(1) selects between ASCII and non-ASCII input, which V8 has to
+  // decode into a two-byte string.
+  std::string str;
+  while (str.size() < static_cast<size_t>(state.range(0))) {
+    str += state.range(1) ? "\xe2\x82\xac" : "a";
+  }
+  for (auto _ : state) {
+    HandleScope handle_scope(isolate_);
+    benchmark::DoNotOptimize(String::NewFromUtf8(isolate_, str.data(),
+        NewStringType::kNormal, static_cast<int>(str.size())));
+  }
+  state.SetBytesProcessed(state.iterations() * str.size());
+}
+BENCHMARK_REGISTER_F(V8BenchFixture, StringNewFromUtf8)
+    ->ArgsProduct({{16, 256, 4096, 65536}, {0, 1}})
+    ->ArgNames({"bytes", "two_byte"});
+
+BENCHMARK_DEFINE_F(V8BenchFixture, ArraySet)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  const uint32_t length = static_cast<uint32_t>(state.range(0));
+  Local<Array> array = Array::New(isolate_, static_cast<int>(length));
+  Local<Value> value = Integer::New(isolate_, 42);
+  uint32_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(array->Set(context, i, value));
+    if (++i == length) {
+      i = 0;
+    }
+  }
+}
+BENCHMARK_REGISTER_F(V8BenchFixture, ArraySet)->Arg(16)->Arg(1024)->Arg(65536);
+
+BENCHMARK_DEFINE_F(V8BenchFixture, ArrayGet)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  const uint32_t length = static_cast<uint32_t>(state.range(0));
+  Local<Array> array = Array::New(isolate_, static_cast<int>(length));
+  for (uint32_t i = 0; i < length; i++) {
+    array->Set(context, i, Integer::NewFromUnsigned(isolate_, i)).Check();
+  }
+  uint32_t i = 0;
+  for (auto _ : state) {
+    HandleScope inner_scope(isolate_);
+    benchmark::DoNotOptimize(array->Get(context, i));
+    if (++i == length) {
+      i = 0;
+    }
+  }
+}
+BENCHMARK_REGISTER_F(V8BenchFixture, ArrayGet)->Arg(16)->Arg(1024)->Arg(65536);
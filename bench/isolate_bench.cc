@@ -0,0 +1,57 @@
+#include <memory>
+#include "benchmark/benchmark.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_bench_fixture.h"
+#include "../src/bindings.h"
+#include "../src/bindings-snapshot.h"
+
+using namespace v8;
+
+BENCHMARK_F(V8BenchFixture, IsolateNew)(benchmark::State& state) {
+  for (auto _ : state) {
+    Isolate* isolate = Isolate::New(create_params_);
+    isolate->Dispose();
+  }
+}
+
+BENCHMARK_F(V8BenchFixture, ContextNew)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  for (auto _ : state) {
+    HandleScope handle_scope(isolate_);
+    benchmark::DoNotOptimize(Context::New(isolate_));
+  }
+}
+
+// Context::New with the Person and print bindings from bindings.h, which
+// is what the embedders in this repo do on startup.
+BENCHMARK_F(V8BenchFixture, ContextNewWithBindings)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  for (auto _ : state) {
+    HandleScope handle_scope(isolate_);
+    benchmark::DoNotOptimize(Context::New(isolate_, nullptr,
+                                          NewGlobalTemplate(isolate_)));
+  }
+}
+
+// The same context deserialized from a BindingsSnapshot. This needs an
+// isolate created from the snapshot, so the fixture's isolate is not used.
+BENCHMARK_F(V8BenchFixture, ContextFromSnapshot)(benchmark::State& state) {
+  static std::unique_ptr<BindingsSnapshot> snapshot = BindingsSnapshot::Create();
+  if (!snapshot) {
+    state.SkipWithError("could not create the snapshot");
+    return;
+  }
+  Isolate::CreateParams create_params;
+  create_params.array_buffer_allocator = allocator_.get();
+  snapshot->Apply(&create_params);
+  Isolate* isolate = Isolate::New(create_params);
+  {
+    Isolate::Scope isolate_scope(isolate);
+    for (auto _ : state) {
+      HandleScope handle_scope(isolate);
+      benchmark::DoNotOptimize(BindingsSnapshot::NewContext(isolate));
+    }
+  }
+  isolate->Dispose();
+}
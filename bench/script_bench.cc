@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include "benchmark/benchmark.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_bench_fixture.h"
+
+using namespace v8;
+
+// Wrapped in a function so that running it again in the same context does
+// not redeclare anything.
+static const char* kScript =
+    "(function() {\n"
+    "  function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+    "  const values = [];\n"
+    "  for (let i = 0; i < 10; i++) values.push(fib(i));\n"
+    "  return values.join(',');\n"
+    "})();\n";
+
+// Every iteration compiles a different source, by appending a comment with
+// the iteration number, so that V8's compilation cache is not hit. Creating
+// the source string is part of the timed loop.
+BENCHMARK_F(V8BenchFixture, ScriptCompile)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  char source[512];
+  size_t n = 0;
+  for (auto _ : state) {
+    HandleScope inner_scope(isolate_);
+    snprintf(source, sizeof(source), "%s// %zu\n", kScript, n++);
+    Local<String> str = String::NewFromUtf8(isolate_, source).ToLocalChecked();
+    benchmark::DoNotOptimize(Script::Compile(context, str));
+  }
+}
+
+// Compiling the same source again, which is a compilation cache lookup.
+BENCHMARK_F(V8BenchFixture, ScriptCompileCached)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  Local<String> source = String::NewFromUtf8(isolate_, kScript).ToLocalChecked();
+  for (auto _ : state) {
+    HandleScope inner_scope(isolate_);
+    benchmark::DoNotOptimize(Script::Compile(context, source));
+  }
+}
+
+BENCHMARK_F(V8BenchFixture, ScriptRun)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  Local<String> source = String::NewFromUtf8(isolate_, kScript).ToLocalChecked();
+  Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+  for (auto _ : state) {
+    HandleScope inner_scope(isolate_);
+    // Checked, so that an exception cannot pass for a run.
+    benchmark::DoNotOptimize(script->Run(context).ToLocalChecked());
+  }
+}
+
+BENCHMARK_F(V8BenchFixture, FunctionCall)(benchmark::State& state) {
+  Isolate::Scope isolate_scope(isolate_);
+  HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  Local<Function> add = RunScript(context,
+      "function add(a, b) { return a + b; }; add").As<Function>();
+  Local<Value> argv[] = {Integer::New(isolate_, 18), Integer::New(isolate_, 24)};
+  Local<Value> receiver = Undefined(isolate_);
+  for (auto _ : state) {
+    HandleScope inner_scope(isolate_);
+    benchmark::DoNotOptimize(add->Call(context, receiver, 2, argv));
+  }
+}
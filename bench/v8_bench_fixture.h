@@ -0,0 +1,66 @@
+#ifndef BENCH_V8_BENCH_FIXTURE_H_
+#define BENCH_V8_BENCH_FIXTURE_H_
+
+#include <memory>
+#include "benchmark/benchmark.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+
+// The benchmark counterpart of test/v8_test_fixture.h. V8 is initialized
+// by the first benchmark that runs and every benchmark gets a fresh isolate,
+// created and disposed outside of the timed loop. Like in the tests, the
+// benchmark enters the isolate and sets up its scopes itself:
+//
+//   BENCHMARK_F(V8BenchFixture, Something)(benchmark::State& state) {
+//     v8::Isolate::Scope isolate_scope(isolate_);
+//     v8::HandleScope handle_scope(isolate_);
+//     ...
+//     for (auto _ : state) {
+//       ...
+//     }
+//   }
+class V8BenchFixture : public ::benchmark::Fixture {
+ public:
+  // V8 can only be initialized once per process.
+  static void SetUpV8() {
+    if (platform_) {
+      return;
+    }
+    v8::V8::InitializeExternalStartupData("bench");
+    platform_ = v8::platform::NewDefaultPlatform();
+    allocator_.reset(v8::ArrayBuffer::Allocator::NewDefaultAllocator());
+    create_params_.array_buffer_allocator = allocator_.get();
+    v8::V8::InitializePlatform(platform_.get());
+    v8::V8::Initialize();
+  }
+
+  void SetUp(const ::benchmark::State& state) override {
+    SetUpV8();
+    isolate_ = v8::Isolate::New(create_params_);
+  }
+
+  void TearDown(const ::benchmark::State& state) override {
+    isolate_->Dispose();
+  }
+
+ protected:
+  static std::unique_ptr<v8::Platform> platform_;
+  static std::unique_ptr<v8::ArrayBuffer::Allocator> allocator_;
+  static v8::Isolate::CreateParams create_params_;
+  v8::Isolate* isolate_;
+
+  // Compiles and runs js in context, which must be entered.
+  static v8::Local<v8::Value> RunScript(v8::Local<v8::Context> context,
+                                        const char* js) {
+    v8::Local<v8::String> source = v8::String::NewFromUtf8(
+        context->GetIsolate(), js).ToLocalChecked();
+    return v8::Script::Compile(context, source).ToLocalChecked()
+        ->Run(context).ToLocalChecked();
+  }
+};
+
+std::unique_ptr<v8::Platform> V8BenchFixture::platform_;
+v8::Isolate::CreateParams V8BenchFixture::create_params_;
+std::unique_ptr<v8::ArrayBuffer::Allocator> V8BenchFixture::allocator_;
+
+#endif  // BENCH_V8_BENCH_FIXTURE_H_
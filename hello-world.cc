@@ -5,10 +5,13 @@
 
 #include "libplatform/libplatform.h"
 #include "v8.h"
+#include "src/fast-bindings.h"
 
 using namespace v8;
 
-int age = 41;
+// The age value is shared with the getAge/setAge functions which have Fast API
+// versions, see src/fast-bindings.h.
+int32_t& age = fast_bindings::age();
 
 void doit(const FunctionCallbackInfo<Value>& args) {
     String::Utf8Value str(args.GetIsolate(), args[0]);
@@ -33,6 +36,8 @@ void property_listener(Local<String> name, const PropertyCallbackInfo<Value>& in
 }
 
 int main(int argc, char* argv[]) {
+    // Without it TurboFan never calls the fast versions of getAge/setAge.
+    V8::SetFlagsFromString("--turbo-fast-api-calls");
     std::unique_ptr<Platform> platform = platform::NewDefaultPlatform();
     // Just sets the platform created above.
     V8::InitializePlatform(platform.get());
@@ -66,6 +71,9 @@ int main(int argc, char* argv[]) {
         global->SetAccessor(String::NewFromUtf8(isolate, "age", NewStringType::kNormal).ToLocalChecked(),
                 age_getter,
                 age_setter);
+        // getAge() and setAge(value) access the same value as the age accessor
+        // but are functions, which TurboFan can turn into direct C++ calls.
+        fast_bindings::Install(isolate, global);
         // set a named property interceptor
         //global->SetNamedPropertyHandler(property_listener);
 
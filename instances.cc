@@ -6,39 +6,11 @@
 
 #include "libplatform/libplatform.h"
 #include "v8.h"
+#include "src/bindings.h"
+#include "src/bindings-snapshot.h"
 
 using namespace v8;
 
-class Person {
-  private:
-    std::string name_;
-
-  public:
-    Person(std::string name) : name_(name) {
-    }; 
-
-    std::string name() const { 
-      return name_;
-    }
-
-};
-
-void NewPerson(const FunctionCallbackInfo<Value>& args) {
-    String::Utf8Value str(args.GetIsolate(), args[0]);
-    Person *p = new Person(*str);
-    std::cout << "Created new Person(" << p->name() << ")" << std::endl;
-    Local<Object> self = args.Holder();
-    self->SetAlignedPointerInInternalField(0, p);
-}
-
-void GetName(Local<String> property, const PropertyCallbackInfo<Value>& info) {
-  Local<Object> self = info.Holder();
-  Local<External> wrap = Local<External>::Cast(self->GetInternalField(0));
-  void* pointer = self->GetAlignedPointerFromInternalField(0);
-  const std::string value = static_cast<Person*>(pointer)->name();
-  info.GetReturnValue().Set(String::NewFromUtf8(info.GetIsolate(), value.c_str(), NewStringType::kNormal).ToLocalChecked());
-}
-
 int main(int argc, char* argv[]) {
     std::unique_ptr<Platform> platform = platform::NewDefaultPlatform();
     V8::InitializePlatform(platform.get());
@@ -46,25 +18,23 @@ int main(int argc, char* argv[]) {
 
     Isolate::CreateParams create_params;
     create_params.array_buffer_allocator = v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+    // Use the snapshot from `make bindings_snapshot.bin` if there is one.
+    std::unique_ptr<BindingsSnapshot> snapshot = BindingsSnapshot::Read("bindings_snapshot.bin");
+    if (snapshot) {
+        snapshot->Apply(&create_params);
+    }
     Isolate* isolate = Isolate::New(create_params);
     {
         Isolate::Scope isolate_scope(isolate);
         HandleScope handle_scope(isolate);
 
-        Local<ObjectTemplate> global = ObjectTemplate::New(isolate);
-
-        Local<FunctionTemplate> function_template = FunctionTemplate::New(isolate, NewPerson);
-        function_template->SetClassName(String::NewFromUtf8(isolate, "Person").ToLocalChecked());
-        function_template->InstanceTemplate()->SetInternalFieldCount(1);
-        function_template->InstanceTemplate()->SetAccessor(
-            String::NewFromUtf8(isolate, "name").ToLocalChecked(),GetName, nullptr);
-
-        Local<ObjectTemplate> person_template = ObjectTemplate::New(isolate, function_template);
-        person_template->SetInternalFieldCount(1);
-
-        global->Set(String::NewFromUtf8(isolate, "Person", NewStringType::kNormal).ToLocalChecked(), function_template);
-
-        Local<Context> context = Context::New(isolate, NULL, global);
+        // Person and print, see src/bindings.h.
+        Local<Context> context;
+        if (snapshot) {
+            context = BindingsSnapshot::NewContext(isolate).ToLocalChecked();
+        } else {
+            context = Context::New(isolate, NULL, NewGlobalTemplate(isolate));
+        }
         Context::Scope context_scope(context);
 
         const char *js = "var user = new Person('Fletch'); user.name;";
@@ -0,0 +1,39 @@
+#include <stdio.h>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+#include "src/bindings-snapshot.h"
+
+using namespace v8;
+
+// Writes a startup snapshot with the Person and print bindings installed to
+// the file given as the first argument. This is run as part of the build,
+// see the bindings_snapshot.bin target in the Makefile.
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <output file>\n", argv[0]);
+    return 1;
+  }
+  V8::InitializeExternalStartupData(argv[0]);
+  std::unique_ptr<Platform> platform = platform::NewDefaultPlatform();
+  V8::InitializePlatform(platform.get());
+  V8::Initialize();
+
+  int status = 0;
+  {
+    std::unique_ptr<BindingsSnapshot> snapshot = BindingsSnapshot::Create();
+    if (!snapshot) {
+      fprintf(stderr, "Could not create the snapshot\n");
+      status = 1;
+    } else if (!snapshot->Write(argv[1])) {
+      fprintf(stderr, "Could not write %s\n", argv[1]);
+      status = 1;
+    } else {
+      printf("Wrote %s (%d bytes)\n", argv[1], snapshot->blob()->raw_size);
+    }
+  }
+
+  V8::Dispose();
+  V8::ShutdownPlatform();
+  return status;
+}
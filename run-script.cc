@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <chrono>
 #include <iostream>
 #include <stdlib.h>
 #include <string.h>
@@ -7,157 +8,151 @@
 #include "src/objects/objects.h"
 #include "libplatform/libplatform.h"
 #include "v8.h"
+#include "src/code-cache.h"
+#include "src/mapped-source.h"
+#include "src/bindings.h"
+#include "src/bindings-snapshot.h"
+#include "src/output-sink.h"
+#include "src/streaming-compile.h"
+#include "src/event-loop.h"
+#include "src/work-stealing-platform.h"
+#include "src/instrumented-platform.h"
 
 using namespace v8;
 
 extern void _v8_internal_Print_Object(void* object);
 
-v8::MaybeLocal<v8::String> ReadFile(v8::Isolate* isolate, const char* name);
-void Print(const v8::FunctionCallbackInfo<v8::Value>& args);
-
-class Person {
-  private:
-    char* name_;
-
-  public:
-    Person(char* name) : name_(name) {
-      std::cout << "Person::Person name: " << name << '\n';
-    }; 
-
-    char* name() const { 
-      std::cout << "Person::Person name(): " << name_ << '\n';
-      return name_;
+int main(int argc, char* argv[]) {
+  const char* script_path = "/home/danielbevenius/work/google/learning-v8/script.js";
+  const char* code_cache_dir = nullptr;
+  const char* snapshot_path = nullptr;
+  bool stream = false;
+  bool default_platform = false;
+  bool task_stats = false;
+  // Flags that are not handled here are passed through to V8 and are also
+  // part of the code cache key.
+  std::string v8_flags;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--code-cache=", 13) == 0) {
+      code_cache_dir = argv[i] + 13;
+    } else if (strncmp(argv[i], "--snapshot=", 11) == 0) {
+      snapshot_path = argv[i] + 11;
+    } else if (strcmp(argv[i], "--stream") == 0) {
+      stream = true;
+    } else if (strcmp(argv[i], "--default-platform") == 0) {
+      default_platform = true;
+    } else if (strcmp(argv[i], "--task-stats") == 0) {
+      task_stats = true;
+    } else if (strncmp(argv[i], "--", 2) == 0) {
+      v8_flags += std::string(argv[i]) + " ";
+    } else {
+      script_path = argv[i];
     }
+  }
+  V8::SetFlagsFromString(v8_flags.c_str());
 
-};
-
-void NewPerson(const FunctionCallbackInfo<Value>& args) {
-    String::Utf8Value s(args.GetIsolate(), args[0]);
-    char* ss = *s;
-    std::cout << "NewPerson name: " << ss << '\n';
-    Person* p = new Person(ss);
-    HandleScope handle_scope(args.GetIsolate());
-    Local<Object> obj = args.Holder();
-    _v8_internal_Print_Object(* ((v8::internal::Object**) *obj));
-    obj->SetAlignedPointerInInternalField(0, p);
-    _v8_internal_Print_Object(* ((v8::internal::Object**) *obj));
-}
-
-void GetName(Local<String> property, const PropertyCallbackInfo<Value>& info) {
-  Local<Object> obj = info.Holder();
-  printf("Get name field count.... %d\n", obj->InternalFieldCount());
-  _v8_internal_Print_Object(* ((v8::internal::Object**) *obj));
-  void* p = obj->GetAlignedPointerFromInternalField(0);
-
-  printf("Get name.... %p\n", p);
-  Person* person = static_cast<Person*>(p);
-  printf("Get name.... %p\n", person);
-  const std::string value = person->name();
-  printf("Get name.... %s\n", value.c_str());
-  info.GetReturnValue().Set(
-      String::NewFromUtf8(info.GetIsolate(), 
-                          value.c_str(),
-                          NewStringType::kNormal).ToLocalChecked());
-}
-
-int main(int argc, char* argv[]) {
   V8::InitializeExternalStartupData(argv[0]);
 
-  std::unique_ptr<Platform> platform = platform::NewDefaultPlatform();
+  std::unique_ptr<Platform> platform;
+  if (default_platform) {
+    platform = platform::NewDefaultPlatform();
+  } else {
+    platform.reset(new WorkStealingPlatform());
+  }
+  // Records how long the platform's tasks wait and run, printed on exit.
+  InstrumentedPlatform* instrumented_platform = nullptr;
+  if (task_stats) {
+    instrumented_platform = new InstrumentedPlatform(std::move(platform));
+    platform.reset(instrumented_platform);
+  }
   V8::InitializePlatform(platform.get());
   V8::Initialize();
 
   Isolate::CreateParams create_params;
   create_params.array_buffer_allocator = v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+  // A snapshot created by mksnapshot-bindings already contains a context
+  // with the bindings installed.
+  std::unique_ptr<BindingsSnapshot> snapshot;
+  if (snapshot_path != nullptr) {
+    snapshot = BindingsSnapshot::Read(snapshot_path);
+    if (!snapshot) {
+      fprintf(stderr, "Could not read snapshot %s\n", snapshot_path);
+      return 1;
+    }
+    snapshot->Apply(&create_params);
+  }
   Isolate* isolate = Isolate::New(create_params);
   {
     Isolate::Scope isolate_scope(isolate);
     HandleScope handle_scope(isolate);
 
-    /*
-    ObjectTemplate* ot = *global;
-    v8::internal::Object** gpp = ((v8::internal::Object**)(ot));
-    v8::internal::Address* addr = (v8::internal::Address*) *gpp;
-    _v8_internal_Print_Object(addr);
-    _v8_internal_Print_Object(* ((v8::internal::Address**) *global));
-    _v8_internal_Print_Object(* ((v8::internal::Object**) *global));
-    */
-
-    Local<FunctionTemplate> function_template = FunctionTemplate::New(isolate, NewPerson);
-    function_template->SetClassName(String::NewFromUtf8(isolate, "Person").ToLocalChecked());
-    function_template->InstanceTemplate()->SetInternalFieldCount(1);
-    function_template->InstanceTemplate()->SetAccessor(String::NewFromUtf8(isolate, "name").ToLocalChecked(), GetName, nullptr);
-
-    Local<ObjectTemplate> person_template = ObjectTemplate::New(isolate, function_template);
-    person_template->SetInternalFieldCount(1);
-    person_template->SetAccessor(String::NewFromUtf8(isolate, "name").ToLocalChecked(), GetName, nullptr);
-
-    Local<ObjectTemplate> global = ObjectTemplate::New(isolate);
-    global->Set(String::NewFromUtf8(isolate, "Person", NewStringType::kNormal).ToLocalChecked(),
-        function_template);
-    global->Set(String::NewFromUtf8(isolate, "print", NewStringType::kNormal).ToLocalChecked(),
-        FunctionTemplate::New(isolate, Print));
+    // With --stream the script is read and parsed on other threads while
+    // this one sets up the context below.
+    std::unique_ptr<StreamingCompile> streaming_compile;
+    auto setup_start = std::chrono::steady_clock::now();
+    if (stream) {
+      streaming_compile.reset(
+          new StreamingCompile(isolate, platform.get(), script_path));
+      if (!streaming_compile->Start()) {
+        fprintf(stderr, "Could not open %s\n", script_path);
+        return 1;
+      }
+    }
 
-    Local<Context> context = Context::New(isolate, NULL, global);
+    Local<Context> context;
+    if (snapshot) {
+      context = BindingsSnapshot::NewContext(isolate).ToLocalChecked();
+    } else {
+      context = Context::New(isolate, NULL, NewGlobalTemplate(isolate));
+    }
     Context::Scope context_scope(context);
+    // Buffers the output of print, flushed when the script is done.
+    OutputSink output_sink(isolate);
+    // setTimeout and friends, and console.log, so that scripts like
+    // lib/task.js can run.
+    EventLoop event_loop(isolate, platform.get());
+    event_loop.Install(context);
+    InstallConsoleLog(context);
 
     //_v8_internal_Print_Object(((void*)(*global)));
 
 
-    Local<String> source = ReadFile(isolate, "/home/danielbevenius/work/google/learning-v8/script.js").ToLocalChecked();
-    MaybeLocal<Script> script = Script::Compile(context, source).ToLocalChecked();
+    MaybeLocal<Script> script;
+    std::unique_ptr<CodeCache> code_cache;
+    if (stream) {
+      std::chrono::duration<double, std::milli> setup =
+          std::chrono::steady_clock::now() - setup_start;
+      script = streaming_compile->Finish(context,
+          String::NewFromUtf8(isolate, script_path).ToLocalChecked());
+      fprintf(stderr, "streaming compile: %.3f ms, main thread busy with setup "
+          "meanwhile: %.3f ms, then blocked: %.3f ms\n",
+          streaming_compile->total_ms(), setup.count(),
+          streaming_compile->blocked_ms());
+    } else if (code_cache_dir != nullptr) {
+      Local<String> source = ReadFileMapped(isolate, script_path).ToLocalChecked();
+      code_cache.reset(new CodeCache(code_cache_dir, v8_flags));
+      script = code_cache->Compile(context, source,
+          String::NewFromUtf8(isolate, script_path).ToLocalChecked());
+      code_cache->PrintStats(stderr);
+    } else {
+      Local<String> source = ReadFileMapped(isolate, script_path).ToLocalChecked();
+      script = Script::Compile(context, source).ToLocalChecked();
+    }
     MaybeLocal<Value> result = script.ToLocalChecked()->Run(context);
+    event_loop.Run();
+    // Now that the functions the script used are compiled too.
+    if (code_cache) {
+      code_cache->Commit(script.ToLocalChecked());
+    }
   }
 
   // Dispose the isolate and tear down V8.
+  NotifyPlatformIsolateShutdown(platform.get(), isolate);
   isolate->Dispose();
+  if (instrumented_platform != nullptr) {
+    instrumented_platform->Dump(stderr);
+  }
   V8::Dispose();
   V8::ShutdownPlatform();
   return 0;
 }
-
-// Reads a file into a v8 string.
-v8::MaybeLocal<v8::String> ReadFile(v8::Isolate* isolate, const char* name) {
-  FILE* file = fopen(name, "rb");
-  if (file == NULL) {
-    return v8::MaybeLocal<v8::String>();
-  }
-
-  fseek(file, 0, SEEK_END);
-  size_t size = ftell(file);
-  rewind(file);
-
-  char* chars = new char[size + 1];
-  chars[size] = '\0';
-  for (size_t i = 0; i < size;) {
-    i += fread(&chars[i], 1, size - i, file);
-    if (ferror(file)) {
-      fclose(file);
-      return v8::MaybeLocal<v8::String>();
-    }
-  }
-  fclose(file);
-  v8::MaybeLocal<v8::String> result = v8::String::NewFromUtf8(isolate, 
-      chars, 
-      v8::NewStringType::kNormal, 
-      static_cast<int>(size));
-  delete[] chars;
-  return result;
-}
-
-void Print(const v8::FunctionCallbackInfo<v8::Value>& args) {
-  bool first = true;
-  for (int i = 0; i < args.Length(); i++) {
-    v8::HandleScope handle_scope(args.GetIsolate());
-    if (first) {
-      first = false;
-    } else {
-      printf(" ");
-    }
-    v8::String::Utf8Value str(args.GetIsolate(), args[i]);
-    printf("%s", *str);
-  }
-  printf("\n");
-  fflush(stdout);
-}
-
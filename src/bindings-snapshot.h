@@ -0,0 +1,120 @@
+#ifndef SRC_BINDINGS_SNAPSHOT_H_
+#define SRC_BINDINGS_SNAPSHOT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+
+#include "v8.h"
+#include "bindings.h"
+
+// A startup snapshot that contains a context with the Person and print
+// bindings from bindings.h already installed, so that an embedder can use
+// Context::FromSnapshot instead of building the templates on every start.
+//
+// The callbacks are not part of the snapshot, only their indices in the
+// external references array are. An isolate that uses the blob must be
+// created with the same external_references.
+class BindingsSnapshot {
+ public:
+  static const size_t kContextIndex = 0;
+
+  static const intptr_t* external_references() {
+    static const intptr_t refs[] = {
+      reinterpret_cast<intptr_t>(NewPerson),
+      reinterpret_cast<intptr_t>(GetName),
+      reinterpret_cast<intptr_t>(Print),
+      0
+    };
+    return refs;
+  }
+
+  static std::unique_ptr<BindingsSnapshot> Create() {
+    v8::StartupData blob;
+    size_t index;
+    {
+      v8::Isolate* isolate = v8::Isolate::Allocate();
+      v8::SnapshotCreator snapshot_creator(isolate, external_references());
+      {
+        v8::HandleScope scope(isolate);
+        snapshot_creator.SetDefaultContext(v8::Context::New(isolate));
+        v8::Local<v8::Context> context = v8::Context::New(isolate, nullptr,
+            NewGlobalTemplate(isolate));
+        index = snapshot_creator.AddContext(context);
+      }
+      // Nothing has been run yet so there is no compiled code worth keeping.
+      blob = snapshot_creator.CreateBlob(
+          v8::SnapshotCreator::FunctionCodeHandling::kClear);
+    }
+    if (blob.data == nullptr || index != kContextIndex) {
+      delete[] blob.data;
+      return nullptr;
+    }
+    return std::unique_ptr<BindingsSnapshot>(new BindingsSnapshot(blob));
+  }
+
+  static std::unique_ptr<BindingsSnapshot> Read(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+      return nullptr;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    if (size <= 0) {
+      fclose(file);
+      return nullptr;
+    }
+    char* data = new char[size];
+    size_t read = fread(data, 1, static_cast<size_t>(size), file);
+    fclose(file);
+    if (read != static_cast<size_t>(size)) {
+      delete[] data;
+      return nullptr;
+    }
+    v8::StartupData blob{data, static_cast<int>(size)};
+    return std::unique_ptr<BindingsSnapshot>(new BindingsSnapshot(blob));
+  }
+
+  bool Write(const char* path) const {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+      return false;
+    }
+    size_t size = static_cast<size_t>(blob_.raw_size);
+    size_t written = fwrite(blob_.data, 1, size, file);
+    fclose(file);
+    return written == size;
+  }
+
+  // Sets the snapshot blob and external references of create_params. The
+  // BindingsSnapshot must outlive isolates created with them.
+  void Apply(v8::Isolate::CreateParams* create_params) const {
+    create_params->snapshot_blob = &blob_;
+    create_params->external_references = external_references();
+  }
+
+  // Creates a context with the bindings in an isolate that was created
+  // with Apply.
+  static v8::MaybeLocal<v8::Context> NewContext(v8::Isolate* isolate) {
+    return v8::Context::FromSnapshot(isolate, kContextIndex);
+  }
+
+  const v8::StartupData* blob() const { return &blob_; }
+
+  ~BindingsSnapshot() {
+    delete[] blob_.data;
+  }
+
+ private:
+  explicit BindingsSnapshot(v8::StartupData blob) : blob_(blob) {}
+  BindingsSnapshot(const BindingsSnapshot&) = delete;
+  BindingsSnapshot& operator=(const BindingsSnapshot&) = delete;
+
+  // Mutable because CreateParams::snapshot_blob is a non-const
+  // StartupData*, though V8 only reads it.
+  mutable v8::StartupData blob_;
+};
+
+#endif  // SRC_BINDINGS_SNAPSHOT_H_
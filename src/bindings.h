@@ -0,0 +1,139 @@
+#ifndef SRC_BINDINGS_H_
+#define SRC_BINDINGS_H_
+
+#include <stdio.h>
+#include <string>
+
+#include "v8.h"
+#include "object-wrap.h"
+#include "output-sink.h"
+#include "slab-allocator.h"
+
+// The Person class and print function that the embedders in this repo
+// expose to JavaScript:
+//
+//   var p = new Person('Fletch');
+//   print(p.name);
+//
+// Person instances are owned by their JavaScript object and deleted when
+// it is garbage collected (see object-wrap.h). They are allocated from a
+// slab allocator since scripts tend to create a lot of them.
+class Person : public ObjectWrap {
+ public:
+  Person(v8::Isolate* isolate, v8::Local<v8::Object> object,
+         const std::string& name) : name_(name) {
+    Wrap(isolate, object, sizeof(Person) + name_.capacity());
+  }
+
+  const std::string& name() const { return name_; }
+
+  static void* operator new(size_t size) {
+    static_assert(sizeof(Person) <= sizeof(ObjectWrap) + sizeof(std::string),
+                  "Person does not fit in the slab allocator's slots");
+    return allocator().Allocate();
+  }
+
+  static void operator delete(void* ptr) {
+    allocator().Free(ptr);
+  }
+
+  typedef SlabAllocator<sizeof(ObjectWrap) + sizeof(std::string)> Allocator;
+
+  static Allocator& allocator() {
+    static Allocator allocator;
+    return allocator;
+  }
+
+ private:
+  std::string name_;
+};
+
+inline void NewPerson(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  v8::Isolate* isolate = args.GetIsolate();
+  if (!args.IsConstructCall()) {
+    isolate->ThrowException(v8::Exception::TypeError(
+        v8::String::NewFromUtf8Literal(isolate, "Person must be called with new")));
+    return;
+  }
+  v8::String::Utf8Value str(isolate, args[0]);
+  new Person(isolate, args.Holder(), *str);
+}
+
+inline void GetName(v8::Local<v8::String> property,
+                    const v8::PropertyCallbackInfo<v8::Value>& info) {
+  const std::string& value = ObjectWrap::Unwrap<Person>(info.Holder())->name();
+  info.GetReturnValue().Set(v8::String::NewFromUtf8(info.GetIsolate(),
+      value.c_str(), v8::NewStringType::kNormal,
+      static_cast<int>(value.size())).ToLocalChecked());
+}
+
+// Writes to the isolate's OutputSink if one has been installed and falls
+// back to printf if not.
+inline void Print(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  v8::Isolate* isolate = args.GetIsolate();
+  OutputSink* sink = OutputSink::From(isolate);
+  if (sink != nullptr) {
+    v8::HandleScope handle_scope(isolate);
+    v8::Local<v8::Context> context = isolate->GetCurrentContext();
+    for (int i = 0; i < args.Length(); i++) {
+      if (i > 0) {
+        sink->Append(" ", 1);
+      }
+      v8::Local<v8::String> str;
+      if (!args[i]->ToString(context).ToLocal(&str)) {
+        return;
+      }
+      sink->Append(str);
+    }
+    sink->Append("\n", 1);
+    return;
+  }
+
+  bool first = true;
+  for (int i = 0; i < args.Length(); i++) {
+    v8::HandleScope handle_scope(args.GetIsolate());
+    if (first) {
+      first = false;
+    } else {
+      printf(" ");
+    }
+    v8::String::Utf8Value str(args.GetIsolate(), args[i]);
+    printf("%s", *str);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+// Returns a global object template with Person and print installed.
+inline v8::Local<v8::ObjectTemplate> NewGlobalTemplate(v8::Isolate* isolate) {
+  v8::EscapableHandleScope handle_scope(isolate);
+  v8::Local<v8::FunctionTemplate> person = v8::FunctionTemplate::New(isolate, NewPerson);
+  person->SetClassName(v8::String::NewFromUtf8Literal(isolate, "Person"));
+  person->InstanceTemplate()->SetInternalFieldCount(1);
+  person->InstanceTemplate()->SetAccessor(
+      v8::String::NewFromUtf8Literal(isolate, "name"), GetName, nullptr);
+
+  v8::Local<v8::ObjectTemplate> global = v8::ObjectTemplate::New(isolate);
+  global->Set(v8::String::NewFromUtf8Literal(isolate, "Person"), person);
+  global->Set(v8::String::NewFromUtf8Literal(isolate, "print"),
+              v8::FunctionTemplate::New(isolate, Print));
+  return handle_scope.Escape(global);
+}
+
+// Makes console.log an alias of print in context. V8 creates the console
+// object but its methods do nothing unless an inspector is attached.
+inline void InstallConsoleLog(v8::Local<v8::Context> context) {
+  v8::Isolate* isolate = context->GetIsolate();
+  v8::HandleScope handle_scope(isolate);
+  v8::Local<v8::Value> console;
+  if (!context->Global()->Get(context,
+          v8::String::NewFromUtf8Literal(isolate, "console")).ToLocal(&console) ||
+      !console->IsObject()) {
+    return;
+  }
+  console.As<v8::Object>()->Set(context,
+      v8::String::NewFromUtf8Literal(isolate, "log"),
+      v8::Function::New(context, Print).ToLocalChecked()).Check();
+}
+
+#endif  // SRC_BINDINGS_H_
@@ -0,0 +1,363 @@
+#ifndef SRC_BULK_COMPILE_H_
+#define SRC_BULK_COMPILE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "v8-platform.h"
+#include "v8.h"
+
+// Compiles many scripts at once, spread over the platform's worker
+// threads, for example everything an application loads at startup.
+//
+// Each script is compiled with V8's script streaming: the parse and
+// bytecode generation happen in a ScriptStreamingTask, which can run on any
+// thread, and only the finalization has to happen on the isolate's thread.
+// The tasks are run by one v8::JobTask posted with Platform::PostJob, so
+// the platform decides how many workers to use, up to max_concurrency, and
+// the isolate's thread joins in while it waits.
+//
+// Scripts that come with a code cache from an earlier run are compiled with
+// kConsumeCodeCache on the isolate's thread instead, which is faster than
+// compiling them at all. A code cache is created for every script that did
+// not have a usable one, see code_cache().
+//
+// Scripts can name the scripts they depend on, Run binds and runs them in
+// an order where every script runs after its dependencies.
+//
+//   BulkCompile compile(isolate, platform);
+//   compile.Add("a.js", source_a);
+//   compile.Add("b.js", source_b, {"a.js"});
+//   if (!compile.Compile(context) || !compile.Run(context)) {
+//     fprintf(stderr, "%s\n", compile.error().c_str());
+//   }
+class BulkCompile {
+ public:
+  BulkCompile(v8::Isolate* isolate, v8::Platform* platform,
+              size_t max_concurrency = SIZE_MAX)
+      : isolate_(isolate), platform_(platform),
+        max_concurrency_(std::max<size_t>(max_concurrency, 1)) {}
+
+  void Add(const std::string& name, const std::string& source,
+           const std::vector<std::string>& dependencies = {},
+           std::vector<uint8_t> code_cache = {}) {
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->name = name;
+    entry->source = source;
+    entry->dependencies = dependencies;
+    entry->cache = std::move(code_cache);
+    entries_.push_back(std::move(entry));
+  }
+
+  // Compiles all scripts that were added, creating code caches for the ones
+  // that had none. context is only used to finalize streamed compilations,
+  // the results are not bound to it. Returns false, with error() set, if a
+  // script fails to compile.
+  bool Compile(v8::Local<v8::Context> context) {
+    auto start = std::chrono::steady_clock::now();
+    v8::HandleScope handle_scope(isolate_);
+    v8::Context::Scope context_scope(context);
+
+    // Streaming has to be started on the isolate's thread.
+    std::vector<Entry*> streamed;
+    for (const std::unique_ptr<Entry>& entry : entries_) {
+      if (!entry->cache.empty()) {
+        continue;
+      }
+      entry->streamed_source.reset(new v8::ScriptCompiler::StreamedSource(
+          std::unique_ptr<v8::ScriptCompiler::ExternalSourceStream>(
+              new StringSourceStream(entry->source)),
+          v8::ScriptCompiler::StreamedSource::UTF8));
+      entry->task.reset(v8::ScriptCompiler::StartStreaming(
+          isolate_, entry->streamed_source.get()));
+      streamed.push_back(entry.get());
+    }
+    if (!streamed.empty()) {
+      job_ = platform_->PostJob(v8::TaskPriority::kUserBlocking,
+          std::unique_ptr<v8::JobTask>(
+              new StreamingJob(std::move(streamed), max_concurrency_)));
+    }
+
+    // Deserializing doesn't have to wait for the workers.
+    bool ok = true;
+    for (const std::unique_ptr<Entry>& entry : entries_) {
+      if (!entry->cache.empty() && !ConsumeCache(entry.get())) {
+        ok = false;
+        break;
+      }
+    }
+
+    if (job_) {
+      job_->Join();
+      job_.reset();
+    }
+    for (const std::unique_ptr<Entry>& entry : entries_) {
+      if (!ok) {
+        break;
+      }
+      if (entry->streamed_source) {
+        ok = FinishStreaming(context, entry.get());
+      }
+    }
+    compile_ms_ = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return ok;
+  }
+
+  // Binds every compiled script to context and runs it, dependencies first.
+  // Returns false, with error() set, if the dependencies can not be
+  // satisfied or a script throws.
+  bool Run(v8::Local<v8::Context> context) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Entry*> order;
+    if (!SortByDependencies(&order)) {
+      return false;
+    }
+    v8::HandleScope handle_scope(isolate_);
+    v8::Context::Scope context_scope(context);
+    for (Entry* entry : order) {
+      v8::Local<v8::UnboundScript> unbound = entry->script.Get(isolate_);
+      if (unbound.IsEmpty()) {
+        error_ = entry->name + ": not compiled";
+        return false;
+      }
+      v8::TryCatch try_catch(isolate_);
+      if (unbound->BindToCurrentContext()->Run(context).IsEmpty()) {
+        SetError(entry->name, &try_catch);
+        return false;
+      }
+    }
+    run_ms_ = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return true;
+  }
+
+  // The code cache for script name after Compile: the one it was given if V8
+  // accepted it, a new one otherwise. Empty if there is no such script.
+  const std::vector<uint8_t>& code_cache(const std::string& name) const {
+    static const std::vector<uint8_t> empty;
+    for (const std::unique_ptr<Entry>& entry : entries_) {
+      if (entry->name == name) {
+        return entry->cache;
+      }
+    }
+    return empty;
+  }
+
+  v8::MaybeLocal<v8::UnboundScript> script(const std::string& name) const {
+    for (const std::unique_ptr<Entry>& entry : entries_) {
+      if (entry->name == name) {
+        return entry->script.Get(isolate_);
+      }
+    }
+    return v8::MaybeLocal<v8::UnboundScript>();
+  }
+
+  size_t size() const { return entries_.size(); }
+  // Scripts whose code cache was accepted.
+  size_t cache_hits() const { return cache_hits_; }
+  const std::string& error() const { return error_; }
+  double compile_ms() const { return compile_ms_; }
+  double run_ms() const { return run_ms_; }
+
+ private:
+  struct Entry {
+    std::string name;
+    std::string source;
+    std::vector<std::string> dependencies;
+    std::vector<uint8_t> cache;
+    std::unique_ptr<v8::ScriptCompiler::StreamedSource> streamed_source;
+    std::unique_ptr<v8::ScriptCompiler::ScriptStreamingTask> task;
+    v8::Global<v8::UnboundScript> script;
+  };
+
+  // Hands V8 the whole source as one chunk, which it takes ownership of.
+  class StringSourceStream : public v8::ScriptCompiler::ExternalSourceStream {
+   public:
+    explicit StringSourceStream(const std::string& source) : source_(source) {}
+
+    size_t GetMoreData(const uint8_t** src) override {
+      if (done_ || source_.empty()) {
+        return 0;
+      }
+      done_ = true;
+      uint8_t* data = new uint8_t[source_.size()];
+      memcpy(data, source_.data(), source_.size());
+      *src = data;
+      return source_.size();
+    }
+
+   private:
+    const std::string& source_;
+    bool done_ = false;
+  };
+
+  // Runs the streaming tasks, each on whichever thread takes it next.
+  class StreamingJob : public v8::JobTask {
+   public:
+    StreamingJob(std::vector<Entry*> entries, size_t max_concurrency)
+        : entries_(std::move(entries)), max_concurrency_(max_concurrency) {}
+
+    void Run(v8::JobDelegate* delegate) override {
+      while (!delegate->ShouldYield()) {
+        size_t index = next_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= entries_.size()) {
+          return;
+        }
+        entries_[index]->task->Run();
+      }
+    }
+
+    // The entries nobody has claimed yet, plus the workers that are still
+    // running one. Counting claimed but unfinished entries instead would
+    // have the platform start workers that find nothing to claim.
+    size_t GetMaxConcurrency(size_t worker_count) const override {
+      size_t next = next_.load(std::memory_order_relaxed);
+      size_t unclaimed = next < entries_.size() ? entries_.size() - next : 0;
+      return std::min(unclaimed + worker_count, max_concurrency_);
+    }
+
+   private:
+    std::vector<Entry*> entries_;
+    size_t max_concurrency_;
+    // Workers that find it past the end return, so it can overshoot.
+    std::atomic<size_t> next_{0};
+  };
+
+  bool ConsumeCache(Entry* entry) {
+    v8::Local<v8::String> source;
+    if (!NewString(entry->source).ToLocal(&source)) {
+      error_ = entry->name + ": source too large";
+      return false;
+    }
+    v8::ScriptOrigin origin(NewString(entry->name).ToLocalChecked());
+    // Source takes ownership of the CachedData, not of the buffer.
+    v8::ScriptCompiler::Source script_source(source, origin,
+        new v8::ScriptCompiler::CachedData(entry->cache.data(),
+            static_cast<int>(entry->cache.size()),
+            v8::ScriptCompiler::CachedData::BufferNotOwned));
+    v8::TryCatch try_catch(isolate_);
+    v8::Local<v8::UnboundScript> unbound;
+    if (!v8::ScriptCompiler::CompileUnboundScript(isolate_, &script_source,
+            v8::ScriptCompiler::kConsumeCodeCache).ToLocal(&unbound)) {
+      SetError(entry->name, &try_catch);
+      return false;
+    }
+    if (script_source.GetCachedData()->rejected) {
+      CreateCache(entry, unbound);
+    } else {
+      cache_hits_++;
+    }
+    entry->script.Reset(isolate_, unbound);
+    return true;
+  }
+
+  bool FinishStreaming(v8::Local<v8::Context> context, Entry* entry) {
+    v8::ScriptOrigin origin(NewString(entry->name).ToLocalChecked());
+    v8::TryCatch try_catch(isolate_);
+    v8::Local<v8::Script> script;
+    v8::Local<v8::String> source;
+    bool ok = NewString(entry->source).ToLocal(&source) &&
+        v8::ScriptCompiler::Compile(context, entry->streamed_source.get(),
+                                    source, origin).ToLocal(&script);
+    entry->task.reset();
+    entry->streamed_source.reset();
+    if (!ok) {
+      SetError(entry->name, &try_catch);
+      return false;
+    }
+    v8::Local<v8::UnboundScript> unbound = script->GetUnboundScript();
+    CreateCache(entry, unbound);
+    entry->script.Reset(isolate_, unbound);
+    return true;
+  }
+
+  static void CreateCache(Entry* entry, v8::Local<v8::UnboundScript> unbound) {
+    std::unique_ptr<v8::ScriptCompiler::CachedData> cached_data(
+        v8::ScriptCompiler::CreateCodeCache(unbound));
+    entry->cache.clear();
+    if (cached_data && cached_data->length > 0) {
+      entry->cache.assign(cached_data->data,
+                          cached_data->data + cached_data->length);
+    }
+  }
+
+  // Kahn's algorithm, keeping the order scripts were added in where the
+  // dependencies allow it.
+  bool SortByDependencies(std::vector<Entry*>* order) {
+    std::unordered_map<std::string, size_t> index;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      index[entries_[i]->name] = i;
+    }
+    std::vector<size_t> waiting_for(entries_.size(), 0);
+    std::vector<std::vector<size_t>> dependents(entries_.size());
+    for (size_t i = 0; i < entries_.size(); i++) {
+      for (const std::string& dependency : entries_[i]->dependencies) {
+        auto it = index.find(dependency);
+        if (it == index.end()) {
+          error_ = entries_[i]->name + ": unknown dependency " + dependency;
+          return false;
+        }
+        waiting_for[i]++;
+        dependents[it->second].push_back(i);
+      }
+    }
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      if (waiting_for[i] == 0) {
+        ready.push(i);
+      }
+    }
+    while (!ready.empty()) {
+      size_t i = ready.top();
+      ready.pop();
+      order->push_back(entries_[i].get());
+      for (size_t dependent : dependents[i]) {
+        if (--waiting_for[dependent] == 0) {
+          ready.push(dependent);
+        }
+      }
+    }
+    if (order->size() != entries_.size()) {
+      error_ = "dependency cycle";
+      return false;
+    }
+    return true;
+  }
+
+  v8::MaybeLocal<v8::String> NewString(const std::string& str) {
+    return v8::String::NewFromUtf8(isolate_, str.data(),
+        v8::NewStringType::kNormal, static_cast<int>(str.size()));
+  }
+
+  void SetError(const std::string& name, v8::TryCatch* try_catch) {
+    error_ = name;
+    if (try_catch->HasCaught()) {
+      v8::String::Utf8Value message(isolate_, try_catch->Exception());
+      error_ += ": ";
+      error_ += *message != nullptr ? *message : "exception";
+    }
+  }
+
+  v8::Isolate* isolate_;
+  v8::Platform* platform_;
+  size_t max_concurrency_;
+  std::vector<std::unique_ptr<Entry>> entries_;
+  std::unique_ptr<v8::JobHandle> job_;
+  size_t cache_hits_ = 0;
+  std::string error_;
+  double compile_ms_ = 0;
+  double run_ms_ = 0;
+};
+
+#endif  // SRC_BULK_COMPILE_H_
@@ -0,0 +1,197 @@
+#ifndef SRC_CODE_CACHE_H_
+#define SRC_CODE_CACHE_H_
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "v8.h"
+
+// On-disk code cache for scripts.
+//
+// The first time a script is seen it is compiled from source, and once it
+// has run Commit writes the result of ScriptCompiler::CreateCodeCache to
+// <dir>/<key>.cache. Waiting for the run means the cache also has the
+// functions that were compiled lazily while running, not just the top-level
+// code. Later runs read that file and compile with
+// ScriptCompiler::kConsumeCodeCache which lets V8 deserialize the bytecode
+// instead of parsing the source.
+//
+// The key is a hash of the V8 version, the V8 flags the embedder was started
+// with, and the source itself, so a new V8 build, different flags or an edited
+// script all end up in a new file. V8 also checks the cached data (it embeds
+// a source hash, flag hash and checksum) and sets CachedData::rejected if it
+// cannot be used, in which case the entry is recreated.
+class CodeCache {
+ public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t rejected = 0;
+  };
+
+  CodeCache(const std::string& dir, const std::string& flags = "")
+      : dir_(dir), flags_(flags) {
+    if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+      fprintf(stderr, "CodeCache: could not create %s\n", dir_.c_str());
+    }
+  }
+
+  // Compiles source, consuming a cache entry if there is one. If there was
+  // none, or V8 rejected the existing one, the entry is created by calling
+  // Commit with the returned script after running it.
+  v8::MaybeLocal<v8::Script> Compile(v8::Local<v8::Context> context,
+                                     v8::Local<v8::String> source,
+                                     v8::Local<v8::String> name) {
+    v8::Isolate* isolate = context->GetIsolate();
+    const std::string path = PathFor(isolate, source);
+    v8::ScriptOrigin origin(name);
+    pending_path_.clear();
+
+    std::vector<uint8_t> data;
+    if (ReadCacheFile(path, &data)) {
+      // Source takes ownership of the CachedData instance but not of the
+      // buffer, which stays owned by the vector.
+      v8::ScriptCompiler::CachedData* cached_data =
+          new v8::ScriptCompiler::CachedData(data.data(),
+              static_cast<int>(data.size()),
+              v8::ScriptCompiler::CachedData::BufferNotOwned);
+      v8::ScriptCompiler::Source script_source(source, origin, cached_data);
+      v8::Local<v8::Script> script;
+      if (!v8::ScriptCompiler::Compile(context, &script_source,
+              v8::ScriptCompiler::kConsumeCodeCache).ToLocal(&script)) {
+        return v8::MaybeLocal<v8::Script>();
+      }
+      if (!script_source.GetCachedData()->rejected) {
+        stats_.hits++;
+        return script;
+      }
+      stats_.rejected++;
+      unlink(path.c_str());
+      pending_path_ = path;
+      return script;
+    }
+
+    stats_.misses++;
+    v8::ScriptCompiler::Source script_source(source, origin);
+    v8::Local<v8::Script> script;
+    if (!v8::ScriptCompiler::Compile(context, &script_source).ToLocal(&script)) {
+      return v8::MaybeLocal<v8::Script>();
+    }
+    pending_path_ = path;
+    return script;
+  }
+
+  // Writes the entry for script, the one returned by the last Compile, if
+  // that was not a hit. Call it after the script has run.
+  void Commit(v8::Local<v8::Script> script) {
+    if (pending_path_.empty()) {
+      return;
+    }
+    WriteCacheFile(pending_path_, script);
+    pending_path_.clear();
+  }
+
+  const Stats& stats() const { return stats_; }
+
+  void PrintStats(FILE* out) const {
+    fprintf(out, "code cache hits: %zu, misses: %zu, rejected: %zu\n",
+        stats_.hits, stats_.misses, stats_.rejected);
+  }
+
+  std::string PathFor(v8::Isolate* isolate, v8::Local<v8::String> source) const {
+    v8::String::Utf8Value utf8(isolate, source);
+    uint64_t hash = kFnvOffsetBasis;
+    hash = Hash(hash, v8::V8::GetVersion());
+    hash = Hash(hash, flags_);
+    hash = Hash(hash, *utf8, utf8.length());
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".cache", hash);
+    return dir_ + "/" + name;
+  }
+
+ private:
+  static const uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+  static const uint64_t kFnvPrime = 0x100000001b3ULL;
+
+  // FNV-1a, which unlike std::hash is stable across builds and processes.
+  static uint64_t Hash(uint64_t hash, const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      hash ^= static_cast<uint8_t>(data[i]);
+      hash *= kFnvPrime;
+    }
+    // Separate the fields so that "ab" + "c" and "a" + "bc" differ.
+    hash ^= 0xff;
+    hash *= kFnvPrime;
+    return hash;
+  }
+
+  static uint64_t Hash(uint64_t hash, const std::string& str) {
+    return Hash(hash, str.data(), str.size());
+  }
+
+  static bool ReadCacheFile(const std::string& path, std::vector<uint8_t>* data) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    if (size <= 0) {
+      fclose(file);
+      return false;
+    }
+    data->resize(static_cast<size_t>(size));
+    size_t read = fread(data->data(), 1, data->size(), file);
+    fclose(file);
+    return read == data->size();
+  }
+
+  // Writes to a temporary file of its own first and renames it, so that a
+  // concurrent reader never sees a partially written entry and concurrent
+  // writers of the same entry do not write into each other's file.
+  static void WriteCacheFile(const std::string& path,
+                             v8::Local<v8::Script> script) {
+    std::unique_ptr<v8::ScriptCompiler::CachedData> cached_data(
+        v8::ScriptCompiler::CreateCodeCache(script->GetUnboundScript()));
+    if (!cached_data || cached_data->length <= 0) {
+      return;
+    }
+    std::string tmp_path = path + ".XXXXXX";
+    int fd = mkstemp(&tmp_path[0]);
+    if (fd < 0) {
+      return;
+    }
+    // mkstemp creates the file readable only by us.
+    fchmod(fd, 0644);
+    FILE* file = fdopen(fd, "wb");
+    if (file == nullptr) {
+      close(fd);
+      unlink(tmp_path.c_str());
+      return;
+    }
+    size_t length = static_cast<size_t>(cached_data->length);
+    size_t written = fwrite(cached_data->data, 1, length, file);
+    fclose(file);
+    if (written != length || rename(tmp_path.c_str(), path.c_str()) != 0) {
+      unlink(tmp_path.c_str());
+    }
+  }
+
+  std::string dir_;
+  std::string flags_;
+  // Where Commit writes, empty if the last Compile was a hit.
+  std::string pending_path_;
+  Stats stats_;
+};
+
+#endif  // SRC_CODE_CACHE_H_
@@ -0,0 +1,340 @@
+#ifndef SRC_EVENT_LOOP_H_
+#define SRC_EVENT_LOOP_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+#include "idle-gc-scheduler.h"
+#include "microtask-scheduler.h"
+#include "platform-message-loop.h"
+#include "task-injector.h"
+#include "timer-wheel.h"
+
+// An event loop that provides setTimeout, setInterval, clearTimeout and
+// clearInterval to JavaScript.
+//
+// Timers are kept in a TimerWheel with one tick per millisecond of
+// CLOCK_MONOTONIC, so adding and removing a timer is O(1) however many are
+// pending. Run waits in epoll_wait on a timerfd that is armed for the next
+// tick the wheel has to be advanced to, which gives sub-millisecond wakeups
+// that epoll_wait's own millisecond timeout can not.
+//
+// Every timer callback is a macrotask: the microtask queue is drained with
+// PerformMicrotaskCheckpoint after each one, so promise reactions scheduled
+// by a callback run before the next timer. Tasks that V8 posted to the
+// platform are run between macrotasks as well, and so are tasks that other
+// threads posted to a TaskInjector given to SetTaskInjector.
+//
+//   EventLoop loop(isolate, platform);
+//   loop.Install(context);
+//   script->Run(context);
+//   loop.Run();  // returns when no timers (or injector refs) are left
+class EventLoop {
+ public:
+  EventLoop(v8::Isolate* isolate, v8::Platform* platform)
+      : isolate_(isolate), platform_(platform), wheel_(NowTicks()) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = timer_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event);
+  }
+
+  ~EventLoop() {
+    for (auto& entry : timers_) {
+      wheel_.Cancel(entry.second.get());
+    }
+    timers_.clear();
+    close(timer_fd_);
+    close(epoll_fd_);
+  }
+
+  // Adds the timer functions to the global object of context. Callbacks
+  // are run in this context.
+  void Install(v8::Local<v8::Context> context) {
+    v8::HandleScope handle_scope(isolate_);
+    context_.Reset(isolate_, context);
+    v8::Local<v8::External> data = v8::External::New(isolate_, this);
+    v8::Local<v8::Object> global = context->Global();
+    SetFunction(context, global, "setTimeout", SetTimeout, data);
+    SetFunction(context, global, "setInterval", SetInterval, data);
+    SetFunction(context, global, "clearTimeout", ClearTimer, data);
+    SetFunction(context, global, "clearInterval", ClearTimer, data);
+  }
+
+  // Runs timers until there are none left or execution is terminated.
+  void Run() {
+    PerformCheckpoint();
+    while (!terminated_) {
+      RunPlatformTasks();
+      RunInjectedTasks();
+      int64_t timeout = wheel_.NextTimeout();
+      if (timeout < 0) {
+        if (injector_ == nullptr || !injector_->has_refs()) {
+          // Whatever was posted before the last Unref is visible now.
+          if (RunInjectedTasks() == 0) {
+            break;
+          }
+          continue;
+        }
+        Wait(kNoTimer);
+        continue;
+      }
+      uint64_t next = wheel_.now() + static_cast<uint64_t>(timeout);
+      if (idle_gc_ != nullptr && NowTicks() < next) {
+        idle_gc_->OnIdle(static_cast<double>(next * kNanosecondsPerTick -
+                                             NowNanoseconds()) / 1e6);
+      }
+      if (NowTicks() < next) {
+        Wait(next);
+      }
+      wheel_.Advance(NowTicks(), [this](TimerNode* node) {
+        RunTimer(static_cast<Timer*>(node));
+      });
+    }
+  }
+
+  // While waiting for the next timer, the time until it is due is given
+  // to scheduler to let V8 collect garbage.
+  void SetIdleGcScheduler(IdleGcScheduler* scheduler) {
+    idle_gc_ = scheduler;
+  }
+
+  // For a context created with MicrotaskScheduler::NewContext, whose
+  // microtasks are not on the isolate's default queue. The checkpoint after
+  // each callback then drains that queue instead.
+  void SetMicrotaskScheduler(MicrotaskScheduler* scheduler) {
+    microtasks_ = scheduler;
+  }
+
+  // Runs the tasks posted to injector as macrotasks, and keeps Run going
+  // while it has refs. injector has to outlive the loop.
+  void SetTaskInjector(TaskInjector* injector) {
+    injector_ = injector;
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = injector->fd();
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, injector->fd(), &event);
+  }
+
+  size_t pending_timers() const { return timers_.size(); }
+
+  // The current time in ticks (milliseconds) of the loop's clock.
+  static uint64_t NowTicks() {
+    return NowNanoseconds() / kNanosecondsPerTick;
+  }
+
+ private:
+  static const uint64_t kNanosecondsPerTick = 1000000;
+  static const uint64_t kNoTimer = UINT64_MAX;
+
+  struct Timer : public TimerNode {
+    uint32_t id;
+    // Zero for timers created by setTimeout.
+    uint64_t interval;
+    v8::Global<v8::Function> callback;
+    std::vector<v8::Global<v8::Value>> args;
+  };
+
+  static uint64_t NowNanoseconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 +
+           static_cast<uint64_t>(ts.tv_nsec);
+  }
+
+  static void SetFunction(v8::Local<v8::Context> context,
+                          v8::Local<v8::Object> target, const char* name,
+                          v8::FunctionCallback callback,
+                          v8::Local<v8::External> data) {
+    v8::Isolate* isolate = context->GetIsolate();
+    v8::Local<v8::Function> function =
+        v8::Function::New(context, callback, data).ToLocalChecked();
+    v8::Local<v8::String> key = v8::String::NewFromUtf8(isolate, name).ToLocalChecked();
+    function->SetName(key);
+    target->Set(context, key, function).Check();
+  }
+
+  static EventLoop* From(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    return static_cast<EventLoop*>(args.Data().As<v8::External>()->Value());
+  }
+
+  static void SetTimeout(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    From(args)->AddTimer(args, false);
+  }
+
+  static void SetInterval(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    From(args)->AddTimer(args, true);
+  }
+
+  static void ClearTimer(const v8::FunctionCallbackInfo<v8::Value>& args) {
+    EventLoop* loop = From(args);
+    if (args.Length() < 1 || !args[0]->IsNumber()) {
+      return;
+    }
+    double id = args[0].As<v8::Number>()->Value();
+    if (!(id >= 1 && id <= UINT32_MAX)) {
+      return;
+    }
+    auto it = loop->timers_.find(static_cast<uint32_t>(id));
+    if (it == loop->timers_.end()) {
+      return;
+    }
+    loop->wheel_.Cancel(it->second.get());
+    loop->timers_.erase(it);
+  }
+
+  void AddTimer(const v8::FunctionCallbackInfo<v8::Value>& args, bool repeat) {
+    v8::Local<v8::Context> context = isolate_->GetCurrentContext();
+    if (args.Length() < 1 || !args[0]->IsFunction()) {
+      isolate_->ThrowException(v8::Exception::TypeError(
+          v8::String::NewFromUtf8Literal(isolate_, "callback must be a function")));
+      return;
+    }
+    double delay = 0;
+    if (args.Length() > 1 &&
+        !args[1]->NumberValue(context).To(&delay)) {
+      return;
+    }
+    // NaN, negative and huge delays behave like they do in browsers.
+    if (!(delay >= 1) || delay > INT32_MAX) {
+      delay = repeat ? 1 : 0;
+    }
+
+    std::unique_ptr<Timer> timer(new Timer());
+    timer->id = next_id_++;
+    timer->interval = repeat ? static_cast<uint64_t>(delay) : 0;
+    timer->callback.Reset(isolate_, args[0].As<v8::Function>());
+    for (int i = 2; i < args.Length(); i++) {
+      timer->args.emplace_back(isolate_, args[i]);
+    }
+    // Round the current time up so that a timer never fires before its
+    // delay has passed.
+    uint64_t now = (NowNanoseconds() + kNanosecondsPerTick - 1) / kNanosecondsPerTick;
+    wheel_.Schedule(timer.get(), now + static_cast<uint64_t>(delay));
+    args.GetReturnValue().Set(v8::Integer::NewFromUnsigned(isolate_, timer->id));
+    timers_[timer->id] = std::move(timer);
+  }
+
+  void RunTimer(Timer* timer) {
+    if (terminated_) {
+      return;
+    }
+    v8::HandleScope handle_scope(isolate_);
+    v8::Local<v8::Context> context = context_.Get(isolate_);
+    v8::Context::Scope context_scope(context);
+    uint32_t id = timer->id;
+    bool repeat = timer->interval != 0;
+    v8::Local<v8::Function> callback = timer->callback.Get(isolate_);
+    std::vector<v8::Local<v8::Value>> argv;
+    argv.reserve(timer->args.size());
+    for (const v8::Global<v8::Value>& arg : timer->args) {
+      argv.push_back(arg.Get(isolate_));
+    }
+    // A timeout is done once it has fired. It is removed before the call
+    // so that clearTimeout on it from the callback is a no-op.
+    std::unique_ptr<Timer> done;
+    if (!repeat) {
+      auto it = timers_.find(id);
+      done = std::move(it->second);
+      timers_.erase(it);
+    }
+
+    {
+      v8::TryCatch try_catch(isolate_);
+      if (callback->Call(context, context->Global(),
+                         static_cast<int>(argv.size()), argv.data()).IsEmpty()) {
+        if (try_catch.HasTerminated()) {
+          terminated_ = true;
+          return;
+        }
+        ReportException(&try_catch);
+      }
+    }
+
+    // The interval may have been cleared by its own callback, so timer can
+    // not be used here.
+    if (repeat) {
+      auto it = timers_.find(id);
+      if (it != timers_.end()) {
+        wheel_.Schedule(it->second.get(), wheel_.now() + it->second->interval);
+      }
+    }
+    PerformCheckpoint();
+  }
+
+  void PerformCheckpoint() {
+    if (terminated_) {
+      return;
+    }
+    if (microtasks_ != nullptr) {
+      microtasks_->Checkpoint();
+    } else {
+      isolate_->PerformMicrotaskCheckpoint();
+    }
+  }
+
+  size_t RunInjectedTasks() {
+    if (injector_ == nullptr || terminated_) {
+      return 0;
+    }
+    v8::HandleScope handle_scope(isolate_);
+    v8::Context::Scope context_scope(context_.Get(isolate_));
+    return injector_->Drain([this] { PerformCheckpoint(); });
+  }
+
+  void RunPlatformTasks() {
+    while (PumpPlatformMessageLoop(platform_, isolate_)) {
+    }
+  }
+
+  // Blocks until the clock has reached tick, or kNoTimer for no time
+  // limit, or until a task has been injected.
+  void Wait(uint64_t tick) {
+    itimerspec spec = {};
+    if (tick != kNoTimer) {
+      spec.it_value.tv_sec = static_cast<time_t>(tick / 1000);
+      spec.it_value.tv_nsec = static_cast<long>((tick % 1000) * kNanosecondsPerTick);
+    }
+    timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+    epoll_event events[1];
+    while (epoll_wait(epoll_fd_, events, 1, -1) == -1 && errno == EINTR) {
+    }
+    uint64_t expirations;
+    while (read(timer_fd_, &expirations, sizeof(expirations)) == -1 &&
+           errno == EINTR) {
+    }
+  }
+
+  void ReportException(v8::TryCatch* try_catch) {
+    v8::String::Utf8Value error(isolate_, try_catch->Exception());
+    fprintf(stderr, "Uncaught %s\n", *error != nullptr ? *error : "exception");
+  }
+
+  v8::Isolate* isolate_;
+  v8::Platform* platform_;
+  v8::Global<v8::Context> context_;
+  int epoll_fd_;
+  int timer_fd_;
+  TimerWheel wheel_;
+  std::unordered_map<uint32_t, std::unique_ptr<Timer>> timers_;
+  uint32_t next_id_ = 1;
+  bool terminated_ = false;
+  IdleGcScheduler* idle_gc_ = nullptr;
+  MicrotaskScheduler* microtasks_ = nullptr;
+  TaskInjector* injector_ = nullptr;
+};
+
+#endif  // SRC_EVENT_LOOP_H_
@@ -0,0 +1,86 @@
+#ifndef SRC_FAST_BINDINGS_H_
+#define SRC_FAST_BINDINGS_H_
+
+#include <stdint.h>
+
+#include "v8.h"
+#include "v8-fast-api-calls.h"
+
+// Fast API versions of the bindings that only take and return primitive
+// values, which is the age getter and setter from hello-world.cc.
+//
+// When TurboFan optimizes a function that calls getAge/setAge it can call the
+// Fast* functions directly instead of going through the FunctionCallbackInfo
+// based Slow* callbacks. The slow callbacks are still used by the
+// interpreter and baseline code, and by TurboFan when it cannot use the fast
+// path. Fast callbacks must not allocate on the V8 heap, call into
+// JavaScript or throw. In the V8 versions this repo builds against fast
+// calls also need to be enabled with --turbo-fast-api-calls, and a fast
+// callback takes the receiver as a v8::ApiObject first, which is only the
+// address of the object, and returns void or a primitive such as int32_t.
+//
+// The call counts tell which path was taken.
+namespace fast_bindings {
+
+struct CallCounts {
+  uint64_t fast = 0;
+  uint64_t slow = 0;
+};
+
+inline CallCounts& call_counts() {
+  static CallCounts counts;
+  return counts;
+}
+
+inline int32_t& age() {
+  static int32_t value = 41;
+  return value;
+}
+
+inline int32_t FastGetAge(v8::ApiObject receiver) {
+  call_counts().fast++;
+  return age();
+}
+
+inline void SlowGetAge(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  call_counts().slow++;
+  args.GetReturnValue().Set(age());
+}
+
+inline void FastSetAge(v8::ApiObject receiver, int32_t value) {
+  call_counts().fast++;
+  age() = value;
+}
+
+inline void SlowSetAge(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  call_counts().slow++;
+  v8::Local<v8::Context> context = args.GetIsolate()->GetCurrentContext();
+  int32_t value;
+  if (args[0]->Int32Value(context).To(&value)) {
+    age() = value;
+  }
+}
+
+inline v8::Local<v8::FunctionTemplate> NewFunctionTemplate(
+    v8::Isolate* isolate, v8::FunctionCallback callback,
+    const v8::CFunction* c_function) {
+  return v8::FunctionTemplate::New(isolate, callback, v8::Local<v8::Value>(),
+      v8::Local<v8::Signature>(), 0, v8::ConstructorBehavior::kThrow,
+      v8::SideEffectType::kHasSideEffect, c_function);
+}
+
+// Installs getAge() and setAge(value) on global. Passing fast = false
+// installs only the slow callbacks, which is useful for comparing the two.
+inline void Install(v8::Isolate* isolate, v8::Local<v8::ObjectTemplate> global,
+                    bool fast = true) {
+  static const v8::CFunction fast_get_age = v8::CFunction::Make(FastGetAge);
+  static const v8::CFunction fast_set_age = v8::CFunction::Make(FastSetAge);
+  global->Set(v8::String::NewFromUtf8Literal(isolate, "getAge"),
+      NewFunctionTemplate(isolate, SlowGetAge, fast ? &fast_get_age : nullptr));
+  global->Set(v8::String::NewFromUtf8Literal(isolate, "setAge"),
+      NewFunctionTemplate(isolate, SlowSetAge, fast ? &fast_set_age : nullptr));
+}
+
+}  // namespace fast_bindings
+
+#endif  // SRC_FAST_BINDINGS_H_
@@ -0,0 +1,209 @@
+#ifndef SRC_HANDLE_REGISTRY_H_
+#define SRC_HANDLE_REGISTRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "v8.h"
+
+// Keeps the handles of many native wrappers, millions of them, without a
+// weak callback per wrapper.
+//
+// Every wrapper gets a slot in a slab of slots allocated in one piece and
+// never moved, holding a v8::Global to the JavaScript object and the native
+// pointer. A weak slot uses Global::SetWeak() without a parameter, a
+// phantom handle that V8 just clears when the object dies: no callback runs
+// in the garbage collection pause, and the pause does not grow with the
+// number of wrappers that died. V8 writes to the Global itself when it
+// clears it, which is why slots must not move.
+//
+// The finalizers run later, in batches, from ProcessWeak: after a garbage
+// collection it sweeps the slabs for weak slots that were cleared, which
+// become pending, and calls the finalizer for up to a given number of
+// pending slots, which are then free for reuse. Call it between jobs or
+// when the thread is idle.
+//
+// Handles that are still there when the registry is destroyed are reset
+// without calling the finalizer, as V8 does not run weak callbacks on
+// Dispose either, so the registry has to be destroyed before its isolate is
+// disposed. Everything must be called on the isolate's thread.
+class HandleRegistry {
+ public:
+  typedef void (*Finalizer)(void* native, void* data);
+  typedef uint32_t Id;
+
+  struct Counts {
+    size_t strong;
+    size_t weak;
+    // Collected, waiting for their finalizer.
+    size_t pending;
+  };
+
+  static const size_t kSlotsPerSlab = 4096;
+
+  HandleRegistry(v8::Isolate* isolate, Finalizer finalizer, void* data)
+      : isolate_(isolate), finalizer_(finalizer), data_(data) {
+    isolate_->AddGCEpilogueCallback(OnGC, this);
+  }
+
+  HandleRegistry(const HandleRegistry&) = delete;
+  HandleRegistry& operator=(const HandleRegistry&) = delete;
+
+  ~HandleRegistry() {
+    isolate_->RemoveGCEpilogueCallback(OnGC, this);
+  }
+
+  // Adds a strong handle to object.
+  Id Add(v8::Local<v8::Object> object, void* native) {
+    if (free_ == kNone) {
+      AddSlab();
+    }
+    Id id = free_;
+    Slot& slot = slot_at(id);
+    free_ = slot.next_free;
+    slot.handle.Reset(isolate_, object);
+    slot.native = native;
+    slot.state = kStrong;
+    counts_.strong++;
+    return id;
+  }
+
+  void MakeWeak(Id id) {
+    Slot& slot = slot_at(id);
+    if (slot.state == kStrong) {
+      slot.handle.SetWeak();
+      slot.state = kWeak;
+      counts_.strong--;
+      counts_.weak++;
+    }
+  }
+
+  // Makes a weak handle strong again, unless its object was collected.
+  bool ClearWeak(Id id) {
+    Slot& slot = slot_at(id);
+    if (slot.state != kWeak || slot.handle.IsEmpty()) {
+      return false;
+    }
+    slot.handle.ClearWeak();
+    slot.state = kStrong;
+    counts_.weak--;
+    counts_.strong++;
+    return true;
+  }
+
+  // Empty if the object was collected.
+  v8::Local<v8::Object> Get(Id id) {
+    return slot_at(id).handle.Get(isolate_);
+  }
+
+  void* native(Id id) { return slot_at(id).native; }
+
+  // Frees the slot without calling the finalizer.
+  void Remove(Id id) {
+    Slot& slot = slot_at(id);
+    switch (slot.state) {
+      case kStrong: counts_.strong--; break;
+      case kWeak: counts_.weak--; break;
+      // A pending slot is freed when its turn comes in ProcessWeak.
+      case kPending: slot.native = nullptr; return;
+      case kFree: return;
+    }
+    Free(id);
+  }
+
+  // Sweeps for collected weak handles if there was a garbage collection
+  // since the last sweep, then finalizes up to max_finalized pending ones.
+  // Returns how many were finalized.
+  size_t ProcessWeak(size_t max_finalized = SIZE_MAX) {
+    if (swept_gc_count_ != gc_count_) {
+      swept_gc_count_ = gc_count_;
+      Sweep();
+    }
+    size_t finalized = 0;
+    while (finalized < max_finalized && !pending_.empty()) {
+      Id id = pending_.back();
+      pending_.pop_back();
+      void* native = slot_at(id).native;
+      counts_.pending--;
+      Free(id);
+      if (native != nullptr) {
+        finalizer_(native, data_);
+        finalized++;
+      }
+    }
+    return finalized;
+  }
+
+  // Pending only counts handles found by a sweep.
+  Counts counts() const { return counts_; }
+  size_t capacity() const { return slabs_.size() * kSlotsPerSlab; }
+
+ private:
+  enum State : uint8_t { kFree, kStrong, kWeak, kPending };
+  static const Id kNone = UINT32_MAX;
+
+  struct Slot {
+    v8::Global<v8::Object> handle;
+    void* native = nullptr;
+    Id next_free = kNone;
+    State state = kFree;
+  };
+
+  static void OnGC(v8::Isolate* isolate, v8::GCType type,
+                   v8::GCCallbackFlags flags, void* data) {
+    static_cast<HandleRegistry*>(data)->gc_count_++;
+  }
+
+  Slot& slot_at(Id id) {
+    return slabs_[id / kSlotsPerSlab][id % kSlotsPerSlab];
+  }
+
+  void AddSlab() {
+    Id first = static_cast<Id>(slabs_.size() * kSlotsPerSlab);
+    slabs_.emplace_back(new Slot[kSlotsPerSlab]);
+    Slot* slab = slabs_.back().get();
+    // Handed out in order, so that wrappers made together are together.
+    for (size_t i = kSlotsPerSlab; i-- > 0;) {
+      slab[i].next_free = free_;
+      free_ = first + static_cast<Id>(i);
+    }
+  }
+
+  void Sweep() {
+    for (size_t s = 0; s < slabs_.size(); s++) {
+      Slot* slab = slabs_[s].get();
+      for (size_t i = 0; i < kSlotsPerSlab; i++) {
+        if (slab[i].state == kWeak && slab[i].handle.IsEmpty()) {
+          slab[i].state = kPending;
+          counts_.weak--;
+          counts_.pending++;
+          pending_.push_back(static_cast<Id>(s * kSlotsPerSlab + i));
+        }
+      }
+    }
+  }
+
+  void Free(Id id) {
+    Slot& slot = slot_at(id);
+    slot.handle.Reset();
+    slot.native = nullptr;
+    slot.state = kFree;
+    slot.next_free = free_;
+    free_ = id;
+  }
+
+  v8::Isolate* isolate_;
+  Finalizer finalizer_;
+  void* data_;
+  std::vector<std::unique_ptr<Slot[]>> slabs_;
+  Id free_ = kNone;
+  std::vector<Id> pending_;
+  Counts counts_ = {0, 0, 0};
+  uint64_t gc_count_ = 0;
+  uint64_t swept_gc_count_ = 0;
+};
+
+#endif  // SRC_HANDLE_REGISTRY_H_
@@ -0,0 +1,218 @@
+#ifndef SRC_HEAP_CONTROLLER_H_
+#define SRC_HEAP_CONTROLLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+
+#include "v8.h"
+
+// Sizes an isolate's heap for its tenant instead of leaving it at V8's
+// defaults, which either hold on to far more memory than a worker needs or
+// end in V8's fatal out of memory error, taking down the whole process.
+//
+// The isolate starts with a small heap limit, set through the
+// ResourceConstraints in its CreateParams by Configure. When V8 is about to
+// run out of heap it calls the near heap limit callback, and the controller
+// raises the limit by another extension as long as that stays within the
+// tenant's budget. Once the budget is used up it calls TerminateExecution,
+// and gives V8 some headroom to unwind the script with, up to
+// max_termination_headroom in all; the script then fails as terminated, as
+// with a watchdog, and the isolate can be used again after TakeTermination.
+// A script that still needs more than that while unwinding hits V8's out of
+// memory error after all.
+//
+// The limits are all for the old generation, which is the limit the near
+// heap limit callback is given and returns. The young generation comes on
+// top of them, at the size V8 picks for it.
+//
+// Limits do not come down by themselves. Sample, called between jobs,
+// lowers the limit back towards the initial one when the used heap has
+// stayed below a fraction of it for a number of samples in a row. V8 does
+// not lower it below the live size plus a quarter.
+//
+// Every decision is logged with the heap statistics it was based on, to
+// Options::log, unless that is nullptr. All of it runs on the isolate's
+// thread, the callback during garbage collection.
+class HeapController {
+ public:
+  struct Options {
+    // The old generation limit the isolate starts with.
+    size_t initial_limit = 64 << 20;
+    // The tenant's budget, the limit is never raised above it.
+    size_t max_limit = 512 << 20;
+    size_t extension = 32 << 20;
+    // Granted once the budget is used up so that termination does not run
+    // out of heap itself, and again each time V8 comes near the limit while
+    // unwinding, up to max_termination_headroom in all.
+    size_t termination_headroom = 8 << 20;
+    size_t max_termination_headroom = 16 << 20;
+    // Used heap as a fraction of the limit below which it counts as low,
+    // and for how many samples in a row it has to be before shrinking.
+    double shrink_usage = 0.25;
+    int shrink_after = 5;
+    FILE* log = stderr;
+  };
+
+  struct Stats {
+    uint64_t extensions;
+    uint64_t terminations;
+    uint64_t shrinks;
+  };
+
+  // Sets the old generation limit in params, for Isolate::New.
+  static void Configure(v8::Isolate::CreateParams* params,
+                        const Options& options) {
+    params->constraints.set_max_old_generation_size_in_bytes(
+        options.initial_limit);
+  }
+
+  explicit HeapController(v8::Isolate* isolate)
+      : HeapController(isolate, Options()) {}
+
+  HeapController(v8::Isolate* isolate, const Options& options)
+      : isolate_(isolate), options_(options) {
+    isolate_->AddNearHeapLimitCallback(NearHeapLimit, this);
+  }
+
+  HeapController(const HeapController&) = delete;
+  HeapController& operator=(const HeapController&) = delete;
+
+  ~HeapController() {
+    // 0 leaves the limit as it is.
+    isolate_->RemoveNearHeapLimitCallback(NearHeapLimit, 0);
+  }
+
+  // Looks at the heap and lowers the limit if it has been mostly unused for
+  // a while. Call it between jobs, with no JavaScript running. Returns true
+  // if the limit was lowered.
+  bool Sample() {
+    if (limit_ <= initial_limit_) {
+      return false;
+    }
+    v8::HeapStatistics heap;
+    isolate_->GetHeapStatistics(&heap);
+    size_t used = OldGenerationUsed();
+    if (used >= options_.shrink_usage * limit_) {
+      low_samples_ = 0;
+      return false;
+    }
+    if (++low_samples_ < options_.shrink_after) {
+      return false;
+    }
+    low_samples_ = 0;
+    size_t limit = std::max(initial_limit_, 2 * used);
+    if (limit >= limit_) {
+      return false;
+    }
+    Log("shrink", limit_, limit, heap);
+    // Removing the callback with a limit is the only way to lower it.
+    isolate_->RemoveNearHeapLimitCallback(NearHeapLimit, limit);
+    isolate_->AddNearHeapLimitCallback(NearHeapLimit, this);
+    limit_ = limit;
+    stats_.shrinks++;
+    return true;
+  }
+
+  // Returns true if the controller terminated the script that ran last, and
+  // cancels the termination so that the isolate can run scripts again.
+  bool TakeTermination() {
+    if (!terminating_) {
+      return false;
+    }
+    terminating_ = false;
+    headroom_ = 0;
+    isolate_->CancelTerminateExecution();
+    return true;
+  }
+
+  // The old generation limit after the last decision, 0 before the first.
+  size_t limit() const { return limit_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  static size_t NearHeapLimit(void* data, size_t current_heap_limit,
+                              size_t initial_heap_limit) {
+    HeapController* controller = static_cast<HeapController*>(data);
+    return controller->OnNearHeapLimit(current_heap_limit, initial_heap_limit);
+  }
+
+  size_t OnNearHeapLimit(size_t current_limit, size_t initial_limit) {
+    initial_limit_ = initial_limit;
+    v8::HeapStatistics heap;
+    isolate_->GetHeapStatistics(&heap);
+    size_t limit;
+    if (terminating_) {
+      // Still unwinding.
+      if (headroom_ + options_.termination_headroom >
+          options_.max_termination_headroom) {
+        Log("exhausted", current_limit, current_limit, heap);
+        return current_limit;
+      }
+      headroom_ += options_.termination_headroom;
+      limit = current_limit + options_.termination_headroom;
+      Log("headroom", current_limit, limit, heap);
+    } else if (current_limit + options_.extension <= options_.max_limit) {
+      limit = current_limit + options_.extension;
+      stats_.extensions++;
+      Log("extend", current_limit, limit, heap);
+    } else {
+      terminating_ = true;
+      isolate_->TerminateExecution();
+      headroom_ = options_.termination_headroom;
+      limit = current_limit + options_.termination_headroom;
+      stats_.terminations++;
+      Log("terminate", current_limit, limit, heap);
+    }
+    limit_ = limit;
+    low_samples_ = 0;
+    return limit;
+  }
+
+  // The used size of the spaces the old generation limit is about, which is
+  // all of them but the young generation's.
+  size_t OldGenerationUsed() {
+    size_t used = 0;
+    for (size_t i = 0; i < isolate_->NumberOfHeapSpaces(); i++) {
+      v8::HeapSpaceStatistics space;
+      if (!isolate_->GetHeapSpaceStatistics(&space, i)) {
+        continue;
+      }
+      std::string name = space.space_name();
+      if (name != "new_space" && name != "new_large_object_space") {
+        used += space.space_used_size();
+      }
+    }
+    return used;
+  }
+
+  // heap is not const because HeapStatistics' getters are not.
+  void Log(const char* decision, size_t from, size_t to,
+           v8::HeapStatistics& heap) {
+    if (options_.log == nullptr) {
+      return;
+    }
+    const double mb = 1 << 20;
+    fprintf(options_.log,
+            "heap controller: %-9s limit %.1f -> %.1f MB (used %.1f MB, "
+            "total %.1f MB, external %.1f MB, heap size limit %.1f MB)\n",
+            decision, from / mb, to / mb, heap.used_heap_size() / mb,
+            heap.total_heap_size() / mb, heap.external_memory() / mb,
+            heap.heap_size_limit() / mb);
+  }
+
+  v8::Isolate* isolate_;
+  Options options_;
+  Stats stats_ = {0, 0, 0};
+  size_t limit_ = 0;
+  size_t initial_limit_ = 0;
+  // Granted since the termination.
+  size_t headroom_ = 0;
+  int low_samples_ = 0;
+  bool terminating_ = false;
+};
+
+#endif  // SRC_HEAP_CONTROLLER_H_
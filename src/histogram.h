@@ -0,0 +1,106 @@
+#ifndef SRC_HISTOGRAM_H_
+#define SRC_HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// A log-linear histogram of non-negative integer samples, for example
+// latencies in nanoseconds.
+//
+// Every power of two range is split into 8 equal buckets, so a percentile
+// is accurate to 12.5% (values below 8 are exact). Record is a couple of
+// relaxed atomic increments and can be called from any number of threads
+// at the same time without locking, which keeps it cheap enough to use on
+// every task that a platform runs.
+class Histogram {
+ public:
+  static const int kSubBucketBits = 3;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  Histogram() {
+    Reset();
+  }
+
+  void Record(uint64_t value) {
+    buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max &&
+           !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  double mean() const {
+    uint64_t n = count();
+    return n == 0 ? 0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / n;
+  }
+
+  // Returns the value below which percentile (0-100) percent of the
+  // samples are, as the upper bound of the bucket it falls in, or 0 if
+  // there are no samples. Samples recorded concurrently may or may not be
+  // included.
+  uint64_t Percentile(double percentile) const {
+    uint64_t total = count();
+    if (total == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(percentile / 100 * total + 0.5);
+    if (rank < 1) {
+      rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+      seen += buckets_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        uint64_t upper = BucketUpperBound(i);
+        return upper < max() ? upper : max();
+      }
+    }
+    return max();
+  }
+
+  void Reset() {
+    for (std::atomic<uint64_t>& bucket : buckets_) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  static int BucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+      return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = static_cast<int>((value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1));
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+  }
+
+  // The largest value that ends up in bucket index.
+  static uint64_t BucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+      return static_cast<uint64_t>(index);
+    }
+    int exponent = index / kSubBuckets + kSubBucketBits - 1;
+    uint64_t sub = static_cast<uint64_t>(index % kSubBuckets);
+    uint64_t lower = (kSubBuckets + sub) << (exponent - kSubBucketBits);
+    uint64_t width = 1ULL << (exponent - kSubBucketBits);
+    return lower + (width - 1);
+  }
+
+ private:
+  std::atomic<uint64_t> buckets_[kBuckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+#endif  // SRC_HISTOGRAM_H_
@@ -0,0 +1,144 @@
+#ifndef SRC_IDLE_GC_SCHEDULER_H_
+#define SRC_IDLE_GC_SCHEDULER_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "v8.h"
+#include "platform-message-loop.h"
+
+// Moves garbage collection work into the gaps between an embedder's jobs,
+// so that it does not land in the middle of the next one.
+//
+// The embedder tells the scheduler when a job starts and finishes, and
+// calls OnIdle when its thread has nothing to do. OnIdle then spends a
+// budget of that idle time on:
+//  - MemoryPressureNotification, when the heap is close to its limit, which
+//    makes V8 collect right away instead of during the next job,
+//  - the idle tasks V8 has posted to the platform (incremental marking
+//    steps, for example), if the platform supports them; the scheduler
+//    enables them for its isolate while it exists, see
+//    SetPlatformIdleTasksEnabled,
+//  - Isolate::IdleNotificationDeadline with the rest of the budget, which
+//    lets V8 finish or start incremental marking, or do a scavenge, if it
+//    can do so before the deadline.
+//
+// The budget is either the known idle time, for example the time until the
+// next timer in an event loop, or half of the average gap between jobs seen
+// so far, and is capped at max_budget_ms so that an unexpected job is not
+// delayed much.
+class IdleGcScheduler {
+ public:
+  struct Options {
+    // Idle periods shorter than this are not worth it.
+    double min_budget_ms = 1;
+    double max_budget_ms = 10;
+    // Used heap as a fraction of the heap limit at which moderate and
+    // critical memory pressure is signaled.
+    double moderate_pressure = 0.7;
+    double critical_pressure = 0.9;
+  };
+
+  struct Stats {
+    uint64_t idle_periods;
+    // How many times V8 said it had no more idle work.
+    uint64_t gc_done;
+    uint64_t pressure_notifications;
+    double idle_ms;
+  };
+
+  IdleGcScheduler(v8::Isolate* isolate, v8::Platform* platform)
+      : isolate_(isolate), platform_(platform) {
+    SetPlatformIdleTasksEnabled(platform_, isolate_, true);
+  }
+
+  IdleGcScheduler(v8::Isolate* isolate, v8::Platform* platform,
+                  const Options& options)
+      : isolate_(isolate), platform_(platform), options_(options) {
+    SetPlatformIdleTasksEnabled(platform_, isolate_, true);
+  }
+
+  IdleGcScheduler(const IdleGcScheduler&) = delete;
+  IdleGcScheduler& operator=(const IdleGcScheduler&) = delete;
+
+  ~IdleGcScheduler() {
+    SetPlatformIdleTasksEnabled(platform_, isolate_, false);
+  }
+
+  void JobStarted() {
+    double now = platform_->MonotonicallyIncreasingTime();
+    if (last_job_end_ > 0) {
+      double gap_ms = (now - last_job_end_) * 1000;
+      average_gap_ms_ = average_gap_ms_ == 0
+          ? gap_ms : 0.8 * average_gap_ms_ + 0.2 * gap_ms;
+    }
+    // Once IdleNotificationDeadline has returned true it should not be
+    // called again until some real work has been done.
+    done_ = false;
+  }
+
+  void JobFinished() {
+    last_job_end_ = platform_->MonotonicallyIncreasingTime();
+  }
+
+  // Uses up to idle_time_ms of idle time, or a budget based on the gaps seen
+  // between jobs if idle_time_ms is 0 or less. Must be called on the
+  // isolate's thread with the isolate entered. Returns true if anything was
+  // done.
+  bool OnIdle(double idle_time_ms = 0) {
+    double budget_ms = idle_time_ms > 0 ? idle_time_ms : average_gap_ms_ / 2;
+    budget_ms = std::min(budget_ms, options_.max_budget_ms);
+    if (budget_ms < options_.min_budget_ms) {
+      return false;
+    }
+    double start = platform_->MonotonicallyIncreasingTime();
+    double deadline = start + budget_ms / 1000;
+    stats_.idle_periods++;
+
+    SignalMemoryPressure();
+    RunPlatformIdleTasks(platform_, isolate_, budget_ms / 1000);
+    if (!done_ && platform_->MonotonicallyIncreasingTime() < deadline) {
+      done_ = isolate_->IdleNotificationDeadline(deadline);
+      if (done_) {
+        stats_.gc_done++;
+      }
+    }
+    stats_.idle_ms += (platform_->MonotonicallyIncreasingTime() - start) * 1000;
+    return true;
+  }
+
+  const Stats& stats() const { return stats_; }
+  double average_gap_ms() const { return average_gap_ms_; }
+
+ private:
+  void SignalMemoryPressure() {
+    v8::HeapStatistics heap;
+    isolate_->GetHeapStatistics(&heap);
+    double used = heap.heap_size_limit() == 0 ? 0 :
+        static_cast<double>(heap.used_heap_size()) / heap.heap_size_limit();
+    v8::MemoryPressureLevel level = v8::MemoryPressureLevel::kNone;
+    if (used >= options_.critical_pressure) {
+      level = v8::MemoryPressureLevel::kCritical;
+    } else if (used >= options_.moderate_pressure) {
+      level = v8::MemoryPressureLevel::kModerate;
+    }
+    // Only changes are signaled, V8 collects when the level goes up.
+    if (level != pressure_) {
+      isolate_->MemoryPressureNotification(level);
+      pressure_ = level;
+      stats_.pressure_notifications++;
+    }
+  }
+
+  v8::Isolate* isolate_;
+  v8::Platform* platform_;
+  Options options_;
+  Stats stats_ = {0, 0, 0, 0};
+  double last_job_end_ = 0;
+  double average_gap_ms_ = 0;
+  bool done_ = false;
+  v8::MemoryPressureLevel pressure_ = v8::MemoryPressureLevel::kNone;
+};
+
+#endif  // SRC_IDLE_GC_SCHEDULER_H_
@@ -0,0 +1,502 @@
+#ifndef SRC_INSTRUMENTED_PLATFORM_H_
+#define SRC_INSTRUMENTED_PLATFORM_H_
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+#include "histogram.h"
+#include "platform-message-loop.h"
+
+// A v8::Platform that forwards everything to another platform and records
+// how long every task waited in its queue and how long it ran.
+//
+// Tasks are wrapped when they are posted. The wrapper takes the time when
+// it is posted and when it starts and finishes running, and records the
+// durations in nanoseconds in lock-free Histograms, which is a few clock
+// reads and atomic increments per task. The samples are kept:
+//  - per TaskPriority, for worker tasks. CallOnWorkerThread is
+//    kUserVisible, CallBlockingTaskOnWorkerThread kUserBlocking and
+//    CallLowPriorityTaskOnWorkerThread kBestEffort. Jobs are run through
+//    these as well, with the job's priority.
+//  - per TaskKind, which separates foreground from worker tasks and
+//    delayed from immediate ones. For delayed tasks the lateness, how long
+//    after its delay was up a task started, is recorded too.
+//  - per task type, which is the task's class. There is no RTTI so the type
+//    is told apart by its vtable, and the name is looked up with dladdr
+//    when a dump is written. It is only found if V8 was built with
+//    symbols exposed, otherwise the vtable's address is used. Types are
+//    found in a fixed lock-free table, so posting a task takes no lock;
+//    types beyond the first kMaxTypes are not recorded per type.
+//
+// Percentiles are available from the histograms, and Dump writes them all
+// as text, which StartPeriodicDump does every interval.
+//
+//   InstrumentedPlatform platform(platform::NewDefaultPlatform());
+//   V8::InitializePlatform(&platform);
+//   ...
+//   platform.Dump(stderr);
+class InstrumentedPlatform : public v8::Platform, public PlatformMessageLoop {
+ public:
+  enum TaskKind {
+    kWorker,
+    kDelayedWorker,
+    kForeground,
+    kDelayedForeground,
+    kIdle,
+    kNumTaskKinds
+  };
+
+  struct TaskStats {
+    Histogram wait;
+    Histogram run;
+    // Only recorded for delayed tasks.
+    Histogram lateness;
+  };
+
+  explicit InstrumentedPlatform(std::unique_ptr<v8::Platform> platform)
+      : platform_(std::move(platform)) {
+    PlatformMessageLoop::Register(this, this);
+  }
+
+  ~InstrumentedPlatform() override {
+    StopPeriodicDump();
+    PlatformMessageLoop::Unregister(this);
+    // Tasks that are still running record into this object's histograms,
+    // so the platform has to be gone (and its workers joined) first.
+    platform_.reset();
+    for (TypeSlot& slot : types_) {
+      delete slot.stats.load(std::memory_order_relaxed);
+    }
+  }
+
+  v8::Platform* platform() const { return platform_.get(); }
+
+  int NumberOfWorkerThreads() override {
+    return platform_->NumberOfWorkerThreads();
+  }
+
+  std::shared_ptr<v8::TaskRunner> GetForegroundTaskRunner(
+      v8::Isolate* isolate) override {
+    std::shared_ptr<v8::TaskRunner> runner =
+        platform_->GetForegroundTaskRunner(isolate);
+    std::lock_guard<std::mutex> lock(runners_mutex_);
+    std::shared_ptr<TaskRunner>& wrapper = runners_[isolate];
+    if (!wrapper || wrapper->runner() != runner) {
+      wrapper = std::make_shared<TaskRunner>(this, runner);
+    }
+    return wrapper;
+  }
+
+  void CallOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    platform_->CallOnWorkerThread(
+        Wrap(std::move(task), kWorker, v8::TaskPriority::kUserVisible));
+  }
+
+  void CallBlockingTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    platform_->CallBlockingTaskOnWorkerThread(
+        Wrap(std::move(task), kWorker, v8::TaskPriority::kUserBlocking));
+  }
+
+  void CallLowPriorityTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    platform_->CallLowPriorityTaskOnWorkerThread(
+        Wrap(std::move(task), kWorker, v8::TaskPriority::kBestEffort));
+  }
+
+  void CallDelayedOnWorkerThread(std::unique_ptr<v8::Task> task,
+                                 double delay_in_seconds) override {
+    platform_->CallDelayedOnWorkerThread(
+        Wrap(std::move(task), kDelayedWorker, v8::TaskPriority::kUserVisible,
+             delay_in_seconds),
+        delay_in_seconds);
+  }
+
+  // The job's worker tasks are posted through this platform, so that they
+  // are recorded like other worker tasks.
+  std::unique_ptr<v8::JobHandle> PostJob(
+      v8::TaskPriority priority, std::unique_ptr<v8::JobTask> job_task) override {
+    return v8::platform::NewDefaultJobHandle(this, priority, std::move(job_task),
+                                             NumberOfWorkerThreads());
+  }
+
+  bool IdleTasksEnabled(v8::Isolate* isolate) override {
+    return platform_->IdleTasksEnabled(isolate);
+  }
+
+  double MonotonicallyIncreasingTime() override {
+    return platform_->MonotonicallyIncreasingTime();
+  }
+
+  double CurrentClockTimeMillis() override {
+    return platform_->CurrentClockTimeMillis();
+  }
+
+  v8::TracingController* GetTracingController() override {
+    return platform_->GetTracingController();
+  }
+
+  v8::PageAllocator* GetPageAllocator() override {
+    return platform_->GetPageAllocator();
+  }
+
+  void OnCriticalMemoryPressure() override {
+    platform_->OnCriticalMemoryPressure();
+  }
+
+  bool PumpMessageLoop(v8::Isolate* isolate, bool wait = false) override {
+    return PumpPlatformMessageLoop(platform_.get(), isolate, wait);
+  }
+
+  void RunIdleTasks(v8::Isolate* isolate, double idle_time_in_seconds) override {
+    RunPlatformIdleTasks(platform_.get(), isolate, idle_time_in_seconds);
+  }
+
+  void SetIdleTasksEnabled(v8::Isolate* isolate, bool enabled) override {
+    SetPlatformIdleTasksEnabled(platform_.get(), isolate, enabled);
+  }
+
+  void NotifyIsolateShutdown(v8::Isolate* isolate) override {
+    {
+      std::lock_guard<std::mutex> lock(runners_mutex_);
+      runners_.erase(isolate);
+    }
+    NotifyPlatformIsolateShutdown(platform_.get(), isolate);
+  }
+
+  // Worker task statistics for a priority.
+  const TaskStats& stats(v8::TaskPriority priority) const {
+    return priority_stats_[PriorityIndex(priority)];
+  }
+
+  const TaskStats& stats(TaskKind kind) const {
+    return kind_stats_[kind];
+  }
+
+  // Statistics per task type, keyed by the type's name.
+  std::map<std::string, const TaskStats*> type_stats() const {
+    std::map<std::string, const TaskStats*> result;
+    for (const TypeSlot& slot : types_) {
+      const TaskStats* stats = slot.stats.load(std::memory_order_acquire);
+      if (stats != nullptr) {
+        result[TypeName(slot.vtable.load(std::memory_order_relaxed))] = stats;
+      }
+    }
+    return result;
+  }
+
+  // Writes count, mean and percentiles of all non-empty histograms, in
+  // microseconds.
+  void Dump(FILE* file) const {
+    static const char* kPriorityNames[] = {"user-blocking", "user-visible", "best-effort"};
+    static const char* kKindNames[] = {"worker", "delayed-worker", "foreground",
+                                       "delayed-foreground", "idle"};
+    fprintf(file, "%-8s %-28s %-4s %10s %9s %9s %9s %9s %9s\n", "group",
+            "task latency (us)", "", "count", "mean", "p50", "p90", "p99", "max");
+    for (int i = 0; i < kNumPriorities; i++) {
+      DumpStats(file, "priority", kPriorityNames[i], priority_stats_[i]);
+    }
+    for (int i = 0; i < kNumTaskKinds; i++) {
+      DumpStats(file, "kind", kKindNames[i], kind_stats_[i]);
+    }
+    for (const auto& entry : type_stats()) {
+      DumpStats(file, "type", entry.first.c_str(), *entry.second);
+    }
+    fflush(file);
+  }
+
+  // Dumps to file every interval from a background thread, until
+  // StopPeriodicDump is called or the platform is destroyed.
+  void StartPeriodicDump(FILE* file, std::chrono::milliseconds interval) {
+    StopPeriodicDump();
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    dump_stopping_ = false;
+    dump_thread_ = std::thread([this, file, interval] {
+      std::unique_lock<std::mutex> lock(dump_mutex_);
+      while (!dump_cv_.wait_for(lock, interval, [this] { return dump_stopping_; })) {
+        Dump(file);
+      }
+    });
+  }
+
+  void StopPeriodicDump() {
+    {
+      std::lock_guard<std::mutex> lock(dump_mutex_);
+      dump_stopping_ = true;
+    }
+    dump_cv_.notify_all();
+    if (dump_thread_.joinable()) {
+      dump_thread_.join();
+    }
+  }
+
+ private:
+  static const int kNumPriorities = 3;
+  // A power of two.
+  static const size_t kMaxTypes = 512;
+
+  typedef std::chrono::steady_clock Clock;
+
+  static int PriorityIndex(v8::TaskPriority priority) {
+    switch (priority) {
+      case v8::TaskPriority::kUserBlocking:
+        return 0;
+      case v8::TaskPriority::kUserVisible:
+        return 1;
+      case v8::TaskPriority::kBestEffort:
+        return 2;
+    }
+    return 1;
+  }
+
+  static uint64_t Nanoseconds(Clock::duration duration) {
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    return ns < 0 ? 0 : static_cast<uint64_t>(ns);
+  }
+
+  // Where the samples of one task go.
+  struct Targets {
+    TaskStats* kind;
+    TaskStats* priority;
+    TaskStats* type;
+  };
+
+  class InstrumentedTask : public v8::Task {
+   public:
+    InstrumentedTask(std::unique_ptr<v8::Task> task, Targets targets,
+                     Clock::time_point due)
+        : task_(std::move(task)), targets_(targets),
+          posted_(Clock::now()), due_(due) {}
+
+    void Run() override {
+      Clock::time_point start = Clock::now();
+      task_->Run();
+      Record(targets_, start - posted_, Clock::now() - start, start, due_);
+    }
+
+   private:
+    std::unique_ptr<v8::Task> task_;
+    Targets targets_;
+    Clock::time_point posted_;
+    Clock::time_point due_;
+  };
+
+  class InstrumentedIdleTask : public v8::IdleTask {
+   public:
+    InstrumentedIdleTask(std::unique_ptr<v8::IdleTask> task, Targets targets)
+        : task_(std::move(task)), targets_(targets), posted_(Clock::now()) {}
+
+    void Run(double deadline_in_seconds) override {
+      Clock::time_point start = Clock::now();
+      task_->Run(deadline_in_seconds);
+      Record(targets_, start - posted_, Clock::now() - start, start,
+             Clock::time_point());
+    }
+
+   private:
+    std::unique_ptr<v8::IdleTask> task_;
+    Targets targets_;
+    Clock::time_point posted_;
+  };
+
+  class TaskRunner : public v8::TaskRunner {
+   public:
+    TaskRunner(InstrumentedPlatform* platform,
+               std::shared_ptr<v8::TaskRunner> runner)
+        : platform_(platform), runner_(std::move(runner)) {}
+
+    void PostTask(std::unique_ptr<v8::Task> task) override {
+      runner_->PostTask(platform_->Wrap(std::move(task), kForeground));
+    }
+
+    void PostNonNestableTask(std::unique_ptr<v8::Task> task) override {
+      runner_->PostNonNestableTask(platform_->Wrap(std::move(task), kForeground));
+    }
+
+    void PostDelayedTask(std::unique_ptr<v8::Task> task,
+                         double delay_in_seconds) override {
+      runner_->PostDelayedTask(
+          platform_->Wrap(std::move(task), kDelayedForeground,
+                          v8::TaskPriority::kUserBlocking, delay_in_seconds),
+          delay_in_seconds);
+    }
+
+    void PostNonNestableDelayedTask(std::unique_ptr<v8::Task> task,
+                                    double delay_in_seconds) override {
+      runner_->PostNonNestableDelayedTask(
+          platform_->Wrap(std::move(task), kDelayedForeground,
+                          v8::TaskPriority::kUserBlocking, delay_in_seconds),
+          delay_in_seconds);
+    }
+
+    void PostIdleTask(std::unique_ptr<v8::IdleTask> task) override {
+      runner_->PostIdleTask(platform_->WrapIdle(std::move(task)));
+    }
+
+    bool IdleTasksEnabled() override { return runner_->IdleTasksEnabled(); }
+    bool NonNestableTasksEnabled() const override {
+      return runner_->NonNestableTasksEnabled();
+    }
+    bool NonNestableDelayedTasksEnabled() const override {
+      return runner_->NonNestableDelayedTasksEnabled();
+    }
+
+    const std::shared_ptr<v8::TaskRunner>& runner() const { return runner_; }
+
+   private:
+    InstrumentedPlatform* platform_;
+    std::shared_ptr<v8::TaskRunner> runner_;
+  };
+
+  static void Record(const Targets& targets, Clock::duration wait,
+                     Clock::duration run, Clock::time_point start,
+                     Clock::time_point due) {
+    uint64_t wait_ns = Nanoseconds(wait);
+    uint64_t run_ns = Nanoseconds(run);
+    TaskStats* all[] = {targets.kind, targets.priority, targets.type};
+    for (TaskStats* stats : all) {
+      if (stats == nullptr) {
+        continue;
+      }
+      stats->wait.Record(wait_ns);
+      stats->run.Record(run_ns);
+      if (due != Clock::time_point()) {
+        stats->lateness.Record(Nanoseconds(start - due));
+      }
+    }
+  }
+
+  // Foreground tasks have no priority, they are only recorded per kind
+  // and type.
+  std::unique_ptr<v8::Task> Wrap(std::unique_ptr<v8::Task> task, TaskKind kind) {
+    Targets targets{&kind_stats_[kind], nullptr, TypeStats(task.get())};
+    return std::unique_ptr<v8::Task>(
+        new InstrumentedTask(std::move(task), targets, Clock::time_point()));
+  }
+
+  std::unique_ptr<v8::Task> Wrap(std::unique_ptr<v8::Task> task, TaskKind kind,
+                                 v8::TaskPriority priority,
+                                 double delay_in_seconds = -1) {
+    Targets targets{&kind_stats_[kind],
+                    kind == kWorker ? &priority_stats_[PriorityIndex(priority)] : nullptr,
+                    TypeStats(task.get())};
+    Clock::time_point due;
+    if (delay_in_seconds >= 0) {
+      due = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(delay_in_seconds));
+    }
+    return std::unique_ptr<v8::Task>(
+        new InstrumentedTask(std::move(task), targets, due));
+  }
+
+  std::unique_ptr<v8::IdleTask> WrapIdle(std::unique_ptr<v8::IdleTask> task) {
+    Targets targets{&kind_stats_[kIdle], nullptr, TypeStats(task.get())};
+    return std::unique_ptr<v8::IdleTask>(
+        new InstrumentedIdleTask(std::move(task), targets));
+  }
+
+  // The first word of a polymorphic object is its vtable pointer, which is
+  // the same for all objects of one class. Looked up in an open addressing
+  // table with linear probing whose slots are claimed with a compare and
+  // swap and never given up, so a lookup is a few atomic loads.
+  template <typename T>
+  TaskStats* TypeStats(T* task) {
+    const void* vtable = *reinterpret_cast<const void* const*>(task);
+    size_t hash = static_cast<size_t>(
+        (reinterpret_cast<uintptr_t>(vtable) >> 3) * 0x9e3779b97f4a7c15ULL >> 32);
+    for (size_t i = 0; i < kMaxTypes; i++) {
+      TypeSlot& slot = types_[(hash + i) & (kMaxTypes - 1)];
+      const void* key = slot.vtable.load(std::memory_order_acquire);
+      if (key == nullptr) {
+        if (slot.vtable.compare_exchange_strong(key, vtable,
+                                                std::memory_order_acq_rel)) {
+          TaskStats* stats = new TaskStats();
+          slot.stats.store(stats, std::memory_order_release);
+          return stats;
+        }
+        // Claimed by another thread meanwhile, key is its vtable now.
+      }
+      if (key == vtable) {
+        TaskStats* stats;
+        // The thread that claimed the slot is about to set it.
+        while ((stats = slot.stats.load(std::memory_order_acquire)) == nullptr) {
+          std::this_thread::yield();
+        }
+        return stats;
+      }
+    }
+    return nullptr;
+  }
+
+  static std::string TypeName(const void* vtable) {
+    Dl_info info;
+    if (dladdr(vtable, &info) != 0 && info.dli_sname != nullptr &&
+        info.dli_saddr != nullptr) {
+      int status;
+      char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+      if (status == 0 && demangled != nullptr) {
+        std::string name = demangled;
+        free(demangled);
+        const char kPrefix[] = "vtable for ";
+        if (name.compare(0, sizeof(kPrefix) - 1, kPrefix) == 0) {
+          return name.substr(sizeof(kPrefix) - 1);
+        }
+      }
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%p", vtable);
+    return buffer;
+  }
+
+  static void DumpStats(FILE* file, const char* group, const char* name,
+                        const TaskStats& stats) {
+    const Histogram* histograms[] = {&stats.wait, &stats.run, &stats.lateness};
+    const char* labels[] = {"wait", "run", "late"};
+    for (int i = 0; i < 3; i++) {
+      const Histogram& h = *histograms[i];
+      if (h.count() == 0) {
+        continue;
+      }
+      fprintf(file, "%-8s %-28.28s %-4s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+              group, name, labels[i],
+              static_cast<unsigned long long>(h.count()), h.mean() / 1e3,
+              h.Percentile(50) / 1e3, h.Percentile(90) / 1e3,
+              h.Percentile(99) / 1e3, h.max() / 1e3);
+    }
+  }
+
+  std::unique_ptr<v8::Platform> platform_;
+  TaskStats priority_stats_[kNumPriorities];
+  TaskStats kind_stats_[kNumTaskKinds];
+
+  struct TypeSlot {
+    std::atomic<const void*> vtable{nullptr};
+    std::atomic<TaskStats*> stats{nullptr};
+  };
+  TypeSlot types_[kMaxTypes];
+
+  std::mutex runners_mutex_;
+  std::unordered_map<v8::Isolate*, std::shared_ptr<TaskRunner>> runners_;
+
+  std::mutex dump_mutex_;
+  std::condition_variable dump_cv_;
+  std::thread dump_thread_;
+  bool dump_stopping_ = false;
+};
+
+#endif  // SRC_INSTRUMENTED_PLATFORM_H_
@@ -0,0 +1,12 @@
+#ifndef SRC_ISOLATE_DATA_H_
+#define SRC_ISOLATE_DATA_H_
+
+#include <stdint.h>
+
+// Isolate::SetData slots used by the embedder code in src/. V8 only has a
+// few of them (Isolate::GetNumberOfDataSlots) so they are all listed here.
+enum IsolateDataSlot : uint32_t {
+  kOutputSinkSlot = 0,
+};
+
+#endif  // SRC_ISOLATE_DATA_H_
@@ -0,0 +1,190 @@
+#ifndef SRC_ISOLATE_POOL_H_
+#define SRC_ISOLATE_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+#include "bindings.h"
+#include "bindings-snapshot.h"
+#include "idle-gc-scheduler.h"
+#include "platform-message-loop.h"
+
+struct ScriptResult {
+  // True if the script ran to completion, in which case value is the
+  // result converted to a string. Otherwise value is the exception.
+  bool success;
+  std::string value;
+};
+
+// A fixed number of isolates, each owned by its own thread, that run scripts
+// taken from a shared queue.
+//
+// Every isolate is created up front together with a context that has the
+// Person and print bindings installed (see bindings.h), so submitting a
+// script only pays for compiling and running it. If a BindingsSnapshot is
+// given the contexts are deserialized from it instead of being built from
+// the templates. The context is reused for all jobs that a thread runs,
+// which means that globals set by one script are visible to later scripts
+// that happen to run on the same thread.
+//
+// With idle_gc a thread that finds the queue empty after a job gives V8 a
+// chance to collect garbage before it waits for the next one, see
+// idle-gc-scheduler.h.
+class IsolatePool {
+ public:
+  IsolatePool(v8::Platform* platform, size_t size,
+              const BindingsSnapshot* snapshot = nullptr, bool idle_gc = false)
+      : platform_(platform), snapshot_(snapshot), idle_gc_(idle_gc) {
+    for (size_t i = 0; i < size; i++) {
+      threads_.emplace_back(&IsolatePool::WorkerMain, this);
+    }
+    // Wait for all isolates to be warm before accepting work.
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_cv_.wait(lock, [this, size] { return ready_ == size; });
+  }
+
+  // Runs the jobs that are already queued and then disposes the isolates.
+  ~IsolatePool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  std::future<ScriptResult> Submit(std::string source) {
+    Job job;
+    job.source = std::move(source);
+    std::future<ScriptResult> result = job.result.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(job));
+    }
+    queue_cv_.notify_one();
+    return result;
+  }
+
+  size_t size() const { return threads_.size(); }
+
+ private:
+  struct Job {
+    std::string source;
+    std::promise<ScriptResult> result;
+  };
+
+  void WorkerMain() {
+    std::unique_ptr<v8::ArrayBuffer::Allocator> allocator(
+        v8::ArrayBuffer::Allocator::NewDefaultAllocator());
+    v8::Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator = allocator.get();
+    if (snapshot_ != nullptr) {
+      snapshot_->Apply(&create_params);
+    }
+    v8::Isolate* isolate = v8::Isolate::New(create_params);
+    {
+      v8::Isolate::Scope isolate_scope(isolate);
+      v8::Global<v8::Context> context;
+      {
+        v8::HandleScope handle_scope(isolate);
+        v8::Local<v8::Context> local_context;
+        if (snapshot_ != nullptr) {
+          local_context = BindingsSnapshot::NewContext(isolate).ToLocalChecked();
+        } else {
+          local_context = v8::Context::New(isolate, nullptr,
+                                           NewGlobalTemplate(isolate));
+        }
+        context.Reset(isolate, local_context);
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_++;
+      }
+      ready_cv_.notify_all();
+
+      std::unique_ptr<IdleGcScheduler> idle_gc;
+      if (idle_gc_) {
+        idle_gc.reset(new IdleGcScheduler(isolate, platform_));
+      }
+      Job job;
+      while (NextJob(&job)) {
+        if (idle_gc) {
+          idle_gc->JobStarted();
+        }
+        job.result.set_value(Run(isolate, context, job.source));
+        while (PumpPlatformMessageLoop(platform_, isolate)) {
+        }
+        if (idle_gc) {
+          idle_gc->JobFinished();
+          if (QueueEmpty()) {
+            idle_gc->OnIdle();
+          }
+        }
+      }
+      context.Reset();
+    }
+    NotifyPlatformIsolateShutdown(platform_, isolate);
+    isolate->Dispose();
+  }
+
+  bool QueueEmpty() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.empty();
+  }
+
+  bool NextJob(Job* job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return false;
+    }
+    *job = std::move(queue_.front());
+    queue_.pop_front();
+    return true;
+  }
+
+  static ScriptResult Run(v8::Isolate* isolate,
+                          const v8::Global<v8::Context>& global_context,
+                          const std::string& js) {
+    v8::HandleScope handle_scope(isolate);
+    v8::Local<v8::Context> context = global_context.Get(isolate);
+    v8::Context::Scope context_scope(context);
+    v8::TryCatch try_catch(isolate);
+
+    v8::Local<v8::String> source;
+    v8::Local<v8::Script> script;
+    v8::Local<v8::Value> result;
+    if (!v8::String::NewFromUtf8(isolate, js.c_str(), v8::NewStringType::kNormal,
+                                 static_cast<int>(js.size())).ToLocal(&source) ||
+        !v8::Script::Compile(context, source).ToLocal(&script) ||
+        !script->Run(context).ToLocal(&result)) {
+      v8::String::Utf8Value error(isolate, try_catch.Exception());
+      return ScriptResult{false, *error != nullptr ? *error : ""};
+    }
+    v8::String::Utf8Value value(isolate, result);
+    return ScriptResult{true, *value != nullptr ? *value : ""};
+  }
+
+  v8::Platform* platform_;
+  const BindingsSnapshot* snapshot_;
+  bool idle_gc_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable queue_cv_;
+  std::condition_variable ready_cv_;
+  std::deque<Job> queue_;
+  size_t ready_ = 0;
+  bool stopping_ = false;
+};
+
+#endif  // SRC_ISOLATE_POOL_H_
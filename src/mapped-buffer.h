@@ -0,0 +1,83 @@
+#ifndef SRC_MAPPED_BUFFER_H_
+#define SRC_MAPPED_BUFFER_H_
+
+#include <stdio.h>
+
+#include <memory>
+
+#include "v8.h"
+#include "mapped-file.h"
+
+// Exposes files to JavaScript as ArrayBuffers whose backing store is a
+// mapping of the file, so nothing is read until it is touched and pages
+// that are not written to stay shared with the page cache.
+//
+// The BackingStore is created with ArrayBuffer::NewBackingStore and a
+// deleter that deletes the MappedFile, which unmaps it, once the last
+// ArrayBuffer using it is collected or detached. V8 may run the deleter on
+// one of its background threads.
+//
+// In MappedFile::kReadOnly mode a write from JavaScript faults and takes
+// down the process, V8 has no read-only ArrayBuffers; only hand those to
+// code that is trusted to just read. kCopyOnWrite buffers can be written,
+// the written pages become private copies and the file does not change.
+
+namespace mapped_buffer {
+
+inline void DeleteMappedFile(void* data, size_t length, void* deleter_data) {
+  delete static_cast<MappedFile*>(deleter_data);
+}
+
+}  // namespace mapped_buffer
+
+// Returns an empty ArrayBuffer for an empty file, and nothing if the file
+// cannot be opened or mapped.
+inline v8::MaybeLocal<v8::ArrayBuffer> ArrayBufferFromFile(
+    v8::Isolate* isolate, const char* name, MappedFile::Mode mode,
+    MappedFile::Advice advice) {
+  std::unique_ptr<MappedFile> file = MappedFile::Open(name, mode, advice);
+  if (!file) {
+    // Either the file does not exist or it is empty, and an empty file
+    // cannot be mapped.
+    FILE* f = fopen(name, "rb");
+    if (f == nullptr) {
+      return v8::MaybeLocal<v8::ArrayBuffer>();
+    }
+    fclose(f);
+    return v8::ArrayBuffer::New(isolate, 0);
+  }
+  char* data = file->mutable_data();
+  size_t size = file->size();
+  std::unique_ptr<v8::BackingStore> backing_store =
+      v8::ArrayBuffer::NewBackingStore(data, size,
+                                       mapped_buffer::DeleteMappedFile,
+                                       file.release());
+  return v8::ArrayBuffer::New(isolate, std::move(backing_store));
+}
+
+inline v8::MaybeLocal<v8::ArrayBuffer> ArrayBufferFromFile(
+    v8::Isolate* isolate, const char* name) {
+  return ArrayBufferFromFile(isolate, name, MappedFile::kReadOnly,
+                             MappedFile::kNormal);
+}
+
+// The same as a Uint8Array over the whole file. Files longer than
+// TypedArray::kMaxLength return nothing.
+inline v8::MaybeLocal<v8::Uint8Array> Uint8ArrayFromFile(
+    v8::Isolate* isolate, const char* name, MappedFile::Mode mode,
+    MappedFile::Advice advice) {
+  v8::Local<v8::ArrayBuffer> buffer;
+  if (!ArrayBufferFromFile(isolate, name, mode, advice).ToLocal(&buffer) ||
+      buffer->ByteLength() > v8::TypedArray::kMaxLength) {
+    return v8::MaybeLocal<v8::Uint8Array>();
+  }
+  return v8::Uint8Array::New(buffer, 0, buffer->ByteLength());
+}
+
+inline v8::MaybeLocal<v8::Uint8Array> Uint8ArrayFromFile(
+    v8::Isolate* isolate, const char* name) {
+  return Uint8ArrayFromFile(isolate, name, MappedFile::kReadOnly,
+                            MappedFile::kNormal);
+}
+
+#endif  // SRC_MAPPED_BUFFER_H_
@@ -0,0 +1,94 @@
+#ifndef SRC_MAPPED_FILE_H_
+#define SRC_MAPPED_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+
+// A private memory mapping of a whole file, read-only or copy-on-write.
+// The mapping is removed when the MappedFile is destroyed.
+class MappedFile {
+ public:
+  enum Mode {
+    // Mapped PROT_READ, writing to it faults.
+    kReadOnly,
+    // Mapped PROT_READ | PROT_WRITE, writes go to private copies of the
+    // pages they touch and never reach the file.
+    kCopyOnWrite,
+  };
+
+  // Access hints passed to madvise(2).
+  enum Advice {
+    kNormal,
+    // Read ahead aggressively and drop pages soon after they were read.
+    kSequential,
+    // Do not read ahead.
+    kRandom,
+    // Start reading the whole file in now.
+    kWillNeed,
+  };
+
+  // Returns nullptr if the file cannot be opened or mapped. Empty files
+  // cannot be mapped either, callers are expected to check the size
+  // themselves if they want to treat them differently.
+  static std::unique_ptr<MappedFile> Open(const char* path) {
+    return Open(path, kReadOnly, kNormal);
+  }
+
+  static std::unique_ptr<MappedFile> Open(const char* path, Mode mode,
+                                          Advice advice) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      close(fd);
+      return nullptr;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    int prot = mode == kCopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* data = mmap(nullptr, size, prot, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (data == MAP_FAILED) {
+      return nullptr;
+    }
+    std::unique_ptr<MappedFile> file(new MappedFile(data, size, mode));
+    file->Advise(advice);
+    return file;
+  }
+
+  ~MappedFile() {
+    munmap(data_, size_);
+  }
+
+  // Can be called again when the access pattern changes. Returns false if
+  // madvise failed, which only costs performance.
+  bool Advise(Advice advice) {
+    static const int kAdvice[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM,
+                                  MADV_WILLNEED};
+    return madvise(data_, size_, kAdvice[advice]) == 0;
+  }
+
+  const char* data() const { return static_cast<const char*>(data_); }
+  // Only writable in kCopyOnWrite mode.
+  char* mutable_data() const { return static_cast<char*>(data_); }
+  size_t size() const { return size_; }
+  Mode mode() const { return mode_; }
+
+ private:
+  MappedFile(void* data, size_t size, Mode mode)
+      : data_(data), size_(size), mode_(mode) {}
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  void* data_;
+  size_t size_;
+  Mode mode_;
+};
+
+#endif  // SRC_MAPPED_FILE_H_
@@ -0,0 +1,207 @@
+#ifndef SRC_MAPPED_SOURCE_H_
+#define SRC_MAPPED_SOURCE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+
+#include "v8.h"
+#include "mapped-file.h"
+
+// Loads script sources as external strings so that V8 does not have to copy
+// them into its heap.
+//
+// If the file is pure ASCII the mapping itself is handed to V8 as an
+// ExternalOneByteStringResource and the file is never copied. When the string
+// is garbage collected V8 calls Dispose() on the resource which deletes it,
+// and that unmaps the file.
+//
+// Otherwise the file is decoded from UTF-8 once into memory owned by an
+// external resource: one byte per character if every code point fits in
+// Latin-1, two bytes per character if not. Invalid UTF-8 falls back to
+// String::NewFromUtf8 which copies the data and replaces bad sequences.
+
+class MappedOneByteResource : public v8::String::ExternalOneByteStringResource {
+ public:
+  explicit MappedOneByteResource(std::unique_ptr<MappedFile> file)
+      : file_(std::move(file)) {}
+  const char* data() const override { return file_->data(); }
+  size_t length() const override { return file_->size(); }
+
+ private:
+  std::unique_ptr<MappedFile> file_;
+};
+
+class OwnedOneByteResource : public v8::String::ExternalOneByteStringResource {
+ public:
+  OwnedOneByteResource(std::unique_ptr<char[]> data, size_t length)
+      : data_(std::move(data)), length_(length) {}
+  const char* data() const override { return data_.get(); }
+  size_t length() const override { return length_; }
+
+ private:
+  std::unique_ptr<char[]> data_;
+  size_t length_;
+};
+
+class OwnedTwoByteResource : public v8::String::ExternalStringResource {
+ public:
+  OwnedTwoByteResource(std::unique_ptr<uint16_t[]> data, size_t length)
+      : data_(std::move(data)), length_(length) {}
+  const uint16_t* data() const override { return data_.get(); }
+  size_t length() const override { return length_; }
+
+ private:
+  std::unique_ptr<uint16_t[]> data_;
+  size_t length_;
+};
+
+namespace mapped_source {
+
+inline bool IsAscii(const char* data, size_t length) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* end = p + length;
+  // Check eight bytes at a time while possible.
+  for (; p + sizeof(uint64_t) <= end; p += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    if (word & 0x8080808080808080ULL) {
+      return false;
+    }
+  }
+  for (; p < end; p++) {
+    if (*p & 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Decodes the UTF-8 sequence starting at data[*pos] and advances *pos.
+// Returns false for malformed, overlong or surrogate sequences.
+inline bool DecodeUtf8(const uint8_t* data, size_t length, size_t* pos,
+                       uint32_t* code_point) {
+  uint8_t lead = data[*pos];
+  size_t count;
+  uint32_t cp;
+  uint32_t min;
+  if (lead < 0x80) {
+    *code_point = lead;
+    *pos += 1;
+    return true;
+  } else if ((lead & 0xe0) == 0xc0) {
+    count = 1; cp = lead & 0x1f; min = 0x80;
+  } else if ((lead & 0xf0) == 0xe0) {
+    count = 2; cp = lead & 0x0f; min = 0x800;
+  } else if ((lead & 0xf8) == 0xf0) {
+    count = 3; cp = lead & 0x07; min = 0x10000;
+  } else {
+    return false;
+  }
+  if (count >= length - *pos) {
+    return false;
+  }
+  for (size_t i = 1; i <= count; i++) {
+    uint8_t c = data[*pos + i];
+    if ((c & 0xc0) != 0x80) {
+      return false;
+    }
+    cp = (cp << 6) | (c & 0x3f);
+  }
+  if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+    return false;
+  }
+  *code_point = cp;
+  *pos += count + 1;
+  return true;
+}
+
+// Returns the number of UTF-16 code units needed for data, and sets
+// *latin1 to whether all code points are <= 0xff. Returns false if data is
+// not valid UTF-8.
+inline bool MeasureUtf8(const char* data, size_t length, size_t* units,
+                        bool* latin1) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  size_t pos = 0;
+  *units = 0;
+  *latin1 = true;
+  while (pos < length) {
+    uint32_t cp;
+    if (!DecodeUtf8(bytes, length, &pos, &cp)) {
+      return false;
+    }
+    *units += cp > 0xffff ? 2 : 1;
+    if (cp > 0xff) {
+      *latin1 = false;
+    }
+  }
+  return true;
+}
+
+template <typename Char>
+inline void ConvertUtf8(const char* data, size_t length, Char* out) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  size_t pos = 0;
+  while (pos < length) {
+    uint32_t cp = 0;
+    DecodeUtf8(bytes, length, &pos, &cp);
+    if (cp > 0xffff) {
+      cp -= 0x10000;
+      *out++ = static_cast<Char>(0xd800 + (cp >> 10));
+      *out++ = static_cast<Char>(0xdc00 + (cp & 0x3ff));
+    } else {
+      *out++ = static_cast<Char>(cp);
+    }
+  }
+}
+
+}  // namespace mapped_source
+
+// Reads a file into a v8 string without copying it when possible.
+inline v8::MaybeLocal<v8::String> ReadFileMapped(v8::Isolate* isolate,
+                                                 const char* name) {
+  std::unique_ptr<MappedFile> file = MappedFile::Open(name);
+  if (!file) {
+    // Either the file does not exist or it is empty, and an empty file
+    // cannot be mapped.
+    FILE* f = fopen(name, "rb");
+    if (f == nullptr) {
+      return v8::MaybeLocal<v8::String>();
+    }
+    fclose(f);
+    return v8::String::Empty(isolate);
+  }
+
+  const char* data = file->data();
+  size_t size = file->size();
+  // V8 does not take ownership of a resource it refuses, so check the
+  // limit before creating one.
+  if (size > static_cast<size_t>(v8::String::kMaxLength)) {
+    return v8::MaybeLocal<v8::String>();
+  }
+  if (mapped_source::IsAscii(data, size)) {
+    return v8::String::NewExternalOneByte(isolate,
+        new MappedOneByteResource(std::move(file)));
+  }
+
+  size_t units;
+  bool latin1;
+  if (!mapped_source::MeasureUtf8(data, size, &units, &latin1)) {
+    return v8::String::NewFromUtf8(isolate, data, v8::NewStringType::kNormal,
+                                   static_cast<int>(size));
+  }
+  if (latin1) {
+    std::unique_ptr<char[]> chars(new char[units]);
+    mapped_source::ConvertUtf8(data, size, chars.get());
+    return v8::String::NewExternalOneByte(isolate,
+        new OwnedOneByteResource(std::move(chars), units));
+  }
+  std::unique_ptr<uint16_t[]> chars(new uint16_t[units]);
+  mapped_source::ConvertUtf8(data, size, chars.get());
+  return v8::String::NewExternalTwoByte(isolate,
+      new OwnedTwoByteResource(std::move(chars), units));
+}
+
+#endif  // SRC_MAPPED_SOURCE_H_
@@ -0,0 +1,37 @@
+#ifndef SRC_MEMORY_USAGE_H_
+#define SRC_MEMORY_USAGE_H_
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstddef>
+
+// Current resident set size of this process in bytes, read from
+// /proc/self/statm. Returns 0 if it could not be read.
+inline size_t CurrentRssBytes() {
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  unsigned long size = 0;
+  unsigned long resident = 0;
+  int n = fscanf(file, "%lu %lu", &size, &resident);
+  fclose(file);
+  if (n != 2) {
+    return 0;
+  }
+  return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Peak resident set size of this process in bytes.
+inline size_t PeakRssBytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  // ru_maxrss is in kilobytes on Linux.
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+#endif  // SRC_MEMORY_USAGE_H_
@@ -0,0 +1,191 @@
+#ifndef SRC_MICROTASK_SCHEDULER_H_
+#define SRC_MICROTASK_SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <memory>
+
+#include "v8.h"
+#include "histogram.h"
+
+// Owns a v8::MicrotaskQueue for the contexts created through it, and
+// decides when that queue is drained.
+//
+// Calling PerformMicrotaskCheckpoint after every EnqueueMicrotask, which is
+// what the isolate's default queue with kExplicit makes embedders do, pays
+// for entering and leaving the microtask machinery once per callback. Here
+// a checkpoint is only performed by MaybeCheckpoint once max_batch
+// microtasks are queued, or once max_delay_ms has passed since the queue
+// was first seen non-empty, whichever comes first. max_batch = 1 gives the
+// old checkpoint per microtask behaviour. Checkpoint drains the queue
+// regardless, embedders call it at the end of each macrotask.
+//
+// The queue is created with either MicrotasksPolicy::kExplicit or kScoped.
+// With kScoped, V8 expects calls into JavaScript to happen inside a
+// v8::MicrotasksScope, MicrotaskScheduler::Scope is one that checkpoints
+// through the batching policy when the outermost scope is left. Note that
+// microtask completed callbacks added with
+// Isolate::AddMicrotasksCompletedCallback are only called for the default
+// queue, use queue()->AddMicrotasksCompletedCallback for this one.
+//
+// Every checkpoint records the queue depth it started with and how long the
+// drain took. v8::MicrotaskQueue does not say how many microtasks it holds,
+// so the depth is the number queued through Enqueue since the last
+// checkpoint. Promise reactions, and anything else V8 or other code puts on
+// queue() directly, are not counted: they do not fill a batch, and only
+// show in the drain time.
+//
+// The scheduler has to outlive the contexts created with it, and be
+// destroyed before the isolate is disposed.
+class MicrotaskScheduler {
+ public:
+  struct Options {
+    v8::MicrotasksPolicy policy = v8::MicrotasksPolicy::kExplicit;
+    int max_batch = 64;
+    // 0 means there is no time limit, only max_batch.
+    double max_delay_ms = 1;
+  };
+
+  explicit MicrotaskScheduler(v8::Isolate* isolate)
+      : MicrotaskScheduler(isolate, Options()) {}
+
+  MicrotaskScheduler(v8::Isolate* isolate, const Options& options)
+      : isolate_(isolate), options_(options),
+        queue_(v8::MicrotaskQueue::New(isolate, options.policy)) {}
+
+  // Creates a context whose microtasks go to this scheduler's queue,
+  // promise reactions included.
+  v8::Local<v8::Context> NewContext(
+      v8::MaybeLocal<v8::ObjectTemplate> global_template =
+          v8::MaybeLocal<v8::ObjectTemplate>()) {
+    return v8::Context::New(isolate_, nullptr, global_template,
+                            v8::MaybeLocal<v8::Value>(),
+                            v8::DeserializeInternalFieldsCallback(),
+                            queue_.get());
+  }
+
+  void Enqueue(v8::Local<v8::Function> microtask) {
+    queue_->EnqueueMicrotask(isolate_, microtask);
+    enqueued_++;
+    MaybeCheckpoint();
+  }
+
+  void Enqueue(v8::MicrotaskCallback callback, void* data = nullptr) {
+    queue_->EnqueueMicrotask(isolate_, callback, data);
+    enqueued_++;
+    MaybeCheckpoint();
+  }
+
+  // Drains the queue if the batch is full or its time is up. Returns true if
+  // it did.
+  bool MaybeCheckpoint() {
+    if (!CanCheckpoint()) {
+      return false;
+    }
+    if (enqueued_ == 0) {
+      batch_started_ = false;
+      return false;
+    }
+    if (enqueued_ < options_.max_batch) {
+      if (options_.max_delay_ms <= 0) {
+        return false;
+      }
+      Clock::time_point now = Clock::now();
+      if (!batch_started_) {
+        batch_started_ = true;
+        batch_start_ = now;
+        return false;
+      }
+      if (std::chrono::duration<double, std::milli>(now - batch_start_).count() <
+          options_.max_delay_ms) {
+        return false;
+      }
+    }
+    return Checkpoint();
+  }
+
+  // Drains the queue, including microtasks queued while it runs. Like
+  // MicrotaskQueue::PerformCheckpoint, does nothing inside a
+  // MicrotasksScope or while microtasks are already being run. Returns
+  // true if it drained the queue, which may have held only microtasks that
+  // were not counted.
+  bool Checkpoint() {
+    if (!CanCheckpoint()) {
+      return false;
+    }
+    int depth = enqueued_;
+    enqueued_ = 0;
+    batch_started_ = false;
+    Clock::time_point start = Clock::now();
+    queue_->PerformCheckpoint(isolate_);
+    depth_.Record(static_cast<uint64_t>(depth));
+    drain_ns_.Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start).count()));
+    return true;
+  }
+
+  // A v8::MicrotasksScope for the scheduler's queue that does not run
+  // microtasks itself. When the outermost one is left, MaybeCheckpoint
+  // decides whether to drain the queue.
+  class Scope {
+   public:
+    explicit Scope(MicrotaskScheduler* scheduler)
+        : scheduler_(scheduler),
+          scope_(new v8::MicrotasksScope(
+              scheduler->isolate_, scheduler->queue_.get(),
+              v8::MicrotasksScope::kDoNotRunMicrotasks)) {}
+
+    ~Scope() {
+      // The checkpoint would be skipped with the v8 scope still open.
+      scope_.reset();
+      scheduler_->MaybeCheckpoint();
+    }
+
+   private:
+    MicrotaskScheduler* scheduler_;
+    std::unique_ptr<v8::MicrotasksScope> scope_;
+  };
+
+  v8::MicrotaskQueue* queue() const { return queue_.get(); }
+  // Microtasks queued through Enqueue since the last checkpoint.
+  int pending() const { return enqueued_; }
+
+  // Microtasks queued through Enqueue before each checkpoint, not counting
+  // the ones they queued in turn.
+  const Histogram& depth() const { return depth_; }
+  // Nanoseconds each checkpoint took.
+  const Histogram& drain_time() const { return drain_ns_; }
+
+  void Dump(FILE* file) const {
+    fprintf(file, "microtasks: checkpoints %llu, depth mean %.1f p99 %llu max %llu, "
+            "drain p50 %lluns p99 %lluns max %lluns\n",
+            static_cast<unsigned long long>(depth_.count()), depth_.mean(),
+            static_cast<unsigned long long>(depth_.Percentile(99)),
+            static_cast<unsigned long long>(depth_.max()),
+            static_cast<unsigned long long>(drain_ns_.Percentile(50)),
+            static_cast<unsigned long long>(drain_ns_.Percentile(99)),
+            static_cast<unsigned long long>(drain_ns_.max()));
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  bool CanCheckpoint() const {
+    return !queue_->IsRunningMicrotasks() &&
+           queue_->GetMicrotasksScopeDepth() == 0;
+  }
+
+  v8::Isolate* isolate_;
+  Options options_;
+  std::unique_ptr<v8::MicrotaskQueue> queue_;
+  int enqueued_ = 0;
+  bool batch_started_ = false;
+  Clock::time_point batch_start_;
+  Histogram depth_;
+  Histogram drain_ns_;
+};
+
+#endif  // SRC_MICROTASK_SCHEDULER_H_
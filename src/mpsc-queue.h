@@ -0,0 +1,79 @@
+#ifndef SRC_MPSC_QUEUE_H_
+#define SRC_MPSC_QUEUE_H_
+
+#include <atomic>
+
+// A node of an MpscQueue. Objects that are queued derive from it, so
+// pushing does not allocate.
+struct MpscNode {
+  std::atomic<MpscNode*> next{nullptr};
+};
+
+// An intrusive multi-producer/single-consumer queue (Dmitry Vyukov's):
+// Push is one atomic exchange and can be called from any number of threads,
+// Pop only from one thread at a time. Neither blocks or takes a lock.
+//
+// A Push that has done its exchange but not yet linked its node makes the
+// nodes behind it invisible to Pop for that moment, Pop then returns
+// nullptr although the queue is not empty. Consumers that need to know
+// that everything pushed before some point has been popped have to be told
+// by the producer after its Push returned, see task-injector.h.
+class MpscQueue {
+ public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  void Push(MpscNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Returns the oldest node, or nullptr if there is none (or the next one
+  // is still being pushed).
+  MpscNode* Pop() {
+    MpscNode* tail = tail_;
+    MpscNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    // tail is the last node, put the stub behind it so it can be taken.
+    Push(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+  // Only meaningful on the consumer thread, and only as a hint while
+  // producers are pushing.
+  bool empty() const {
+    return tail_ == &stub_ && stub_.next.load(std::memory_order_acquire) == nullptr;
+  }
+
+ private:
+  // Producers only touch head_, the consumer mostly tail_, keep them on
+  // different cache lines.
+  std::atomic<MpscNode*> head_;
+  char padding_[64 - sizeof(std::atomic<MpscNode*>)];
+  MpscNode* tail_;
+  MpscNode stub_;
+};
+
+#endif  // SRC_MPSC_QUEUE_H_
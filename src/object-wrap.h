@@ -0,0 +1,77 @@
+#ifndef SRC_OBJECT_WRAP_H_
+#define SRC_OBJECT_WRAP_H_
+
+#include <stdint.h>
+
+#include "v8.h"
+
+// Base class for native objects that back a JavaScript object.
+//
+// Wrap stores the native object in internal field 0 of the JavaScript
+// object and keeps a weak Global to it. When the JavaScript object is
+// garbage collected the native object is deleted. The size reported by the
+// subclass is added to the isolate's external memory with
+// AdjustAmountOfExternalAllocatedMemory so that V8 takes the native memory
+// into account when deciding when to collect garbage.
+//
+// Objects that are still alive when the isolate is disposed are not
+// deleted, V8 does not run weak callbacks on Dispose.
+class ObjectWrap {
+ public:
+  virtual ~ObjectWrap() {
+    if (!handle_.IsEmpty()) {
+      handle_.ClearWeak();
+      handle_.Reset();
+    }
+    if (isolate_ != nullptr && external_size_ > 0) {
+      isolate_->AdjustAmountOfExternalAllocatedMemory(-external_size_);
+    }
+  }
+
+  template <typename T>
+  static T* Unwrap(v8::Local<v8::Object> object) {
+    ObjectWrap* wrap = static_cast<ObjectWrap*>(
+        object->GetAlignedPointerFromInternalField(0));
+    return static_cast<T*>(wrap);
+  }
+
+  v8::Local<v8::Object> object(v8::Isolate* isolate) const {
+    return handle_.Get(isolate);
+  }
+
+ protected:
+  ObjectWrap() = default;
+
+  void Wrap(v8::Isolate* isolate, v8::Local<v8::Object> object,
+            size_t external_size) {
+    object->SetAlignedPointerInInternalField(0, this);
+    handle_.Reset(isolate, object);
+    handle_.SetWeak(this, FirstPassCallback, v8::WeakCallbackType::kParameter);
+    isolate_ = isolate;
+    external_size_ = static_cast<int64_t>(external_size);
+    isolate_->AdjustAmountOfExternalAllocatedMemory(external_size_);
+  }
+
+ private:
+  ObjectWrap(const ObjectWrap&) = delete;
+  ObjectWrap& operator=(const ObjectWrap&) = delete;
+
+  // The first pass runs during garbage collection where only the handle may
+  // be reset. Deleting the object calls into V8 to adjust the external
+  // memory so that is done in the second pass.
+  static void FirstPassCallback(const v8::WeakCallbackInfo<ObjectWrap>& info) {
+    ObjectWrap* wrap = info.GetParameter();
+    wrap->handle_.Reset();
+    info.SetSecondPassCallback(SecondPassCallback);
+  }
+
+  static void SecondPassCallback(const v8::WeakCallbackInfo<ObjectWrap>& info) {
+    delete info.GetParameter();
+  }
+
+  v8::Global<v8::Object> handle_;
+  v8::Isolate* isolate_ = nullptr;
+  int64_t external_size_ = 0;
+};
+
+#endif  // SRC_OBJECT_WRAP_H_
@@ -0,0 +1,186 @@
+#ifndef SRC_OUTPUT_SINK_H_
+#define SRC_OUTPUT_SINK_H_
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "v8.h"
+#include "isolate-data.h"
+
+// A per-isolate output buffer for the print binding.
+//
+// Strings are written as UTF-8 directly from the V8 string into the buffer
+// using String::WriteUtf8, so there is no intermediate String::Utf8Value
+// copy. The buffer is written to the file descriptor when it reaches the
+// threshold, after every microtask checkpoint, when Flush is called and when
+// the sink is destroyed.
+//
+// With a background writer the write(2) calls happen on a separate thread:
+// a full buffer is handed over to the writer and the isolate thread
+// continues with a spare one. Buffers are written in the order they were
+// handed over.
+class OutputSink {
+ public:
+  OutputSink(v8::Isolate* isolate, int fd = STDOUT_FILENO,
+             size_t threshold = 64 * 1024, bool background_writer = false)
+      : isolate_(isolate), fd_(fd), threshold_(threshold) {
+    current_.Reserve(threshold_);
+    if (background_writer) {
+      writer_ = std::thread(&OutputSink::WriterMain, this);
+    }
+    isolate_->SetData(kOutputSinkSlot, this);
+    isolate_->AddMicrotasksCompletedCallback(OnMicrotasksCompleted, this);
+  }
+
+  ~OutputSink() {
+    Flush();
+    if (writer_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      cv_.notify_one();
+      writer_.join();
+    }
+    isolate_->RemoveMicrotasksCompletedCallback(OnMicrotasksCompleted, this);
+    isolate_->SetData(kOutputSinkSlot, nullptr);
+  }
+
+  // Returns the sink installed for isolate, or nullptr if there is none.
+  static OutputSink* From(v8::Isolate* isolate) {
+    return static_cast<OutputSink*>(isolate->GetData(kOutputSinkSlot));
+  }
+
+  void Append(v8::Local<v8::String> str) {
+    int length = str->Utf8Length(isolate_);
+    char* dest = Reserve(static_cast<size_t>(length));
+    str->WriteUtf8(isolate_, dest, length, nullptr,
+                   v8::String::NO_NULL_TERMINATION |
+                   v8::String::REPLACE_INVALID_UTF8);
+    Commit(static_cast<size_t>(length));
+  }
+
+  void Append(const char* data, size_t length) {
+    memcpy(Reserve(length), data, length);
+    Commit(length);
+  }
+
+  void Flush() {
+    if (current_.size == 0) {
+      return;
+    }
+    if (!writer_.joinable()) {
+      WriteAll(current_.data.get(), current_.size);
+      current_.size = 0;
+      return;
+    }
+    Buffer spare;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.push_back(std::move(current_));
+      if (!free_.empty()) {
+        spare = std::move(free_.back());
+        free_.pop_back();
+      }
+    }
+    cv_.notify_one();
+    current_ = std::move(spare);
+    current_.Reserve(threshold_);
+  }
+
+  size_t threshold() const { return threshold_; }
+
+ private:
+  struct Buffer {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    void Reserve(size_t needed) {
+      if (needed <= capacity) {
+        return;
+      }
+      size_t new_capacity = capacity == 0 ? needed : capacity;
+      while (new_capacity < needed) {
+        new_capacity *= 2;
+      }
+      std::unique_ptr<char[]> new_data(new char[new_capacity]);
+      if (size > 0) {
+        memcpy(new_data.get(), data.get(), size);
+      }
+      data = std::move(new_data);
+      capacity = new_capacity;
+    }
+  };
+
+  // Returns space for length bytes at the end of the buffer, flushing
+  // first if they would push the buffer past the threshold.
+  char* Reserve(size_t length) {
+    if (current_.size + length > threshold_) {
+      Flush();
+    }
+    current_.Reserve(current_.size + length);
+    return current_.data.get() + current_.size;
+  }
+
+  void Commit(size_t length) {
+    current_.size += length;
+  }
+
+  void WriteAll(const char* data, size_t length) {
+    while (length > 0) {
+      ssize_t n = write(fd_, data, length);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return;
+      }
+      data += n;
+      length -= static_cast<size_t>(n);
+    }
+  }
+
+  void WriterMain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+      if (pending_.empty()) {
+        return;
+      }
+      Buffer buffer = std::move(pending_.front());
+      pending_.pop_front();
+      lock.unlock();
+      WriteAll(buffer.data.get(), buffer.size);
+      buffer.size = 0;
+      lock.lock();
+      free_.push_back(std::move(buffer));
+    }
+  }
+
+  static void OnMicrotasksCompleted(v8::Isolate* isolate, void* data) {
+    static_cast<OutputSink*>(data)->Flush();
+  }
+
+  v8::Isolate* isolate_;
+  int fd_;
+  size_t threshold_;
+  Buffer current_;
+
+  std::thread writer_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Buffer> pending_;
+  std::vector<Buffer> free_;
+  bool stopping_ = false;
+};
+
+#endif  // SRC_OUTPUT_SINK_H_
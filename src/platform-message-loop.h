@@ -0,0 +1,124 @@
+#ifndef SRC_PLATFORM_MESSAGE_LOOP_H_
+#define SRC_PLATFORM_MESSAGE_LOOP_H_
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+
+// v8::platform::PumpMessageLoop only works with the platform created by
+// NewDefaultPlatform, it casts the v8::Platform* it is given. The platforms
+// in src/ implement this interface and register themselves, so that code
+// which is only given a v8::Platform* can run foreground tasks with
+// PumpPlatformMessageLoop, and idle tasks with RunPlatformIdleTasks,
+// whichever platform it is, ask for idle tasks with
+// SetPlatformIdleTasksEnabled, and tell it that an isolate is going away with
+// NotifyPlatformIsolateShutdown. Without RTTI this registry is how we find out
+// what a v8::Platform* is.
+class PlatformMessageLoop {
+ public:
+  virtual ~PlatformMessageLoop() {}
+
+  // Runs one foreground task for isolate. Returns false if there was none,
+  // after waiting for one if wait is true.
+  virtual bool PumpMessageLoop(v8::Isolate* isolate, bool wait) = 0;
+
+  // Runs idle tasks for isolate for at most idle_time_in_seconds.
+  virtual void RunIdleTasks(v8::Isolate* isolate, double idle_time_in_seconds) = 0;
+
+  // Whether IdleTasksEnabled(isolate) says yes. Only isolates whose thread
+  // calls RunIdleTasks should have idle tasks, otherwise the work V8 puts in
+  // them is never done. Off until enabled.
+  virtual void SetIdleTasksEnabled(v8::Isolate* isolate, bool enabled) = 0;
+
+  // Drops whatever the platform keeps for isolate, its foreground task
+  // runner and the tasks still queued on it. Called right before the
+  // isolate is disposed, after which its address can be reused by a new one.
+  virtual void NotifyIsolateShutdown(v8::Isolate* isolate) = 0;
+
+  static void Register(v8::Platform* platform, PlatformMessageLoop* loop) {
+    std::lock_guard<std::mutex> lock(mutex());
+    entries().emplace_back(platform, loop);
+  }
+
+  static void Unregister(v8::Platform* platform) {
+    std::lock_guard<std::mutex> lock(mutex());
+    std::vector<Entry>& list = entries();
+    list.erase(std::remove_if(list.begin(), list.end(),
+                              [platform](const Entry& entry) {
+                                return entry.first == platform;
+                              }), list.end());
+  }
+
+  // Returns the message loop registered for platform, or nullptr if it is
+  // not one of ours.
+  static PlatformMessageLoop* From(v8::Platform* platform) {
+    std::lock_guard<std::mutex> lock(mutex());
+    for (const Entry& entry : entries()) {
+      if (entry.first == platform) {
+        return entry.second;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  typedef std::pair<v8::Platform*, PlatformMessageLoop*> Entry;
+
+  static std::mutex& mutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static std::vector<Entry>& entries() {
+    static std::vector<Entry> entries;
+    return entries;
+  }
+};
+
+inline bool PumpPlatformMessageLoop(v8::Platform* platform, v8::Isolate* isolate,
+                                    bool wait = false) {
+  PlatformMessageLoop* loop = PlatformMessageLoop::From(platform);
+  if (loop != nullptr) {
+    return loop->PumpMessageLoop(isolate, wait);
+  }
+  return v8::platform::PumpMessageLoop(platform, isolate,
+      wait ? v8::platform::MessageLoopBehavior::kWaitForWork
+           : v8::platform::MessageLoopBehavior::kDoNotWait);
+}
+
+inline void RunPlatformIdleTasks(v8::Platform* platform, v8::Isolate* isolate,
+                                 double idle_time_in_seconds) {
+  PlatformMessageLoop* loop = PlatformMessageLoop::From(platform);
+  if (loop != nullptr) {
+    loop->RunIdleTasks(isolate, idle_time_in_seconds);
+    return;
+  }
+  v8::platform::RunIdleTasks(platform, isolate, idle_time_in_seconds);
+}
+
+// The DefaultPlatform decides for all isolates when it is created, see
+// v8::platform::IdleTaskSupport, so this does nothing for it.
+inline void SetPlatformIdleTasksEnabled(v8::Platform* platform,
+                                        v8::Isolate* isolate, bool enabled) {
+  PlatformMessageLoop* loop = PlatformMessageLoop::From(platform);
+  if (loop != nullptr) {
+    loop->SetIdleTasksEnabled(isolate, enabled);
+  }
+}
+
+// Call before isolate->Dispose() for every isolate that ran on platform.
+inline void NotifyPlatformIsolateShutdown(v8::Platform* platform,
+                                          v8::Isolate* isolate) {
+  PlatformMessageLoop* loop = PlatformMessageLoop::From(platform);
+  if (loop != nullptr) {
+    loop->NotifyIsolateShutdown(isolate);
+    return;
+  }
+  v8::platform::NotifyIsolateShutdown(platform, isolate);
+}
+
+#endif  // SRC_PLATFORM_MESSAGE_LOOP_H_
@@ -0,0 +1,339 @@
+#ifndef SRC_POOLED_ALLOCATOR_H_
+#define SRC_POOLED_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "v8.h"
+
+// An ArrayBuffer::Allocator that pools backing store memory by size class
+// instead of going to calloc and free for every buffer.
+//
+// Lengths are rounded up to a power of two between 16 bytes and 1MB. Each
+// class carves its blocks out of 2MB chunks, mapped 2MB aligned; chunks of
+// classes of 64KB and up are madvised MADV_HUGEPAGE so big buffers are
+// backed by transparent huge pages. Freed blocks go on a free list of the
+// thread that freed them and are reused by the next allocation of their
+// class on that thread; a thread that caches more than kThreadCacheBytes of
+// a class hands half of them to a list shared by all threads. Like
+// SlabAllocator chunks are only unmapped when the allocator is destroyed, so
+// memory use stays at the high water mark of live buffers.
+//
+// Zeroing is lazy: blocks that were never used come from fresh mappings,
+// which are zero already, and only reused blocks are cleared, and only up
+// to the requested length. AllocateUninitialized clears nothing. Lengths
+// above 1MB are mapped and unmapped one by one.
+//
+// Allocate and Free can be called from any thread, V8 frees backing stores
+// from its background threads too. The caches of threads that exited stay
+// with the allocator until it is destroyed.
+class PooledArrayBufferAllocator : public v8::ArrayBuffer::Allocator {
+ public:
+  struct Stats {
+    // Bytes of the blocks (or mappings) that back live buffers.
+    size_t bytes_live;
+    // Bytes of free blocks waiting to be reused.
+    size_t bytes_cached;
+    // Bytes mapped for chunks.
+    size_t bytes_reserved;
+    // Allocations that reused a cached block, and those that did not.
+    uint64_t hits;
+    uint64_t misses;
+
+    double hit_rate() const {
+      uint64_t total = hits + misses;
+      return total == 0 ? 0 : static_cast<double>(hits) / total;
+    }
+  };
+
+  static const size_t kMinClassSize = 16;
+  static const size_t kMaxClassSize = 1 << 20;
+  static const size_t kHugePageClassSize = 64 * 1024;
+  static const size_t kChunkSize = 2 << 20;
+  static const size_t kThreadCacheBytes = 1 << 20;
+
+  PooledArrayBufferAllocator() : id_(NextId()) {}
+
+  PooledArrayBufferAllocator(const PooledArrayBufferAllocator&) = delete;
+  PooledArrayBufferAllocator& operator=(const PooledArrayBufferAllocator&) = delete;
+
+  ~PooledArrayBufferAllocator() override {
+    for (void* chunk : chunks_) {
+      munmap(chunk, kChunkSize);
+    }
+  }
+
+  void* Allocate(size_t length) override {
+    bool fresh;
+    void* data = Take(length, &fresh);
+    if (data != nullptr && !fresh) {
+      memset(data, 0, length);
+    }
+    return data;
+  }
+
+  void* AllocateUninitialized(size_t length) override {
+    bool fresh;
+    return Take(length, &fresh);
+  }
+
+  void Free(void* data, size_t length) override {
+    if (data == nullptr) {
+      return;
+    }
+    if (length > kMaxClassSize) {
+      size_t mapped = PageAlign(length);
+      munmap(data, mapped);
+      bytes_live_.fetch_sub(mapped, std::memory_order_relaxed);
+      return;
+    }
+    size_t index = ClassIndex(length);
+    size_t size = ClassSize(index);
+    bytes_live_.fetch_sub(size, std::memory_order_relaxed);
+    bytes_cached_.fetch_add(size, std::memory_order_relaxed);
+
+    ThreadCache* cache = CurrentThreadCache();
+    FreeList& list = cache->lists[index];
+    FreeBlock* block = static_cast<FreeBlock*>(data);
+    block->next = list.head;
+    list.head = block;
+    list.count++;
+    if (list.count * size > kThreadCacheBytes && list.count > 1) {
+      Spill(index, &list);
+    }
+  }
+
+  Stats stats() const {
+    Stats stats;
+    stats.bytes_live = bytes_live_.load(std::memory_order_relaxed);
+    stats.bytes_cached = bytes_cached_.load(std::memory_order_relaxed);
+    stats.bytes_reserved = bytes_reserved_.load(std::memory_order_relaxed);
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+ private:
+  static const size_t kClassCount = 17;  // 16 bytes to 1MB.
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct FreeList {
+    FreeBlock* head = nullptr;
+    size_t count = 0;
+  };
+
+  struct ThreadCache {
+    FreeList lists[kClassCount];
+  };
+
+  // Blocks spilled by thread caches and the unused rest of the chunk a
+  // class carves from, under mutex_.
+  struct SharedClass {
+    FreeList list;
+    char* next = nullptr;
+    char* end = nullptr;
+  };
+
+  static uint64_t NextId() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static size_t ClassIndex(size_t length) {
+    size_t index = 0;
+    size_t size = kMinClassSize;
+    while (size < length) {
+      size <<= 1;
+      index++;
+    }
+    return index;
+  }
+
+  static size_t ClassSize(size_t index) {
+    return kMinClassSize << index;
+  }
+
+  static size_t PageAlign(size_t length) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (length + page - 1) & ~(page - 1);
+  }
+
+  void* Take(size_t length, bool* fresh) {
+    if (length > kMaxClassSize) {
+      size_t mapped = PageAlign(length);
+      void* data = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (data == MAP_FAILED) {
+        return nullptr;
+      }
+      if (mapped >= kChunkSize) {
+        madvise(data, mapped, MADV_HUGEPAGE);
+      }
+      *fresh = true;
+      misses_.fetch_add(1, std::memory_order_relaxed);
+      bytes_live_.fetch_add(mapped, std::memory_order_relaxed);
+      return data;
+    }
+    size_t index = ClassIndex(length);
+    size_t size = ClassSize(index);
+    FreeList& list = CurrentThreadCache()->lists[index];
+    if (list.head == nullptr) {
+      Refill(index, &list);
+    }
+    void* data;
+    if (list.head != nullptr) {
+      FreeBlock* block = list.head;
+      list.head = block->next;
+      list.count--;
+      data = block;
+      *fresh = false;
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      bytes_cached_.fetch_sub(size, std::memory_order_relaxed);
+    } else {
+      data = Carve(index);
+      if (data == nullptr) {
+        return nullptr;
+      }
+      *fresh = true;
+      misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bytes_live_.fetch_add(size, std::memory_order_relaxed);
+    return data;
+  }
+
+  // Moves up to half a thread cache's worth of shared blocks to list.
+  void Refill(size_t index, FreeList* list) {
+    size_t size = ClassSize(index);
+    size_t wanted = kThreadCacheBytes / size / 2;
+    if (wanted == 0) {
+      wanted = 1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeList& shared = shared_[index].list;
+    while (shared.head != nullptr && list->count < wanted) {
+      FreeBlock* block = shared.head;
+      shared.head = block->next;
+      shared.count--;
+      block->next = list->head;
+      list->head = block;
+      list->count++;
+    }
+  }
+
+  // Moves half of list, which has at least two blocks, to the shared list
+  // of its class.
+  void Spill(size_t index, FreeList* list) {
+    size_t keep = list->count / 2;
+    FreeBlock* last_kept = list->head;
+    for (size_t i = 1; i < keep; i++) {
+      last_kept = last_kept->next;
+    }
+    FreeBlock* spilled = last_kept->next;
+    last_kept->next = nullptr;
+    size_t count = list->count - keep;
+    list->count = keep;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeList& shared = shared_[index].list;
+    while (spilled != nullptr) {
+      FreeBlock* next = spilled->next;
+      spilled->next = shared.head;
+      shared.head = spilled;
+      spilled = next;
+    }
+    shared.count += count;
+  }
+
+  // Takes a never used block of class index, mapping a new chunk if the
+  // class has used up its current one.
+  void* Carve(size_t index) {
+    size_t size = ClassSize(index);
+    std::lock_guard<std::mutex> lock(mutex_);
+    SharedClass& shared = shared_[index];
+    if (shared.next == shared.end) {
+      char* chunk = static_cast<char*>(MapChunk(size >= kHugePageClassSize));
+      if (chunk == nullptr) {
+        return nullptr;
+      }
+      shared.next = chunk;
+      shared.end = chunk + kChunkSize;
+    }
+    void* data = shared.next;
+    shared.next += size;
+    return data;
+  }
+
+  // Maps kChunkSize bytes aligned to kChunkSize, which is what lets the
+  // kernel back a chunk with one huge page. Called with mutex_ held.
+  void* MapChunk(bool huge_pages) {
+    void* mapping = mmap(nullptr, 2 * kChunkSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(mapping);
+    uintptr_t aligned = (start + kChunkSize - 1) & ~(kChunkSize - 1);
+    if (aligned > start) {
+      munmap(mapping, aligned - start);
+    }
+    munmap(reinterpret_cast<void*>(aligned + kChunkSize),
+           start + 2 * kChunkSize - aligned - kChunkSize);
+    void* chunk = reinterpret_cast<void*>(aligned);
+    if (huge_pages) {
+      madvise(chunk, kChunkSize, MADV_HUGEPAGE);
+    }
+    chunks_.push_back(chunk);
+    bytes_reserved_.fetch_add(kChunkSize, std::memory_order_relaxed);
+    return chunk;
+  }
+
+  // The calling thread's cache of this allocator. The last one used is
+  // remembered per thread, so only a thread switching between allocators
+  // looks it up under the lock.
+  ThreadCache* CurrentThreadCache() {
+    struct LastUsed {
+      uint64_t id;
+      ThreadCache* cache;
+    };
+    static thread_local LastUsed last_used = {0, nullptr};
+    if (last_used.id == id_) {
+      return last_used.cache;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<ThreadCache>& cache = caches_[std::this_thread::get_id()];
+    if (cache == nullptr) {
+      cache.reset(new ThreadCache());
+    }
+    last_used.id = id_;
+    last_used.cache = cache.get();
+    return cache.get();
+  }
+
+  // Identifies the allocator to the per thread lookup in place of its
+  // address, which a later allocator could get.
+  const uint64_t id_;
+  std::mutex mutex_;
+  SharedClass shared_[kClassCount];
+  std::vector<void*> chunks_;
+  std::unordered_map<std::thread::id, std::unique_ptr<ThreadCache>> caches_;
+  std::atomic<size_t> bytes_live_{0};
+  std::atomic<size_t> bytes_cached_{0};
+  std::atomic<size_t> bytes_reserved_{0};
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+};
+
+#endif  // SRC_POOLED_ALLOCATOR_H_
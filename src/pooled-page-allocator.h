@@ -0,0 +1,368 @@
+#ifndef SRC_POOLED_PAGE_ALLOCATOR_H_
+#define SRC_POOLED_PAGE_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+#include "platform-message-loop.h"
+
+// A v8::PageAllocator that keeps the address space reservations V8 frees
+// and hands them out again, instead of every isolate mmapping and
+// munmapping its pointer compression cage, code range and heap
+// reservations anew.
+//
+// Everything is done by the wrapped allocator, the platform's usually,
+// except that:
+//  - A kNoAccess reservation of at least min_pooled_size that is freed
+//    whole is reset to what a fresh one looks like, PROT_NONE and its pages
+//    dropped with MADV_DONTNEED so they read as zero, and pooled. The next
+//    reservation of the same length whose alignment it satisfies gets it;
+//    the address hint is ignored then. At most max_pooled_bytes of address
+//    space are kept, Trim frees them.
+//  - Pages committed read-write are madvised MADV_HUGEPAGE if the range is
+//    at least 2MB (large object pages, mostly), when huge_pages is set, so
+//    they can be backed by transparent huge pages.
+//  - With prefault, committed pages are faulted in right away with
+//    MADV_POPULATE_WRITE (or by touching them on kernels without it),
+//    rather than one at a time when V8 first writes them.
+//
+// V8 takes the page allocator from the platform when it is initialized,
+// PageAllocatorPlatform below is a platform that returns one of these.
+// set_enabled(false) makes it a plain pass-through from then on, which is
+// how the default can be compared with it in the same process.
+class PooledPageAllocator : public v8::PageAllocator {
+ public:
+  struct Options {
+    size_t min_pooled_size = 1 << 20;
+    // Address space, not memory: pooled reservations have no pages.
+    size_t max_pooled_bytes = static_cast<size_t>(64) << 30;
+    bool huge_pages = true;
+    bool prefault = false;
+  };
+
+  struct Stats {
+    // Reservations handed out from the pool and by the wrapped allocator.
+    uint64_t reused;
+    uint64_t reserved;
+    size_t pooled_bytes;
+  };
+
+  static const size_t kHugePageSize = 2 << 20;
+
+  explicit PooledPageAllocator(v8::PageAllocator* page_allocator)
+      : PooledPageAllocator(page_allocator, Options()) {}
+
+  PooledPageAllocator(v8::PageAllocator* page_allocator, const Options& options)
+      : page_allocator_(page_allocator), options_(options) {}
+
+  PooledPageAllocator(const PooledPageAllocator&) = delete;
+  PooledPageAllocator& operator=(const PooledPageAllocator&) = delete;
+
+  ~PooledPageAllocator() override {
+    Trim();
+  }
+
+  size_t AllocatePageSize() override {
+    return page_allocator_->AllocatePageSize();
+  }
+
+  size_t CommitPageSize() override {
+    return page_allocator_->CommitPageSize();
+  }
+
+  void SetRandomMmapSeed(int64_t seed) override {
+    page_allocator_->SetRandomMmapSeed(seed);
+  }
+
+  void* GetRandomMmapAddr() override {
+    return page_allocator_->GetRandomMmapAddr();
+  }
+
+  void* AllocatePages(void* address, size_t length, size_t alignment,
+                      Permission permissions) override {
+    bool poolable = enabled() && permissions == kNoAccess &&
+                    length >= options_.min_pooled_size;
+    if (poolable) {
+      void* pooled = TakePooled(length, alignment);
+      if (pooled != nullptr) {
+        return pooled;
+      }
+    }
+    void* region = page_allocator_->AllocatePages(address, length, alignment,
+                                                  permissions);
+    if (region != nullptr && poolable) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      reservations_[region] = length;
+      reserved_++;
+    }
+    return region;
+  }
+
+  bool FreePages(void* address, size_t length) override {
+    if (Pool(address, length)) {
+      return true;
+    }
+    return page_allocator_->FreePages(address, length);
+  }
+
+  bool ReleasePages(void* address, size_t length, size_t new_length) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = reservations_.find(address);
+      if (it != reservations_.end()) {
+        it->second = new_length;
+      }
+    }
+    return page_allocator_->ReleasePages(address, length, new_length);
+  }
+
+  bool SetPermissions(void* address, size_t length,
+                      Permission permissions) override {
+    if (!page_allocator_->SetPermissions(address, length, permissions)) {
+      return false;
+    }
+    if (permissions == kReadWrite && enabled()) {
+      if (options_.huge_pages && length >= kHugePageSize) {
+        madvise(address, length, MADV_HUGEPAGE);
+      }
+      if (options_.prefault) {
+        Prefault(address, length);
+      }
+    }
+    return true;
+  }
+
+  bool DiscardSystemPages(void* address, size_t size) override {
+    return page_allocator_->DiscardSystemPages(address, size);
+  }
+
+  // Not override: only pure virtual in V8 versions that have it.
+  bool DecommitPages(void* address, size_t size) {
+    return page_allocator_->SetPermissions(address, size, kNoAccess) &&
+           page_allocator_->DiscardSystemPages(address, size);
+  }
+
+  // Faults in the pages of a range that is readable and writable.
+  void Prefault(void* address, size_t length) {
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(address, length, MADV_POPULATE_WRITE) == 0) {
+      return;
+    }
+#endif
+    size_t page = CommitPageSize();
+    volatile char* start = static_cast<volatile char*>(address);
+    for (size_t offset = 0; offset < length; offset += page) {
+      start[offset] = start[offset];
+    }
+  }
+
+  // Frees the pooled reservations.
+  void Trim() {
+    std::multimap<size_t, void*> pool;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pool.swap(pool_);
+      for (auto& entry : pool) {
+        reservations_.erase(entry.second);
+      }
+      pooled_bytes_ = 0;
+    }
+    for (auto& entry : pool) {
+      page_allocator_->FreePages(entry.second, entry.first);
+    }
+  }
+
+  // Reservations handed out before disabling are still pooled when freed,
+  // until Trim.
+  void set_enabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  bool enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.reused = reused_;
+    stats.reserved = reserved_;
+    stats.pooled_bytes = pooled_bytes_;
+    return stats;
+  }
+
+ private:
+  void* TakePooled(size_t length, size_t alignment) {
+    if (alignment == 0) {
+      alignment = 1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto range = pool_.equal_range(length);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (reinterpret_cast<uintptr_t>(it->second) % alignment == 0) {
+        void* region = it->second;
+        pool_.erase(it);
+        pooled_bytes_ -= length;
+        reused_++;
+        return region;
+      }
+    }
+    return nullptr;
+  }
+
+  // Keeps a whole reservation that was handed out by AllocatePages, if
+  // there is room. Returns false if the caller has to free it.
+  bool Pool(void* address, size_t length) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = reservations_.find(address);
+      if (it == reservations_.end()) {
+        return false;
+      }
+      if (it->second != length ||
+          pooled_bytes_ + length > options_.max_pooled_bytes) {
+        reservations_.erase(it);
+        return false;
+      }
+      // Counted now so that concurrent frees do not overshoot the limit.
+      pooled_bytes_ += length;
+    }
+    bool reset = mprotect(address, length, PROT_NONE) == 0 &&
+                 madvise(address, length, MADV_DONTNEED) == 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!reset) {
+      pooled_bytes_ -= length;
+      reservations_.erase(address);
+      return false;
+    }
+    pool_.emplace(length, address);
+    return true;
+  }
+
+  v8::PageAllocator* page_allocator_;
+  const Options options_;
+  std::atomic<bool> enabled_{true};
+  mutable std::mutex mutex_;
+  // Reservations that may be pooled when they are freed, by address.
+  std::unordered_map<void*, size_t> reservations_;
+  // Pooled reservations by length.
+  std::multimap<size_t, void*> pool_;
+  size_t pooled_bytes_ = 0;
+  uint64_t reused_ = 0;
+  uint64_t reserved_ = 0;
+};
+
+// A v8::Platform that forwards everything to another platform but returns
+// its own page allocator, a PooledPageAllocator over the platform's one.
+// It has to be given to V8::InitializePlatform, V8 asks for the page
+// allocator once.
+//
+//   PageAllocatorPlatform platform(platform::NewDefaultPlatform());
+//   V8::InitializePlatform(&platform);
+class PageAllocatorPlatform : public v8::Platform, public PlatformMessageLoop {
+ public:
+  explicit PageAllocatorPlatform(std::unique_ptr<v8::Platform> platform)
+      : PageAllocatorPlatform(std::move(platform), PooledPageAllocator::Options()) {}
+
+  PageAllocatorPlatform(std::unique_ptr<v8::Platform> platform,
+                        const PooledPageAllocator::Options& options)
+      : platform_(std::move(platform)),
+        page_allocator_(platform_->GetPageAllocator(), options) {
+    PlatformMessageLoop::Register(this, this);
+  }
+
+  ~PageAllocatorPlatform() override {
+    PlatformMessageLoop::Unregister(this);
+  }
+
+  v8::Platform* platform() const { return platform_.get(); }
+  PooledPageAllocator* page_allocator() { return &page_allocator_; }
+
+  v8::PageAllocator* GetPageAllocator() override {
+    return &page_allocator_;
+  }
+
+  int NumberOfWorkerThreads() override {
+    return platform_->NumberOfWorkerThreads();
+  }
+
+  std::shared_ptr<v8::TaskRunner> GetForegroundTaskRunner(
+      v8::Isolate* isolate) override {
+    return platform_->GetForegroundTaskRunner(isolate);
+  }
+
+  void CallOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    platform_->CallOnWorkerThread(std::move(task));
+  }
+
+  void CallBlockingTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    platform_->CallBlockingTaskOnWorkerThread(std::move(task));
+  }
+
+  void CallLowPriorityTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    platform_->CallLowPriorityTaskOnWorkerThread(std::move(task));
+  }
+
+  void CallDelayedOnWorkerThread(std::unique_ptr<v8::Task> task,
+                                 double delay_in_seconds) override {
+    platform_->CallDelayedOnWorkerThread(std::move(task), delay_in_seconds);
+  }
+
+  std::unique_ptr<v8::JobHandle> PostJob(
+      v8::TaskPriority priority, std::unique_ptr<v8::JobTask> job_task) override {
+    return platform_->PostJob(priority, std::move(job_task));
+  }
+
+  bool IdleTasksEnabled(v8::Isolate* isolate) override {
+    return platform_->IdleTasksEnabled(isolate);
+  }
+
+  double MonotonicallyIncreasingTime() override {
+    return platform_->MonotonicallyIncreasingTime();
+  }
+
+  double CurrentClockTimeMillis() override {
+    return platform_->CurrentClockTimeMillis();
+  }
+
+  v8::TracingController* GetTracingController() override {
+    return platform_->GetTracingController();
+  }
+
+  void OnCriticalMemoryPressure() override {
+    page_allocator_.Trim();
+    platform_->OnCriticalMemoryPressure();
+  }
+
+  bool PumpMessageLoop(v8::Isolate* isolate, bool wait = false) override {
+    return PumpPlatformMessageLoop(platform_.get(), isolate, wait);
+  }
+
+  void RunIdleTasks(v8::Isolate* isolate, double idle_time_in_seconds) override {
+    RunPlatformIdleTasks(platform_.get(), isolate, idle_time_in_seconds);
+  }
+
+  void SetIdleTasksEnabled(v8::Isolate* isolate, bool enabled) override {
+    SetPlatformIdleTasksEnabled(platform_.get(), isolate, enabled);
+  }
+
+  void NotifyIsolateShutdown(v8::Isolate* isolate) override {
+    NotifyPlatformIsolateShutdown(platform_.get(), isolate);
+  }
+
+ private:
+  std::unique_ptr<v8::Platform> platform_;
+  PooledPageAllocator page_allocator_;
+};
+
+#endif  // SRC_POOLED_PAGE_ALLOCATOR_H_
@@ -0,0 +1,342 @@
+#ifndef SRC_PROMISE_TASK_H_
+#define SRC_PROMISE_TASK_H_
+
+#if !defined(__cpp_impl_coroutine)
+#error "promise-task.h uses C++20 coroutines, compile with -std=c++20"
+#endif
+
+#include <stddef.h>
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "v8.h"
+#include "task-injector.h"
+
+// Coroutine frames are allocated when a coroutine is called and freed when
+// it finishes, which for a binding returning a promise is once per call.
+// Frames up to 1KB are kept on per-thread free lists, by size rounded up to
+// 64 bytes, so steady state calls do not go to malloc. A frame is freed on
+// the thread its coroutine finished on, the isolate's thread.
+class CoroutineFrameCache {
+ public:
+  static void* Allocate(size_t size) {
+    size_t index = Index(size);
+    if (index >= kClasses) {
+      return ::operator new(size);
+    }
+    Cache& cache = ThreadCache();
+    FreeFrame* frame = cache.free[index];
+    if (frame == nullptr) {
+      return ::operator new((index + 1) * kGranule);
+    }
+    cache.free[index] = frame->next;
+    cache.count[index]--;
+    return frame;
+  }
+
+  static void Free(void* pointer, size_t size) {
+    size_t index = Index(size);
+    Cache& cache = ThreadCache();
+    if (index >= kClasses || cache.count[index] >= kMaxCached) {
+      ::operator delete(pointer);
+      return;
+    }
+    FreeFrame* frame = static_cast<FreeFrame*>(pointer);
+    frame->next = cache.free[index];
+    cache.free[index] = frame;
+    cache.count[index]++;
+  }
+
+ private:
+  static constexpr size_t kGranule = 64;
+  static constexpr size_t kClasses = 16;
+  static constexpr size_t kMaxCached = 1024;
+
+  struct FreeFrame {
+    FreeFrame* next;
+  };
+
+  struct Cache {
+    FreeFrame* free[kClasses] = {};
+    size_t count[kClasses] = {};
+
+    ~Cache() {
+      for (FreeFrame* frame : free) {
+        while (frame != nullptr) {
+          FreeFrame* next = frame->next;
+          ::operator delete(frame);
+          frame = next;
+        }
+      }
+    }
+  };
+
+  static size_t Index(size_t size) {
+    return size == 0 ? 0 : (size - 1) / kGranule;
+  }
+
+  static Cache& ThreadCache() {
+    thread_local Cache cache;
+    return cache;
+  }
+};
+
+// co_return PromiseTask::Reject(error) rejects the coroutine's promise.
+struct Rejection {
+  v8::Local<v8::Value> value;
+};
+
+// The return type of a coroutine that is exposed to JavaScript as a
+// promise. Calling the coroutine, on the isolate's thread with a context
+// entered, creates a Promise::Resolver in that context and runs the body
+// up to its first co_await; promise() is what the binding returns. The
+// coroutine resolves it with co_return value, or rejects it with
+// co_return PromiseTask::Reject(error).
+//
+//   PromiseTask ReadFile(TaskInjector* injector, std::string path) {
+//     NativeCompletion<std::string> read(injector);
+//     StartRead(path, &read);  // calls read.Complete(data) when done
+//     std::string data = co_await read;
+//     co_return String::NewFromUtf8(isolate, data.c_str()).ToLocalChecked();
+//   }
+//
+//   args.GetReturnValue().Set(ReadFile(injector, path).promise());
+//
+// The coroutine resumes on the isolate's thread, after a co_await inside
+// whatever HandleScope is current there. Locals are not valid across a
+// co_await, nor can a HandleScope be kept open across one; anything needed
+// afterwards has to be a Global or a native value. The frame is freed when
+// the body finishes. Built with -fno-exceptions, so a throw terminates.
+class PromiseTask {
+ public:
+  class promise_type {
+   public:
+    promise_type() : isolate_(v8::Isolate::GetCurrent()) {
+      v8::Local<v8::Context> context = isolate_->GetCurrentContext();
+      resolver_.Reset(isolate_,
+                      v8::Promise::Resolver::New(context).ToLocalChecked());
+      context_.Reset(isolate_, context);
+    }
+
+    static void* operator new(size_t size) {
+      return CoroutineFrameCache::Allocate(size);
+    }
+
+    static void operator delete(void* pointer, size_t size) {
+      CoroutineFrameCache::Free(pointer, size);
+    }
+
+    PromiseTask get_return_object() {
+      return PromiseTask(resolver_.Get(isolate_)->GetPromise());
+    }
+
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+
+    void return_value(v8::Local<v8::Value> value) {
+      Settle(value, false);
+    }
+
+    void return_value(Rejection rejection) {
+      Settle(rejection.value, true);
+    }
+
+    void unhandled_exception() {
+      std::terminate();
+    }
+
+   private:
+    void Settle(v8::Local<v8::Value> value, bool reject) {
+      v8::HandleScope handle_scope(isolate_);
+      v8::Local<v8::Context> context = context_.Get(isolate_);
+      v8::Context::Scope context_scope(context);
+      v8::Local<v8::Promise::Resolver> resolver = resolver_.Get(isolate_);
+      // Fails only if execution is terminating.
+      if (reject) {
+        resolver->Reject(context, value).FromMaybe(false);
+      } else {
+        resolver->Resolve(context, value).FromMaybe(false);
+      }
+    }
+
+    v8::Isolate* isolate_;
+    v8::Global<v8::Promise::Resolver> resolver_;
+    v8::Global<v8::Context> context_;
+  };
+
+  static Rejection Reject(v8::Local<v8::Value> value) {
+    return Rejection{value};
+  }
+
+  v8::Local<v8::Promise> promise() const { return promise_; }
+
+ private:
+  explicit PromiseTask(v8::Local<v8::Promise> promise) : promise_(promise) {}
+
+  v8::Local<v8::Promise> promise_;
+};
+
+// Awaits native work that another thread finishes, I/O for example. It is
+// handed to whatever does the work before it is awaited; that calls
+// Complete from any thread, once, and the coroutine resumes on the isolate's
+// thread when the injector is next drained. The completion is itself the
+// task posted to the injector and lives in the coroutine frame, so an await
+// allocates nothing. While awaited it holds a ref on the injector, which
+// keeps EventLoop::Run waiting for it.
+//
+// Complete may be called before the completion is awaited, Drain only
+// resumes the coroutine once it has suspended as long as the coroutine
+// does not drain the injector itself in between.
+template <typename T>
+class NativeCompletion : public InjectedTask {
+ public:
+  explicit NativeCompletion(TaskInjector* injector) : injector_(injector) {}
+
+  NativeCompletion(const NativeCompletion&) = delete;
+  NativeCompletion& operator=(const NativeCompletion&) = delete;
+
+  // Can be called from any thread.
+  void Complete(T value) {
+    value_ = std::move(value);
+    injector_->PostUnowned(this);
+  }
+
+  bool await_ready() const { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    injector_->Ref();
+  }
+
+  T await_resume() { return std::move(value_); }
+
+  void Run(v8::Isolate* isolate) override {
+    injector_->UnrefFromTask();
+    // The coroutine may finish, destroying this.
+    handle_.resume();
+  }
+
+ private:
+  TaskInjector* injector_;
+  std::coroutine_handle<> handle_;
+  T value_{};
+};
+
+// Runs fn() on one of the platform's worker threads and resumes with its
+// result on the isolate's thread:
+//
+//   int sum = co_await OnWorkerThread(platform, injector, [] { ... });
+//
+// The platform takes ownership of a v8::Task, one allocation per await.
+template <typename Fn>
+class WorkerAwaiter : public NativeCompletion<decltype(std::declval<Fn&>()())> {
+ public:
+  WorkerAwaiter(v8::Platform* platform, TaskInjector* injector, Fn fn)
+      : NativeCompletion<decltype(std::declval<Fn&>()())>(injector),
+        platform_(platform),
+        fn_(std::move(fn)) {}
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    NativeCompletion<decltype(std::declval<Fn&>()())>::await_suspend(handle);
+    platform_->CallOnWorkerThread(std::make_unique<WorkerTask>(this));
+  }
+
+ private:
+  class WorkerTask : public v8::Task {
+   public:
+    explicit WorkerTask(WorkerAwaiter* awaiter) : awaiter_(awaiter) {}
+    void Run() override { awaiter_->Complete(awaiter_->fn_()); }
+
+   private:
+    WorkerAwaiter* awaiter_;
+  };
+
+  v8::Platform* platform_;
+  Fn fn_;
+};
+
+template <typename Fn>
+WorkerAwaiter<Fn> OnWorkerThread(v8::Platform* platform, TaskInjector* injector,
+                                 Fn fn) {
+  return WorkerAwaiter<Fn>(platform, injector, std::move(fn));
+}
+
+// What co_await on a JavaScript promise gives. value is valid until the
+// next co_await; it is empty if execution was terminated.
+struct Settled {
+  bool fulfilled;
+  v8::Local<v8::Value> value;
+};
+
+// Awaits a JavaScript promise: co_await AwaitPromise(isolate, promise).
+// A promise that has already settled does not suspend. Otherwise reactions
+// are attached with Promise::Then and the coroutine resumes from them, in
+// a microtask checkpoint on the isolate's thread.
+class AwaitPromise {
+ public:
+  AwaitPromise(v8::Isolate* isolate, v8::Local<v8::Promise> promise)
+      : isolate_(isolate), promise_(promise) {}
+
+  bool await_ready() const {
+    return promise_->State() != v8::Promise::kPending;
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    v8::Local<v8::Context> context = isolate_->GetCurrentContext();
+    v8::Local<v8::External> data = v8::External::New(isolate_, this);
+    v8::Local<v8::Function> on_fulfilled;
+    v8::Local<v8::Function> on_rejected;
+    if (!v8::Function::New(context, OnFulfilled, data, 1)
+             .ToLocal(&on_fulfilled) ||
+        !v8::Function::New(context, OnRejected, data, 1)
+             .ToLocal(&on_rejected) ||
+        promise_->Then(context, on_fulfilled, on_rejected).IsEmpty()) {
+      // Terminating, resume right away with an empty value.
+      settled_ = Settled{false, v8::Local<v8::Value>()};
+      has_settled_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  Settled await_resume() {
+    if (has_settled_) {
+      return settled_;
+    }
+    // Did not suspend, promise_ is still valid.
+    return Settled{promise_->State() == v8::Promise::kFulfilled,
+                   promise_->Result()};
+  }
+
+ private:
+  static void OnFulfilled(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    Resume(info, true);
+  }
+
+  static void OnRejected(const v8::FunctionCallbackInfo<v8::Value>& info) {
+    Resume(info, false);
+  }
+
+  static void Resume(const v8::FunctionCallbackInfo<v8::Value>& info,
+                     bool fulfilled) {
+    AwaitPromise* awaiter =
+        static_cast<AwaitPromise*>(info.Data().As<v8::External>()->Value());
+    // promise_ is stale by now, await_resume only reads settled_.
+    awaiter->has_settled_ = true;
+    awaiter->settled_ = Settled{fulfilled, info[0]};
+    awaiter->handle_.resume();
+  }
+
+  v8::Isolate* isolate_;
+  v8::Local<v8::Promise> promise_;
+  std::coroutine_handle<> handle_;
+  Settled settled_{false, v8::Local<v8::Value>()};
+  bool has_settled_ = false;
+};
+
+#endif  // SRC_PROMISE_TASK_H_
@@ -0,0 +1,100 @@
+#ifndef SRC_SHARED_BACKING_STORE_H_
+#define SRC_SHARED_BACKING_STORE_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "v8.h"
+
+// Hands one BackingStore to any number of isolates, so that a large
+// read-only dataset is resident once however many workers use it.
+//
+// Every isolate gets its own ArrayBuffer from ArrayBuffer::New(isolate,
+// store) over the same std::shared_ptr<v8::BackingStore>. The registry only
+// keeps a weak_ptr, so the store, and with it the data through its
+// deleter, is freed exactly once when the last ArrayBuffer referring to it
+// is collected or detached, or its isolate disposed, whichever thread that
+// happens on. Asking for the name again after that loads it anew.
+//
+// Stores are created with ArrayBuffer::NewBackingStore and the unique_ptr
+// it returns is moved straight into a shared_ptr, which keeps V8's deleter.
+// A BackingStore is never deleted, or cast, as any other type here: that is
+// what the PublicStore/InternalStore casts in notes/backingstore_issue.md
+// get wrong and what ASAN reports as a new-delete-type-mismatch.
+//
+// V8 does not stop one isolate from writing to the data while others read
+// it; the data is meant to be read-only, nothing synchronizes writes.
+class SharedBackingStores {
+ public:
+  SharedBackingStores() = default;
+  SharedBackingStores(const SharedBackingStores&) = delete;
+  SharedBackingStores& operator=(const SharedBackingStores&) = delete;
+
+  // Wraps memory in a BackingStore that calls deleter(data, length,
+  // deleter_data) once when the last reference to it is gone.
+  static std::shared_ptr<v8::BackingStore> Wrap(
+      void* data, size_t length, v8::BackingStore::DeleterCallback deleter,
+      void* deleter_data) {
+    std::unique_ptr<v8::BackingStore> store = v8::ArrayBuffer::NewBackingStore(
+        data, length, deleter, deleter_data);
+    return std::shared_ptr<v8::BackingStore>(std::move(store));
+  }
+
+  // Returns the store registered as name, calling create() for a new one
+  // if there is none that is still referenced. create returns a
+  // std::shared_ptr<v8::BackingStore>, from Wrap for example, and runs with
+  // the registry's lock held, so concurrent requests for the same name
+  // load it once. Can be called from any thread.
+  template <typename Create>
+  std::shared_ptr<v8::BackingStore> Get(const std::string& name,
+                                        Create create) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::weak_ptr<v8::BackingStore>& entry = stores_[name];
+    std::shared_ptr<v8::BackingStore> store = entry.lock();
+    if (!store) {
+      store = create();
+      entry = store;
+      loads_++;
+    }
+    return store;
+  }
+
+  // A new ArrayBuffer in isolate over the store registered as name.
+  template <typename Create>
+  v8::Local<v8::ArrayBuffer> NewArrayBuffer(v8::Isolate* isolate,
+                                            const std::string& name,
+                                            Create create) {
+    return v8::ArrayBuffer::New(isolate, Get(name, create));
+  }
+
+  // Names whose store is still referenced, dropping the others.
+  size_t live() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = stores_.begin(); it != stores_.end();) {
+      if (it->second.expired()) {
+        it = stores_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    return stores_.size();
+  }
+
+  // How many times create was called.
+  size_t loads() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return loads_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::weak_ptr<v8::BackingStore>> stores_;
+  size_t loads_ = 0;
+};
+
+#endif  // SRC_SHARED_BACKING_STORE_H_
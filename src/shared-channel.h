@@ -0,0 +1,459 @@
+#ifndef SRC_SHARED_CHANNEL_H_
+#define SRC_SHARED_CHANNEL_H_
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "v8.h"
+
+// A single-producer/single-consumer channel of byte messages between
+// isolates in the same process, in a SharedArrayBuffer that every isolate
+// involved maps with NewSharedArrayBuffer. Nothing is serialized and there
+// are no locks: a message is copied into the ring buffer by the producer
+// and out of it by the consumer.
+//
+// Either end can be JavaScript or C++. Install adds a SharedChannel class
+// to a context which takes the SharedArrayBuffer:
+//
+//   var channel = new SharedChannel(sab);
+//   channel.send(new Uint8Array([1, 2, 3]));  // blocks while full
+//   var message = channel.receive();  // a Uint8Array, blocks while empty
+//   channel.trySend(bytes), channel.tryReceive(), channel.close()
+//
+// receive returns undefined and send false once the channel is closed (and,
+// for receive, drained). send only takes messages whose record, the
+// message plus 4 to 7 bytes of length and padding, is at most half the
+// capacity, and throws a RangeError for larger ones: a record that would
+// wrap around has to fit between the start of the data area and the
+// consumer, so a larger one could wait forever on an empty channel.
+// trySend takes records of up to the whole capacity, if they fit right
+// then. Blocking uses Atomics.wait/notify, so isolates
+// that receive need to be allowed to wait (Isolate::SetAllowAtomicsWait,
+// which is the default). C++ ends use TrySend/Send/TryReceive/Receive.
+//
+// Layout: a 128 byte header with the head (bytes written) and tail (bytes
+// read) counters on their own cache lines, then the data area, whose size
+// is a power of two. A message is a 4 byte little-endian length (the C++
+// side assumes a little-endian host) followed by the bytes, padded to 4
+// bytes. A message that does not fit before the end of the data area is
+// written at its start, after a -1 length that tells the consumer to skip
+// ahead.
+//
+// A waiting side sets its waiting word before it waits, and the other side
+// only notifies when that word is set, so sends and receives that do not
+// need to wake anybody do not go through V8's futex emulation. V8 does not
+// let C++ wake up an Atomics.wait, and a JavaScript Atomics.notify does not
+// wake a futex, so as soon as a SharedChannel object exists for the memory
+// the JavaScript ends wait for at most kNativePeerWaitMs at a time, and C++
+// ends always wait like that. A channel between JavaScript ends only can be
+// made with NewBackingStore, without a C++ end, and then waits without a
+// timeout.
+class SharedChannel {
+ public:
+  static const size_t kHeaderSize = 128;
+  // Indices of the header words in an Int32Array over the buffer.
+  static const int kHead = 0;
+  static const int kTail = 16;
+  static const int kFlags = 24;
+  static const int kReceiverWaiting = 25;
+  static const int kSenderWaiting = 26;
+  // Bits in the flags word.
+  static const int32_t kClosed = 1;
+  static const int32_t kNativePeer = 2;
+  static const int kNativePeerWaitMs = 1;
+
+  // capacity is the size of the data area and is rounded up to a power of
+  // two.
+  explicit SharedChannel(size_t capacity = 1 << 20)
+      : SharedChannel(NewBackingStore(capacity)) {}
+
+  // Another handle on a channel, for example one that was created in
+  // JavaScript with new SharedArrayBuffer. Returns nullptr if the buffer is
+  // not a header followed by a data area whose size is a power of two.
+  static std::unique_ptr<SharedChannel> FromBackingStore(
+      std::shared_ptr<v8::BackingStore> backing_store) {
+    size_t length = backing_store->ByteLength();
+    if (length <= kHeaderSize || length - kHeaderSize > UINT32_MAX / 2 + 1 ||
+        !IsPowerOfTwo(length - kHeaderSize)) {
+      return nullptr;
+    }
+    return std::unique_ptr<SharedChannel>(
+        new SharedChannel(std::move(backing_store)));
+  }
+
+  // Zeroed memory for a channel with a data area of capacity bytes, rounded
+  // up to a power of two, that has no C++ end yet.
+  static std::shared_ptr<v8::BackingStore> NewBackingStore(size_t capacity) {
+    size_t size = 64;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    void* data = aligned_alloc(64, kHeaderSize + size);
+    memset(data, 0, kHeaderSize + size);
+    return v8::SharedArrayBuffer::NewBackingStore(
+        data, kHeaderSize + size,
+        [](void* data, size_t length, void* deleter_data) { free(data); },
+        nullptr);
+  }
+
+  // A SharedArrayBuffer for isolate over the channel's memory. Every isolate
+  // gets its own, they all share the backing store.
+  v8::Local<v8::SharedArrayBuffer> NewSharedArrayBuffer(
+      v8::Isolate* isolate) const {
+    return v8::SharedArrayBuffer::New(isolate, backing_store_);
+  }
+
+  // Defines the SharedChannel class in context's global object.
+  static void Install(v8::Local<v8::Context> context) {
+    v8::Isolate* isolate = context->GetIsolate();
+    v8::HandleScope handle_scope(isolate);
+    v8::Local<v8::String> source =
+        v8::String::NewFromUtf8(isolate, Source()).ToLocalChecked();
+    v8::Local<v8::Value> constructor = v8::Script::Compile(context, source)
+        .ToLocalChecked()->Run(context).ToLocalChecked();
+    context->Global()->Set(context,
+        v8::String::NewFromUtf8Literal(isolate, "SharedChannel"),
+        constructor).Check();
+  }
+
+  // new SharedChannel(sab) in context, which must have been installed.
+  v8::MaybeLocal<v8::Object> NewEndpoint(v8::Local<v8::Context> context) const {
+    return NewEndpoint(context, backing_store_);
+  }
+
+  static v8::MaybeLocal<v8::Object> NewEndpoint(
+      v8::Local<v8::Context> context,
+      const std::shared_ptr<v8::BackingStore>& backing_store) {
+    v8::Isolate* isolate = context->GetIsolate();
+    v8::EscapableHandleScope handle_scope(isolate);
+    v8::Local<v8::Value> constructor;
+    if (!context->Global()->Get(context,
+            v8::String::NewFromUtf8Literal(isolate, "SharedChannel"))
+            .ToLocal(&constructor) || !constructor->IsFunction()) {
+      return v8::MaybeLocal<v8::Object>();
+    }
+    v8::Local<v8::Value> argv[] = {
+        v8::SharedArrayBuffer::New(isolate, backing_store)};
+    v8::Local<v8::Object> endpoint;
+    if (!constructor.As<v8::Function>()->NewInstance(context, 1, argv)
+            .ToLocal(&endpoint)) {
+      return v8::MaybeLocal<v8::Object>();
+    }
+    return handle_scope.Escape(endpoint);
+  }
+
+  // Returns false if the message does not fit right now, or the channel is
+  // closed. A message larger than the capacity never fits.
+  bool TrySend(const void* data, size_t length) {
+    if (closed() || length > INT32_MAX) {
+      return false;
+    }
+    uint32_t size = RecordSize(length);
+    uint32_t head = Load(kHead);
+    uint32_t offset = head & mask_;
+    uint32_t skip = Skip(head, size);
+    if (!Fits(head, size)) {
+      return false;
+    }
+    if (skip != 0) {
+      int32_t padding = -1;
+      memcpy(data_ + offset, &padding, 4);
+      offset = 0;
+    }
+    uint32_t length32 = static_cast<uint32_t>(length);
+    memcpy(data_ + offset, &length32, 4);
+    memcpy(data_ + offset + 4, data, length);
+    Store(kHead, head + skip + size);
+    if (Load(kReceiverWaiting) != 0) {
+      Wake(kHead);
+    }
+    return true;
+  }
+
+  // Blocks while the channel is full. Returns false if the channel is
+  // closed or the record is larger than half the capacity, see max_send().
+  bool Send(const void* data, size_t length) {
+    if (length > max_send()) {
+      return false;
+    }
+    while (!TrySend(data, length)) {
+      if (closed()) {
+        return false;
+      }
+      WaitWhile(kSenderWaiting, kTail, [this, length] {
+        return !closed() && !Fits(Load(kHead), RecordSize(length));
+      });
+    }
+    return true;
+  }
+
+  bool TryReceive(std::string* message) {
+    uint32_t tail = Load(kTail);
+    uint32_t head = Load(kHead);
+    if (head == tail) {
+      return false;
+    }
+    uint32_t offset = tail & mask_;
+    uint32_t skip = 0;
+    int32_t length;
+    memcpy(&length, data_ + offset, 4);
+    if (length == -1) {
+      skip = capacity_ - offset;
+      offset = 0;
+      memcpy(&length, data_, 4);
+    }
+    message->assign(reinterpret_cast<const char*>(data_ + offset + 4), length);
+    Store(kTail, tail + skip + RecordSize(length));
+    if (Load(kSenderWaiting) != 0) {
+      Wake(kTail);
+    }
+    return true;
+  }
+
+  // Blocks while the channel is empty. Returns false once it is closed and
+  // empty.
+  bool Receive(std::string* message) {
+    while (!TryReceive(message)) {
+      if (closed()) {
+        return TryReceive(message);
+      }
+      WaitWhile(kReceiverWaiting, kHead, [this] {
+        return !closed() && Load(kHead) == Load(kTail);
+      });
+    }
+    return true;
+  }
+
+  // Wakes up both ends. Messages that were sent can still be received.
+  void Close() {
+    MarkNative();
+    __atomic_fetch_or(Word(kFlags), kClosed, __ATOMIC_SEQ_CST);
+    Wake(kHead);
+    Wake(kTail);
+  }
+
+  bool closed() const { return (Load(kFlags) & kClosed) != 0; }
+  size_t capacity() const { return capacity_; }
+  // The longest message Send takes. Any record up to half the capacity fits
+  // in an empty channel, wherever the head is: either before the end of the
+  // data area, or at its start, with the skipped bytes past the middle.
+  size_t max_send() const { return capacity_ / 2 - 4; }
+  // Bytes in the ring buffer, including headers and padding.
+  size_t size() const { return Load(kHead) - Load(kTail); }
+
+  const std::shared_ptr<v8::BackingStore>& backing_store() const {
+    return backing_store_;
+  }
+
+ private:
+  explicit SharedChannel(std::shared_ptr<v8::BackingStore> backing_store)
+      : backing_store_(std::move(backing_store)) {
+    base_ = static_cast<uint8_t*>(backing_store_->Data());
+    data_ = base_ + kHeaderSize;
+    capacity_ = static_cast<uint32_t>(backing_store_->ByteLength() - kHeaderSize);
+    mask_ = capacity_ - 1;
+    // From now on JavaScript ends may have to be woken up from C++, which
+    // they only notice by polling.
+    MarkNative();
+  }
+
+  static bool IsPowerOfTwo(size_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+  }
+
+  static uint32_t RecordSize(size_t length) {
+    return static_cast<uint32_t>((4 + length + 3) & ~static_cast<size_t>(3));
+  }
+
+  // Bytes to skip at the end of the data area before a record of size can
+  // be written at head.
+  uint32_t Skip(uint32_t head, uint32_t size) const {
+    uint32_t offset = head & mask_;
+    return offset + size > capacity_ ? capacity_ - offset : 0;
+  }
+
+  bool Fits(uint32_t head, uint32_t size) const {
+    return head - Load(kTail) + Skip(head, size) + size <= capacity_;
+  }
+
+  int32_t* Word(int index) const {
+    return reinterpret_cast<int32_t*>(base_) + index;
+  }
+
+  // Sequentially consistent like the Atomics operations on the other side,
+  // which the waiting words rely on.
+  uint32_t Load(int index) const {
+    return static_cast<uint32_t>(__atomic_load_n(Word(index), __ATOMIC_SEQ_CST));
+  }
+
+  void Store(int index, uint32_t value) {
+    __atomic_store_n(Word(index), static_cast<int32_t>(value), __ATOMIC_SEQ_CST);
+  }
+
+  void MarkNative() {
+    __atomic_fetch_or(Word(kFlags), kNativePeer, __ATOMIC_SEQ_CST);
+  }
+
+  // Sets the waiting word and waits on the word at index for as long as
+  // blocked returns true, kNativePeerWaitMs at a time since a JavaScript
+  // peer can not wake us up.
+  template <typename Blocked>
+  void WaitWhile(int waiting, int index, Blocked blocked) {
+    Store(waiting, 1);
+    while (blocked()) {
+      int32_t value = static_cast<int32_t>(Load(index));
+      if (!blocked()) {
+        break;
+      }
+      timespec timeout = {0, kNativePeerWaitMs * 1000000L};
+      syscall(SYS_futex, Word(index), FUTEX_WAIT_PRIVATE, value, &timeout,
+              nullptr, 0);
+    }
+    Store(waiting, 0);
+  }
+
+  // Wakes up C++ ends waiting on the word at index. JavaScript ends poll.
+  void Wake(int index) {
+    syscall(SYS_futex, Word(index), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr,
+            nullptr, 0);
+  }
+
+  // The JavaScript side, which has to match the layout above.
+  static const char* Source() {
+    return R"JS(
+(function() {
+  const HEAD = 0, TAIL = 16, FLAGS = 24, RECEIVER_WAITING = 25,
+        SENDER_WAITING = 26;
+  const CLOSED = 1, NATIVE_PEER = 2, NATIVE_PEER_WAIT_MS = 1;
+  const HEADER_SIZE = 128;
+
+  class SharedChannel {
+    constructor(sab) {
+      const capacity = sab.byteLength - HEADER_SIZE;
+      if (capacity <= 0 || (capacity & (capacity - 1)) !== 0) {
+        throw new RangeError(
+            'SharedChannel needs a ' + HEADER_SIZE + ' byte header and a ' +
+            'power of two data area');
+      }
+      this.words = new Int32Array(sab, 0, HEADER_SIZE / 4);
+      this.bytes = new Uint8Array(sab, HEADER_SIZE);
+      this.view = new DataView(sab, HEADER_SIZE);
+      this.capacity = this.bytes.length;
+      this.mask = this.capacity - 1;
+    }
+
+    get closed() {
+      return (Atomics.load(this.words, FLAGS) & CLOSED) !== 0;
+    }
+
+    trySend(message) {
+      const words = this.words;
+      if (this.closed) return false;
+      const length = message.length;
+      const size = (4 + length + 3) & ~3;
+      const head = Atomics.load(words, HEAD);
+      const tail = Atomics.load(words, TAIL);
+      let offset = head & this.mask;
+      const skip = offset + size > this.capacity ? this.capacity - offset : 0;
+      if (((head - tail) >>> 0) + skip + size > this.capacity) return false;
+      if (skip !== 0) {
+        this.view.setInt32(offset, -1, true);
+        offset = 0;
+      }
+      this.view.setUint32(offset, length, true);
+      this.bytes.set(message, offset + 4);
+      Atomics.store(words, HEAD, (head + skip + size) | 0);
+      if (Atomics.load(words, RECEIVER_WAITING) !== 0) {
+        Atomics.notify(words, HEAD);
+      }
+      return true;
+    }
+
+    send(message) {
+      const words = this.words;
+      const size = (4 + message.length + 3) & ~3;
+      if (size > this.capacity / 2) {
+        throw new RangeError('message is larger than half the channel');
+      }
+      while (!this.trySend(message)) {
+        if (this.closed) return false;
+        Atomics.store(words, SENDER_WAITING, 1);
+        const tail = Atomics.load(words, TAIL);
+        if (!this.closed &&
+            ((Atomics.load(words, HEAD) - tail) >>> 0) + size > this.capacity) {
+          Atomics.wait(words, TAIL, tail, this.waitTimeout());
+        }
+        Atomics.store(words, SENDER_WAITING, 0);
+      }
+      return true;
+    }
+
+    tryReceive() {
+      const words = this.words;
+      const tail = Atomics.load(words, TAIL);
+      const head = Atomics.load(words, HEAD);
+      if (head === tail) return undefined;
+      let offset = tail & this.mask;
+      let skip = 0;
+      let length = this.view.getInt32(offset, true);
+      if (length === -1) {
+        skip = this.capacity - offset;
+        offset = 0;
+        length = this.view.getInt32(0, true);
+      }
+      const message = this.bytes.slice(offset + 4, offset + 4 + length);
+      Atomics.store(words, TAIL, (tail + skip + ((4 + length + 3) & ~3)) | 0);
+      if (Atomics.load(words, SENDER_WAITING) !== 0) {
+        Atomics.notify(words, TAIL);
+      }
+      return message;
+    }
+
+    receive() {
+      const words = this.words;
+      for (;;) {
+        const message = this.tryReceive();
+        if (message !== undefined) return message;
+        if (this.closed) return this.tryReceive();
+        Atomics.store(words, RECEIVER_WAITING, 1);
+        const head = Atomics.load(words, HEAD);
+        if (!this.closed && head === Atomics.load(words, TAIL)) {
+          Atomics.wait(words, HEAD, head, this.waitTimeout());
+        }
+        Atomics.store(words, RECEIVER_WAITING, 0);
+      }
+    }
+
+    close() {
+      Atomics.or(this.words, FLAGS, CLOSED);
+      Atomics.notify(this.words, HEAD);
+      Atomics.notify(this.words, TAIL);
+    }
+
+    waitTimeout() {
+      return (Atomics.load(this.words, FLAGS) & NATIVE_PEER) !== 0
+          ? NATIVE_PEER_WAIT_MS : Infinity;
+    }
+  }
+  return SharedChannel;
+})()
+)JS";
+  }
+
+  std::shared_ptr<v8::BackingStore> backing_store_;
+  uint8_t* base_;
+  uint8_t* data_;
+  uint32_t capacity_;
+  uint32_t mask_;
+};
+
+#endif  // SRC_SHARED_CHANNEL_H_
@@ -0,0 +1,146 @@
+#ifndef SRC_SHARED_STRING_TABLE_H_
+#define SRC_SHARED_STRING_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "v8.h"
+#include "mapped-source.h"
+
+// A process-wide table of constant strings, templates or configuration for
+// example, that any isolate can use as an external string pointing at the
+// table's copy, instead of String::NewFromUtf8 copying them into every heap.
+//
+// The text is decoded from UTF-8 once, to one byte per character if it is
+// all Latin-1 and two otherwise, and kept in an immutable SharedString.
+// V8 disposes every external string's resource on its own, so each string
+// gets a resource of its own that holds a std::shared_ptr to the
+// SharedString; the table only keeps a weak_ptr. The memory is freed once,
+// when the last string using it, in whichever isolate, is collected or its
+// isolate disposed. Asking for the name again after that loads it anew.
+//
+// Like other external strings they cannot be changed, and V8 never copies
+// them into its heap, however short they are.
+class SharedStringTable {
+ public:
+  struct SharedString {
+    std::unique_ptr<char[]> one_byte;
+    std::unique_ptr<uint16_t[]> two_byte;
+    size_t length;
+  };
+
+  SharedStringTable() = default;
+  SharedStringTable(const SharedStringTable&) = delete;
+  SharedStringTable& operator=(const SharedStringTable&) = delete;
+
+  // Returns the string registered as name, as an external string in
+  // isolate, calling load() for its UTF-8 text if no isolate uses it. load
+  // returns a std::string and runs with the table's lock held. Returns
+  // nothing if the text is not valid UTF-8 or too long for a string. Can
+  // be called from any thread.
+  template <typename Load>
+  v8::MaybeLocal<v8::String> NewString(v8::Isolate* isolate,
+                                       const std::string& name, Load load) {
+    std::shared_ptr<const SharedString> shared = Get(name, load);
+    if (!shared) {
+      return v8::MaybeLocal<v8::String>();
+    }
+    if (shared->one_byte) {
+      return v8::String::NewExternalOneByte(isolate,
+          new OneByteResource(std::move(shared)));
+    }
+    return v8::String::NewExternalTwoByte(isolate,
+        new TwoByteResource(std::move(shared)));
+  }
+
+  template <typename Load>
+  std::shared_ptr<const SharedString> Get(const std::string& name, Load load) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::weak_ptr<const SharedString>& entry = strings_[name];
+    std::shared_ptr<const SharedString> shared = entry.lock();
+    if (!shared) {
+      std::string text = load();
+      shared = Decode(text.data(), text.size());
+      if (!shared) {
+        strings_.erase(name);
+        return shared;
+      }
+      entry = shared;
+      loads_++;
+    }
+    return shared;
+  }
+
+  // Names whose string is still used, dropping the others.
+  size_t live() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = strings_.begin(); it != strings_.end();) {
+      if (it->second.expired()) {
+        it = strings_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    return strings_.size();
+  }
+
+  // How many times load was called.
+  size_t loads() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return loads_;
+  }
+
+ private:
+  class OneByteResource : public v8::String::ExternalOneByteStringResource {
+   public:
+    explicit OneByteResource(std::shared_ptr<const SharedString> shared)
+        : shared_(std::move(shared)) {}
+    const char* data() const override { return shared_->one_byte.get(); }
+    size_t length() const override { return shared_->length; }
+
+   private:
+    std::shared_ptr<const SharedString> shared_;
+  };
+
+  class TwoByteResource : public v8::String::ExternalStringResource {
+   public:
+    explicit TwoByteResource(std::shared_ptr<const SharedString> shared)
+        : shared_(std::move(shared)) {}
+    const uint16_t* data() const override { return shared_->two_byte.get(); }
+    size_t length() const override { return shared_->length; }
+
+   private:
+    std::shared_ptr<const SharedString> shared_;
+  };
+
+  static std::shared_ptr<const SharedString> Decode(const char* data,
+                                                    size_t size) {
+    size_t units;
+    bool latin1;
+    if (!mapped_source::MeasureUtf8(data, size, &units, &latin1) ||
+        units > static_cast<size_t>(v8::String::kMaxLength)) {
+      return nullptr;
+    }
+    std::shared_ptr<SharedString> shared = std::make_shared<SharedString>();
+    shared->length = units;
+    if (latin1) {
+      shared->one_byte.reset(new char[units]);
+      mapped_source::ConvertUtf8(data, size, shared->one_byte.get());
+    } else {
+      shared->two_byte.reset(new uint16_t[units]);
+      mapped_source::ConvertUtf8(data, size, shared->two_byte.get());
+    }
+    return shared;
+  }
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::weak_ptr<const SharedString>> strings_;
+  size_t loads_ = 0;
+};
+
+#endif  // SRC_SHARED_STRING_TABLE_H_
@@ -0,0 +1,77 @@
+#ifndef SRC_SLAB_ALLOCATOR_H_
+#define SRC_SLAB_ALLOCATOR_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fixed size allocator that carves objects of one size out of larger slabs
+// and keeps freed objects on a free list for reuse. Slabs are only returned
+// to the system when the allocator is destroyed, so memory use stays at the
+// high water mark of live objects but does not fragment or grow with churn.
+//
+// Allocate and Free can be called from any thread.
+template <size_t ObjectSize, size_t ObjectsPerSlab = 1024>
+class SlabAllocator {
+ public:
+  SlabAllocator() = default;
+  SlabAllocator(const SlabAllocator&) = delete;
+  SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+  void* Allocate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_list_ == nullptr) {
+      AddSlab();
+    }
+    FreeNode* node = free_list_;
+    free_list_ = node->next;
+    live_++;
+    return node;
+  }
+
+  void Free(void* ptr) {
+    if (ptr == nullptr) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeNode* node = static_cast<FreeNode*>(ptr);
+    node->next = free_list_;
+    free_list_ = node;
+    live_--;
+  }
+
+  size_t live() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_;
+  }
+
+  size_t reserved_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slabs_.size() * kSlotSize * ObjectsPerSlab;
+  }
+
+ private:
+  union FreeNode {
+    FreeNode* next;
+    alignas(max_align_t) char storage[ObjectSize];
+  };
+  static const size_t kSlotSize = sizeof(FreeNode);
+
+  void AddSlab() {
+    std::unique_ptr<FreeNode[]> slab(new FreeNode[ObjectsPerSlab]);
+    for (size_t i = 0; i < ObjectsPerSlab; i++) {
+      slab[i].next = free_list_;
+      free_list_ = &slab[i];
+    }
+    slabs_.push_back(std::move(slab));
+  }
+
+  mutable std::mutex mutex_;
+  FreeNode* free_list_ = nullptr;
+  std::vector<std::unique_ptr<FreeNode[]>> slabs_;
+  size_t live_ = 0;
+};
+
+#endif  // SRC_SLAB_ALLOCATOR_H_
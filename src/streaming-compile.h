@@ -0,0 +1,231 @@
+#ifndef SRC_STREAMING_COMPILE_H_
+#define SRC_STREAMING_COMPILE_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "v8-platform.h"
+#include "v8.h"
+#include "mapped-source.h"
+
+// Compiles a script file off the main thread using V8's script streaming.
+//
+// Start opens the file and starts two things:
+//  - a reader thread that reads the file in chunks into a bounded queue,
+//  - a ScriptStreamingTask, posted to a platform worker thread, which pulls
+//    chunks from the queue through an ExternalSourceStream and parses them
+//    as they arrive,
+// while the main thread is free to do other work. Finish waits for the
+// streaming task and calls ScriptCompiler::Compile with the StreamedSource,
+// which only has to finalize what the worker produced.
+//
+//   StreamingCompile compile(isolate, platform, "script.js");
+//   compile.Start();
+//   ... other work ...
+//   Local<Script> script = compile.Finish(context, name).ToLocalChecked();
+class StreamingCompile {
+ public:
+  StreamingCompile(v8::Isolate* isolate, v8::Platform* platform,
+                   const std::string& path, size_t chunk_size = 64 * 1024,
+                   size_t max_queued_chunks = 16)
+      : isolate_(isolate), platform_(platform), path_(path),
+        chunk_size_(chunk_size), queue_(max_queued_chunks) {}
+
+  ~StreamingCompile() {
+    // Make sure that neither thread is still using this instance.
+    queue_.Close();
+    if (reader_.joinable()) {
+      reader_.join();
+    }
+    WaitForTask();
+  }
+
+  bool Start() {
+    start_ = std::chrono::steady_clock::now();
+    int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      return false;
+    }
+    reader_ = std::thread(&StreamingCompile::ReaderMain, this, fd);
+    source_.reset(new v8::ScriptCompiler::StreamedSource(
+        std::unique_ptr<v8::ScriptCompiler::ExternalSourceStream>(
+            new QueueSourceStream(&queue_)),
+        v8::ScriptCompiler::StreamedSource::UTF8));
+    task_.reset(v8::ScriptCompiler::StartStreaming(isolate_, source_.get()));
+    {
+      std::lock_guard<std::mutex> lock(task_mutex_);
+      task_running_ = true;
+    }
+    platform_->CallOnWorkerThread(std::unique_ptr<v8::Task>(new StreamingTask(this)));
+    return true;
+  }
+
+  // Blocks until the streaming task has finished and returns the compiled
+  // script. Must be called on the isolate's thread.
+  v8::MaybeLocal<v8::Script> Finish(v8::Local<v8::Context> context,
+                                    v8::Local<v8::String> name) {
+    auto finish_start = std::chrono::steady_clock::now();
+    WaitForTask();
+    if (reader_.joinable()) {
+      reader_.join();
+    }
+    v8::MaybeLocal<v8::Script> result;
+    // V8 needs the complete source as a string too, for lazy functions and
+    // for Function.prototype.toString. Mapping it avoids another copy.
+    v8::Local<v8::String> full_source;
+    if (!read_failed_ && ReadFileMapped(isolate_, path_.c_str()).ToLocal(&full_source)) {
+      v8::ScriptOrigin origin(name);
+      result = v8::ScriptCompiler::Compile(context, source_.get(), full_source,
+                                           origin);
+    }
+    auto end = std::chrono::steady_clock::now();
+    blocked_ = end - finish_start;
+    total_ = end - start_;
+    return result;
+  }
+
+  // Time the caller of Finish was blocked, waiting for the worker and
+  // finalizing the compilation.
+  double blocked_ms() const { return blocked_.count(); }
+  // Time from Start until Finish returned.
+  double total_ms() const { return total_.count(); }
+
+ private:
+  struct Chunk {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size;
+  };
+
+  // Bounded single producer, single consumer queue of chunks. Close wakes
+  // both sides and makes Pop return false once the queue is drained.
+  class ChunkQueue {
+   public:
+    explicit ChunkQueue(size_t capacity) : capacity_(capacity) {}
+
+    bool Push(Chunk chunk) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_full_.wait(lock, [this] { return closed_ || chunks_.size() < capacity_; });
+      if (closed_) {
+        return false;
+      }
+      chunks_.push_back(std::move(chunk));
+      not_empty_.notify_one();
+      return true;
+    }
+
+    bool Pop(Chunk* chunk) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this] { return closed_ || !chunks_.empty(); });
+      if (chunks_.empty()) {
+        return false;
+      }
+      *chunk = std::move(chunks_.front());
+      chunks_.pop_front();
+      not_full_.notify_one();
+      return true;
+    }
+
+    void Close() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+      not_empty_.notify_all();
+      not_full_.notify_all();
+    }
+
+   private:
+    const size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<Chunk> chunks_;
+    bool closed_ = false;
+  };
+
+  class QueueSourceStream : public v8::ScriptCompiler::ExternalSourceStream {
+   public:
+    explicit QueueSourceStream(ChunkQueue* queue) : queue_(queue) {}
+
+    // Called on the worker thread. V8 takes ownership of the returned
+    // buffer and returning 0 signals the end of the source.
+    size_t GetMoreData(const uint8_t** src) override {
+      Chunk chunk;
+      if (!queue_->Pop(&chunk)) {
+        return 0;
+      }
+      *src = chunk.data.release();
+      return chunk.size;
+    }
+
+   private:
+    ChunkQueue* queue_;
+  };
+
+  class StreamingTask : public v8::Task {
+   public:
+    explicit StreamingTask(StreamingCompile* compile) : compile_(compile) {}
+    void Run() override {
+      compile_->task_->Run();
+      std::lock_guard<std::mutex> lock(compile_->task_mutex_);
+      compile_->task_running_ = false;
+      compile_->task_cv_.notify_all();
+    }
+
+   private:
+    StreamingCompile* compile_;
+  };
+
+  void ReaderMain(int fd) {
+    for (;;) {
+      Chunk chunk{std::unique_ptr<uint8_t[]>(new uint8_t[chunk_size_]), 0};
+      ssize_t n = read(fd, chunk.data.get(), chunk_size_);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        read_failed_ = n < 0;
+        break;
+      }
+      chunk.size = static_cast<size_t>(n);
+      if (!queue_.Push(std::move(chunk))) {
+        break;
+      }
+    }
+    close(fd);
+    queue_.Close();
+  }
+
+  void WaitForTask() {
+    std::unique_lock<std::mutex> lock(task_mutex_);
+    task_cv_.wait(lock, [this] { return !task_running_; });
+  }
+
+  v8::Isolate* isolate_;
+  v8::Platform* platform_;
+  std::string path_;
+  size_t chunk_size_;
+  ChunkQueue queue_;
+  std::thread reader_;
+  bool read_failed_ = false;
+
+  std::unique_ptr<v8::ScriptCompiler::StreamedSource> source_;
+  std::unique_ptr<v8::ScriptCompiler::ScriptStreamingTask> task_;
+  std::mutex task_mutex_;
+  std::condition_variable task_cv_;
+  bool task_running_ = false;
+
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::duration<double, std::milli> blocked_{0};
+  std::chrono::duration<double, std::milli> total_{0};
+};
+
+#endif  // SRC_STREAMING_COMPILE_H_
@@ -0,0 +1,193 @@
+#ifndef SRC_TASK_INJECTOR_H_
+#define SRC_TASK_INJECTOR_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+
+#include "v8.h"
+#include "mpsc-queue.h"
+
+// A task that another thread hands to an isolate's thread through a
+// TaskInjector. It is run, and then deleted if the injector owns it, on the
+// isolate's thread with the isolate entered and a HandleScope open.
+class InjectedTask : public MpscNode {
+ public:
+  virtual ~InjectedTask() {}
+  virtual void Run(v8::Isolate* isolate) = 0;
+  // Microtasks are only queued by Run, they are not macrotasks themselves.
+  virtual bool is_microtask() const { return false; }
+
+ private:
+  friend class TaskInjector;
+  bool owned_ = true;
+};
+
+// The way for threads other than an isolate's own to get work onto it, for
+// example I/O completions or results computed by a thread pool.
+//
+// V8 has to be called on the isolate's thread, EnqueueMicrotask included,
+// so background threads Post an InjectedTask, or PostMicrotask a callback,
+// from any thread without taking a lock (see mpsc-queue.h). The isolate's
+// thread waits on fd(), an eventfd, next to whatever else it waits for, and
+// Drain runs what was posted: InjectedTasks as macrotasks, microtask
+// callbacks are put on the microtask queue for the next checkpoint.
+//
+// The eventfd is only written when the consumer may be asleep, the first
+// Post after a Drain started, so a burst of posts costs one write(2).
+//
+// Background work that will post later keeps the loop alive with Ref, and
+// calls Unref when it is done (see EventLoop::SetTaskInjector).
+class TaskInjector {
+ public:
+  explicit TaskInjector(v8::Isolate* isolate)
+      : isolate_(isolate),
+        event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+  ~TaskInjector() {
+    // Tasks that were never run are deleted without running them.
+    MpscNode* node;
+    while ((node = queue_.Pop()) != nullptr) {
+      InjectedTask* task = static_cast<InjectedTask*>(node);
+      if (task->owned_) {
+        delete task;
+      }
+    }
+    close(event_fd_);
+  }
+
+  // Can be called from any thread.
+  void Post(std::unique_ptr<InjectedTask> task) {
+    task->owned_ = true;
+    queue_.Push(task.release());
+    Signal();
+  }
+
+  // Posts a task the injector does not own, for example one embedded in
+  // the object waiting for it (see promise-task.h), so posting does not
+  // allocate. It has to stay alive until it is run, and may be destroyed
+  // by its own Run.
+  void PostUnowned(InjectedTask* task) {
+    task->owned_ = false;
+    queue_.Push(task);
+    Signal();
+  }
+
+  // Can be called from any thread. The callback is queued as a microtask
+  // on the isolate's thread by the next Drain.
+  void PostMicrotask(v8::MicrotaskCallback callback, void* data = nullptr) {
+    Post(std::unique_ptr<InjectedTask>(new MicrotaskTask(this, callback, data)));
+  }
+
+  // Microtasks go to the isolate's default queue unless this is set, for
+  // example to MicrotaskScheduler::queue().
+  void SetMicrotaskQueue(v8::MicrotaskQueue* queue) {
+    microtask_queue_ = queue;
+  }
+
+  // Keeps the loop waiting for posts. Can be called from any thread.
+  void Ref() {
+    refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Wakes up the loop so it can notice that nothing is left to wait for.
+  void Unref() {
+    refs_.fetch_sub(1, std::memory_order_release);
+    Signal(true);
+  }
+
+  // Unref from a task run by Drain: the loop is awake and checks for refs
+  // after draining, so there is nothing to signal.
+  void UnrefFromTask() {
+    refs_.fetch_sub(1, std::memory_order_release);
+  }
+
+  bool has_refs() const {
+    return refs_.load(std::memory_order_acquire) > 0;
+  }
+
+  // Becomes readable when there is something to Drain.
+  int fd() const { return event_fd_; }
+
+  // Runs what has been posted, at least everything whose Post returned
+  // before the call, on the isolate's thread, calling after_each() after
+  // each InjectedTask (to perform a microtask checkpoint, for example).
+  // Returns the number of tasks run.
+  template <typename AfterEach>
+  size_t Drain(AfterEach after_each) {
+    uint64_t value;
+    while (read(event_fd_, &value, sizeof(value)) == -1 && errno == EINTR) {
+    }
+    // Posts from here on signal again. A Post that is not visible to Pop
+    // below has not reached its Signal yet, so it will.
+    signaled_.store(false, std::memory_order_seq_cst);
+    size_t count = 0;
+    MpscNode* node;
+    while ((node = queue_.Pop()) != nullptr) {
+      InjectedTask* task = static_cast<InjectedTask*>(node);
+      // An unowned task may be gone once it ran.
+      bool owned = task->owned_;
+      bool is_microtask = task->is_microtask();
+      {
+        v8::HandleScope handle_scope(isolate_);
+        task->Run(isolate_);
+      }
+      if (owned) {
+        delete task;
+      }
+      count++;
+      if (!is_microtask) {
+        after_each();
+      }
+    }
+    return count;
+  }
+
+  size_t Drain() {
+    return Drain([] {});
+  }
+
+ private:
+  class MicrotaskTask : public InjectedTask {
+   public:
+    MicrotaskTask(TaskInjector* injector, v8::MicrotaskCallback callback,
+                  void* data)
+        : injector_(injector), callback_(callback), data_(data) {}
+
+    void Run(v8::Isolate* isolate) override {
+      if (injector_->microtask_queue_ != nullptr) {
+        injector_->microtask_queue_->EnqueueMicrotask(isolate, callback_, data_);
+      } else {
+        isolate->EnqueueMicrotask(callback_, data_);
+      }
+    }
+
+    bool is_microtask() const override { return true; }
+
+   private:
+    TaskInjector* injector_;
+    v8::MicrotaskCallback callback_;
+    void* data_;
+  };
+
+  void Signal(bool always = false) {
+    if (!signaled_.exchange(true, std::memory_order_seq_cst) || always) {
+      uint64_t one = 1;
+      while (write(event_fd_, &one, sizeof(one)) == -1 && errno == EINTR) {
+      }
+    }
+  }
+
+  v8::Isolate* isolate_;
+  int event_fd_;
+  MpscQueue queue_;
+  std::atomic<bool> signaled_{false};
+  std::atomic<int> refs_{0};
+  v8::MicrotaskQueue* microtask_queue_ = nullptr;
+};
+
+#endif  // SRC_TASK_INJECTOR_H_
@@ -0,0 +1,204 @@
+#ifndef SRC_TIMER_WHEEL_H_
+#define SRC_TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A hierarchical timer wheel with four levels of 256 slots.
+//
+// Time is counted in ticks (the event loop uses one tick per millisecond).
+// Level 0 holds timers that expire within the next 256 ticks, one slot per
+// tick. Level 1 holds timers that expire within 256 * 256 ticks, one slot per
+// 256 ticks, and so on. Whenever level 0 wraps around, the next slot of
+// level 1 is cascaded, which means its timers are inserted again and end up
+// in level 0 where they fire on their exact tick.
+//
+// Timers are intrusive: they are TimerNodes (usually a base class of the
+// embedder's timer type) linked into the slot lists, so Schedule and Cancel
+// are O(1) and do not allocate, no matter how many timers are pending. A
+// scheduled node has to be cancelled before it is destroyed.
+class TimerNode {
+ public:
+  TimerNode() : prev_(this), next_(this), expires_(0) {}
+  virtual ~TimerNode() {}
+
+  bool IsScheduled() const { return next_ != this; }
+  uint64_t expires() const { return expires_; }
+
+ private:
+  friend class TimerWheel;
+
+  void Unlink() {
+    prev_->next_ = next_;
+    next_->prev_ = prev_;
+    prev_ = next_ = this;
+  }
+
+  // Inserts this node before head, i.e. at the end of the list.
+  void LinkBefore(TimerNode* head) {
+    prev_ = head->prev_;
+    next_ = head;
+    head->prev_->next_ = this;
+    head->prev_ = this;
+  }
+
+  TimerNode* prev_;
+  TimerNode* next_;
+  uint64_t expires_;
+};
+
+class TimerWheel {
+ public:
+  static const int kLevels = 4;
+  static const int kSlotBits = 8;
+  static const int kSlots = 1 << kSlotBits;
+  static const uint64_t kSlotMask = kSlots - 1;
+  // Timers further away than this are put in the last slot of the highest
+  // level and are cascaded until they are within range.
+  static const uint64_t kMaxDelta = (1ULL << (kLevels * kSlotBits)) - 1;
+
+  explicit TimerWheel(uint64_t now = 0) : now_(now), count_(0) {}
+
+  ~TimerWheel() {
+    // Leave the nodes in a valid state in case they outlive the wheel.
+    for (int level = 0; level < kLevels; level++) {
+      for (int slot = 0; slot < kSlots; slot++) {
+        TimerNode* head = &slots_[level][slot];
+        while (head->next_ != head) {
+          head->next_->Unlink();
+        }
+      }
+    }
+  }
+
+  // Schedules node to expire at tick expires. A node that is already
+  // scheduled is moved. Expiry times in the past fire on the next Advance.
+  void Schedule(TimerNode* node, uint64_t expires) {
+    if (node->IsScheduled()) {
+      Cancel(node);
+    }
+    node->expires_ = expires;
+    Insert(node, false);
+    count_++;
+  }
+
+  void Cancel(TimerNode* node) {
+    if (!node->IsScheduled()) {
+      return;
+    }
+    node->Unlink();
+    count_--;
+  }
+
+  // Advances the wheel to tick now and calls callback(node) for each timer
+  // that expired, in order of expiry. The node is no longer scheduled when
+  // the callback runs, so the callback may reschedule or delete it, and it
+  // may schedule or cancel other timers.
+  template <typename Callback>
+  void Advance(uint64_t now, Callback callback) {
+    while (now_ < now) {
+      if (count_ == 0) {
+        now_ = now;
+        return;
+      }
+      now_++;
+      if ((now_ & kSlotMask) == 0) {
+        Cascade(1);
+      }
+      TimerNode* head = &slots_[0][now_ & kSlotMask];
+      // Move the expired timers to a local list first since the callbacks
+      // may add timers to the slot that is being processed.
+      TimerNode expired;
+      while (head->next_ != head) {
+        TimerNode* node = head->next_;
+        node->Unlink();
+        node->LinkBefore(&expired);
+      }
+      while (expired.next_ != &expired) {
+        TimerNode* node = expired.next_;
+        node->Unlink();
+        count_--;
+        callback(node);
+      }
+    }
+  }
+
+  // Returns the number of ticks from now until the wheel needs to be
+  // advanced again, or -1 if no timers are scheduled. This is exact for
+  // timers in level 0, for timers further away it is the time until the
+  // next cascade, after which it can be asked again.
+  int64_t NextTimeout() const {
+    if (count_ == 0) {
+      return -1;
+    }
+    for (uint64_t i = 1; i <= kSlotMask; i++) {
+      uint64_t tick = now_ + i;
+      if ((tick & kSlotMask) == 0) {
+        return static_cast<int64_t>(i);
+      }
+      const TimerNode* head = &slots_[0][tick & kSlotMask];
+      if (head->next_ != head) {
+        return static_cast<int64_t>(i);
+      }
+    }
+    return kSlots;
+  }
+
+  uint64_t now() const { return now_; }
+  size_t size() const { return count_; }
+
+ private:
+  // The slot for the current tick has already been processed when a timer
+  // is scheduled, but not yet when a cascade re-inserts timers into it.
+  void Insert(TimerNode* node, bool cascading) {
+    uint64_t expires = node->expires_;
+    uint64_t earliest = cascading ? now_ : now_ + 1;
+    if (expires < earliest) {
+      expires = earliest;
+    }
+    uint64_t delta = expires - now_;
+    if (delta > kMaxDelta) {
+      expires = now_ + kMaxDelta;
+      delta = kMaxDelta;
+    }
+    // The level is the one whose slots are wide enough that the timer's
+    // slot is not before the slot that is processed next.
+    int level = 0;
+    while (level < kLevels - 1 &&
+           (expires >> (kSlotBits * (level + 1))) != (now_ >> (kSlotBits * (level + 1)))) {
+      level++;
+    }
+    uint64_t slot = (expires >> (kSlotBits * level)) & kSlotMask;
+    node->LinkBefore(&slots_[level][slot]);
+  }
+
+  // Re-inserts the timers of the current slot of level, which will now
+  // land in lower levels. Called when all levels below it have wrapped.
+  void Cascade(int level) {
+    if (level >= kLevels) {
+      return;
+    }
+    uint64_t index = (now_ >> (kSlotBits * level)) & kSlotMask;
+    if (index == 0) {
+      Cascade(level + 1);
+    }
+    TimerNode* head = &slots_[level][index];
+    TimerNode pending;
+    while (head->next_ != head) {
+      TimerNode* node = head->next_;
+      node->Unlink();
+      node->LinkBefore(&pending);
+    }
+    while (pending.next_ != &pending) {
+      TimerNode* node = pending.next_;
+      node->Unlink();
+      Insert(node, true);
+    }
+  }
+
+  uint64_t now_;
+  size_t count_;
+  TimerNode slots_[kLevels][kSlots];
+};
+
+#endif  // SRC_TIMER_WHEEL_H_
@@ -0,0 +1,425 @@
+#ifndef SRC_WORK_STEALING_PLATFORM_H_
+#define SRC_WORK_STEALING_PLATFORM_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "libplatform/libplatform.h"
+#include "v8.h"
+#include "platform-message-loop.h"
+
+// A v8::Platform whose worker threads each have their own task queues and
+// steal from each other when they run out, instead of all sharing the one
+// queue of the DefaultPlatform.
+//
+// A task posted from a worker thread goes to that worker's queues, a task
+// posted from any other thread (an isolate's thread, usually) goes to the
+// next worker in round-robin order. Either way the posting thread only
+// contends with the worker that owns the queue and with thieves, which
+// matters when many isolates post GC and compile tasks at the same time.
+//
+// Every worker has one queue per TaskPriority. A worker looking for a task
+// checks its own queue and then the other workers' queues for the highest
+// priority before moving on to the next one, so a kUserBlocking task is
+// never waiting behind kBestEffort ones. CallOnWorkerThread posts with
+// kUserVisible priority, CallBlockingTaskOnWorkerThread with kUserBlocking
+// and CallLowPriorityTaskOnWorkerThread with kBestEffort. Jobs are run by
+// the default JobHandle from libplatform, which posts its worker tasks
+// through those three depending on the job's priority and asks the JobTask
+// for its GetMaxConcurrency.
+//
+// Foreground tasks are kept per isolate and are run by PumpMessageLoop, or
+// PumpPlatformMessageLoop (see platform-message-loop.h) for code that only
+// has a v8::Platform*. Idle tasks are run by RunIdleTasks, and are only
+// enabled for isolates that ask for them with SetIdleTasksEnabled, which
+// IdleGcScheduler does.
+class WorkStealingPlatform : public v8::Platform, public PlatformMessageLoop {
+ public:
+  // Uses one worker per core, minus one for the main thread, if
+  // worker_threads is 0.
+  explicit WorkStealingPlatform(int worker_threads = 0)
+      : tracing_controller_(new v8::TracingController()) {
+    if (worker_threads <= 0) {
+      worker_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    }
+    for (int i = 0; i < worker_threads; i++) {
+      workers_.emplace_back(new Worker());
+    }
+    for (int i = 0; i < worker_threads; i++) {
+      workers_[i]->thread = std::thread(&WorkStealingPlatform::WorkerMain, this, i);
+    }
+    delayed_thread_ = std::thread(&WorkStealingPlatform::DelayedMain, this);
+    PlatformMessageLoop::Register(this, this);
+  }
+
+  // Waits for the tasks that are running, tasks that have not started yet
+  // are discarded.
+  ~WorkStealingPlatform() override {
+    PlatformMessageLoop::Unregister(this);
+    {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      stopping_ = true;
+    }
+    idle_cv_.notify_all();
+    {
+      std::lock_guard<std::mutex> lock(delayed_mutex_);
+      delayed_stopping_ = true;
+    }
+    delayed_cv_.notify_all();
+    for (std::unique_ptr<Worker>& worker : workers_) {
+      worker->thread.join();
+    }
+    delayed_thread_.join();
+  }
+
+  int NumberOfWorkerThreads() override {
+    return static_cast<int>(workers_.size());
+  }
+
+  std::shared_ptr<v8::TaskRunner> GetForegroundTaskRunner(
+      v8::Isolate* isolate) override {
+    return ForegroundRunner(isolate);
+  }
+
+  void CallOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    Post(v8::TaskPriority::kUserVisible, std::move(task));
+  }
+
+  void CallBlockingTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    Post(v8::TaskPriority::kUserBlocking, std::move(task));
+  }
+
+  void CallLowPriorityTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+    Post(v8::TaskPriority::kBestEffort, std::move(task));
+  }
+
+  void CallDelayedOnWorkerThread(std::unique_ptr<v8::Task> task,
+                                 double delay_in_seconds) override {
+    {
+      std::lock_guard<std::mutex> lock(delayed_mutex_);
+      delayed_.emplace(Now() + delay_in_seconds, std::move(task));
+    }
+    delayed_cv_.notify_one();
+  }
+
+  std::unique_ptr<v8::JobHandle> PostJob(
+      v8::TaskPriority priority, std::unique_ptr<v8::JobTask> job_task) override {
+    return v8::platform::NewDefaultJobHandle(this, priority, std::move(job_task),
+                                             workers_.size());
+  }
+
+  double MonotonicallyIncreasingTime() override {
+    return Now();
+  }
+
+  double CurrentClockTimeMillis() override {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  v8::TracingController* GetTracingController() override {
+    return tracing_controller_.get();
+  }
+
+  bool PumpMessageLoop(v8::Isolate* isolate, bool wait = false) override {
+    std::unique_ptr<v8::Task> task = ForegroundRunner(isolate)->Pop(wait);
+    if (!task) {
+      return false;
+    }
+    task->Run();
+    return true;
+  }
+
+  // Runs idle tasks until there are none left or idle_time_in_seconds
+  // has passed. Each task is given the deadline and is expected to stop by
+  // then. The embedder calls this when it knows the isolate's thread has
+  // nothing else to do, see idle-gc-scheduler.h.
+  void RunIdleTasks(v8::Isolate* isolate, double idle_time_in_seconds) override {
+    double deadline = Now() + idle_time_in_seconds;
+    std::shared_ptr<ForegroundTaskRunner> runner = ForegroundRunner(isolate);
+    while (Now() < deadline) {
+      std::unique_ptr<v8::IdleTask> task = runner->PopIdle();
+      if (!task) {
+        return;
+      }
+      task->Run(deadline);
+    }
+  }
+
+  bool IdleTasksEnabled(v8::Isolate* isolate) override {
+    return ForegroundRunner(isolate)->IdleTasksEnabled();
+  }
+
+  void SetIdleTasksEnabled(v8::Isolate* isolate, bool enabled) override {
+    ForegroundRunner(isolate)->SetIdleTasksEnabled(enabled);
+  }
+
+  // Drops the foreground tasks of an isolate that is being disposed, see
+  // NotifyPlatformIsolateShutdown.
+  void NotifyIsolateShutdown(v8::Isolate* isolate) override {
+    std::lock_guard<std::mutex> lock(foreground_mutex_);
+    foreground_.erase(isolate);
+  }
+
+  struct Stats {
+    uint64_t executed;
+    // Tasks that were run by another worker than the one they were posted to.
+    uint64_t stolen;
+  };
+
+  Stats stats() const {
+    return Stats{executed_.load(std::memory_order_relaxed),
+                 stolen_.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  static const int kNumPriorities = 3;
+
+  struct Worker {
+    std::mutex mutex;
+    // Indexed by PriorityIndex, highest priority first.
+    std::deque<std::unique_ptr<v8::Task>> queues[kNumPriorities];
+    std::thread thread;
+  };
+
+  class ForegroundTaskRunner : public v8::TaskRunner {
+   public:
+    void PostTask(std::unique_ptr<v8::Task> task) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+      cv_.notify_one();
+    }
+
+    void PostDelayedTask(std::unique_ptr<v8::Task> task,
+                         double delay_in_seconds) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      delayed_.emplace(Now() + delay_in_seconds, std::move(task));
+      cv_.notify_one();
+    }
+
+    void PostIdleTask(std::unique_ptr<v8::IdleTask> task) override {
+      std::lock_guard<std::mutex> lock(mutex_);
+      idle_tasks_.push_back(std::move(task));
+    }
+
+    bool IdleTasksEnabled() override {
+      return idle_enabled_.load(std::memory_order_relaxed);
+    }
+
+    // The idle tasks already posted are dropped when disabled, nobody is
+    // going to run them.
+    void SetIdleTasksEnabled(bool enabled) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      idle_enabled_.store(enabled, std::memory_order_relaxed);
+      if (!enabled) {
+        idle_tasks_.clear();
+      }
+    }
+
+    std::unique_ptr<v8::IdleTask> PopIdle() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (idle_tasks_.empty()) {
+        return nullptr;
+      }
+      std::unique_ptr<v8::IdleTask> task = std::move(idle_tasks_.front());
+      idle_tasks_.pop_front();
+      return task;
+    }
+
+    // Returns the next task that is due, waiting for one if wait is true.
+    std::unique_ptr<v8::Task> Pop(bool wait) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (;;) {
+        double now = Now();
+        while (!delayed_.empty() && delayed_.begin()->first <= now) {
+          tasks_.push_back(std::move(delayed_.begin()->second));
+          delayed_.erase(delayed_.begin());
+        }
+        if (!tasks_.empty()) {
+          std::unique_ptr<v8::Task> task = std::move(tasks_.front());
+          tasks_.pop_front();
+          return task;
+        }
+        if (!wait) {
+          return nullptr;
+        }
+        if (delayed_.empty()) {
+          cv_.wait(lock);
+        } else {
+          cv_.wait_for(lock, std::chrono::duration<double>(
+              delayed_.begin()->first - now));
+        }
+      }
+    }
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::unique_ptr<v8::Task>> tasks_;
+    std::multimap<double, std::unique_ptr<v8::Task>> delayed_;
+    std::deque<std::unique_ptr<v8::IdleTask>> idle_tasks_;
+    std::atomic<bool> idle_enabled_{false};
+  };
+
+  // In seconds, the task runners can outlive the platform so this is static.
+  static double Now() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static int PriorityIndex(v8::TaskPriority priority) {
+    switch (priority) {
+      case v8::TaskPriority::kUserBlocking:
+        return 0;
+      case v8::TaskPriority::kUserVisible:
+        return 1;
+      case v8::TaskPriority::kBestEffort:
+        return 2;
+    }
+    return 1;
+  }
+
+  // The worker the current thread is, if it is one of this platform's.
+  struct CurrentWorker {
+    const WorkStealingPlatform* platform;
+    int index;
+  };
+
+  static CurrentWorker& current_worker() {
+    static thread_local CurrentWorker current = {nullptr, -1};
+    return current;
+  }
+
+  std::shared_ptr<ForegroundTaskRunner> ForegroundRunner(v8::Isolate* isolate) {
+    std::lock_guard<std::mutex> lock(foreground_mutex_);
+    std::shared_ptr<ForegroundTaskRunner>& runner = foreground_[isolate];
+    if (!runner) {
+      runner = std::make_shared<ForegroundTaskRunner>();
+    }
+    return runner;
+  }
+
+  void Post(v8::TaskPriority priority, std::unique_ptr<v8::Task> task) {
+    const CurrentWorker& current = current_worker();
+    size_t index = current.platform == this
+        ? static_cast<size_t>(current.index)
+        : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    Worker* worker = workers_[index].get();
+    {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      worker->queues[PriorityIndex(priority)].push_back(std::move(task));
+    }
+    pending_.fetch_add(1);
+    // Sleeping workers are only woken when there are any, which keeps the
+    // mutex off the posting path when all workers are busy. A worker
+    // registers as sleeping before it checks pending_ for the last time,
+    // so either it sees this task or it is woken.
+    if (sleepers_.load() > 0) {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      idle_cv_.notify_one();
+    }
+  }
+
+  // Takes the oldest task of the highest priority, from worker index's own
+  // queue first and otherwise stolen from another worker.
+  std::unique_ptr<v8::Task> Take(size_t index) {
+    const size_t count = workers_.size();
+    for (int priority = 0; priority < kNumPriorities; priority++) {
+      for (size_t i = 0; i < count; i++) {
+        Worker* worker = workers_[(index + i) % count].get();
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        std::deque<std::unique_ptr<v8::Task>>& queue = worker->queues[priority];
+        if (!queue.empty()) {
+          std::unique_ptr<v8::Task> task = std::move(queue.front());
+          queue.pop_front();
+          pending_.fetch_sub(1);
+          if (i != 0) {
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+          }
+          return task;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  void WorkerMain(int index) {
+    current_worker() = CurrentWorker{this, index};
+    while (!stopping_.load()) {
+      std::unique_ptr<v8::Task> task = Take(static_cast<size_t>(index));
+      if (task) {
+        task->Run();
+        executed_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(idle_mutex_);
+      sleepers_.fetch_add(1);
+      idle_cv_.wait(lock, [this] { return stopping_ || pending_.load() > 0; });
+      sleepers_.fetch_sub(1);
+      if (stopping_) {
+        return;
+      }
+    }
+  }
+
+  // Moves delayed worker tasks to the workers when they are due.
+  void DelayedMain() {
+    std::unique_lock<std::mutex> lock(delayed_mutex_);
+    while (!delayed_stopping_) {
+      double now = Now();
+      std::vector<std::unique_ptr<v8::Task>> due;
+      while (!delayed_.empty() && delayed_.begin()->first <= now) {
+        due.push_back(std::move(delayed_.begin()->second));
+        delayed_.erase(delayed_.begin());
+      }
+      if (!due.empty()) {
+        lock.unlock();
+        for (std::unique_ptr<v8::Task>& task : due) {
+          CallOnWorkerThread(std::move(task));
+        }
+        lock.lock();
+        continue;
+      }
+      if (delayed_.empty()) {
+        delayed_cv_.wait(lock);
+      } else {
+        delayed_cv_.wait_for(lock, std::chrono::duration<double>(
+            delayed_.begin()->first - now));
+      }
+    }
+  }
+
+  std::unique_ptr<v8::TracingController> tracing_controller_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_{0};
+  std::atomic<size_t> pending_{0};
+  std::atomic<int> sleepers_{0};
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+  std::atomic<bool> stopping_{false};
+
+  std::thread delayed_thread_;
+  std::mutex delayed_mutex_;
+  std::condition_variable delayed_cv_;
+  std::multimap<double, std::unique_ptr<v8::Task>> delayed_;
+  bool delayed_stopping_ = false;
+
+  std::mutex foreground_mutex_;
+  std::unordered_map<v8::Isolate*, std::shared_ptr<ForegroundTaskRunner>> foreground_;
+
+  std::atomic<uint64_t> executed_{0};
+  std::atomic<uint64_t> stolen_{0};
+};
+
+#endif  // SRC_WORK_STEALING_PLATFORM_H_
@@ -1,6 +1,11 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
 #include "gtest/gtest.h"
 #include "v8.h"
 #include "v8_test_fixture.h"
+#include "../src/pooled-allocator.h"
 
 using namespace v8;
 
@@ -50,3 +55,126 @@ TEST_F(ArrayBufferTest, Float64Array) {
   EXPECT_EQ(static_cast<int>(array->Length()), count);
   print_local(array);
 }
+
+TEST_F(ArrayBufferTest, PooledAllocator) {
+  PooledArrayBufferAllocator allocator;
+  char* data = static_cast<char*>(allocator.Allocate(100));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(0, data[i]);
+  }
+  memset(data, 'x', 100);
+  allocator.Free(data, 100);
+  EXPECT_EQ(0u, allocator.stats().bytes_live);
+  EXPECT_EQ(128u, allocator.stats().bytes_cached);
+
+  // Same size class, so the same block, cleared again.
+  char* reused = static_cast<char*>(allocator.Allocate(120));
+  EXPECT_EQ(data, reused);
+  for (int i = 0; i < 120; i++) {
+    EXPECT_EQ(0, reused[i]);
+  }
+  EXPECT_EQ(128u, allocator.stats().bytes_live);
+  allocator.Free(reused, 120);
+  EXPECT_EQ(data, allocator.AllocateUninitialized(128));
+  allocator.Free(data, 128);
+
+  void* large = allocator.Allocate(3 << 20);
+  EXPECT_EQ(3u << 20, allocator.stats().bytes_live);
+  allocator.Free(large, 3 << 20);
+
+  PooledArrayBufferAllocator::Stats stats = allocator.stats();
+  EXPECT_EQ(0u, stats.bytes_live);
+  EXPECT_EQ(2u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+  EXPECT_EQ(0.5, stats.hit_rate());
+
+  Isolate::CreateParams create_params;
+  create_params.array_buffer_allocator = &allocator;
+  Isolate* isolate = Isolate::New(create_params);
+  {
+    Isolate::Scope isolate_scope(isolate);
+    const v8::HandleScope handle_scope(isolate);
+    size_t live = allocator.stats().bytes_live;
+    Local<ArrayBuffer> ab = ArrayBuffer::New(isolate, 1000);
+    EXPECT_EQ(live + 1024, allocator.stats().bytes_live);
+    const char* contents = static_cast<const char*>(ab->GetBackingStore()->Data());
+    for (int i = 0; i < 1000; i++) {
+      EXPECT_EQ(0, contents[i]);
+    }
+  }
+  isolate->Dispose();
+}
+
+// Allocates typed arrays of 128 bytes to 64KB from JavaScript, keeping only
+// the last 64 alive, with V8's default allocator and with the pooled one.
+// Then does the same directly against the allocators, without V8.
+TEST_F(ArrayBufferTest, AllocatorChurnBenchmark) {
+  const int iterations = 500000;
+  std::unique_ptr<ArrayBuffer::Allocator> default_allocator(
+      ArrayBuffer::Allocator::NewDefaultAllocator());
+  PooledArrayBufferAllocator pooled_allocator;
+  struct {
+    const char* name;
+    ArrayBuffer::Allocator* allocator;
+  } allocators[] = {
+    {"default", default_allocator.get()},
+    {"pooled", &pooled_allocator},
+  };
+
+  std::string js =
+      "let keep = [];"
+      "let sum = 0;"
+      "for (let i = 0; i < " + std::to_string(iterations) + "; i++) {"
+      "  const array = new Uint8Array(128 << (i % 10));"
+      "  array[0] = i;"
+      "  sum += array[array.length - 1];"
+      "  keep[i & 63] = array;"
+      "}"
+      "sum;";
+  for (auto& entry : allocators) {
+    Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator = entry.allocator;
+    Isolate* isolate = Isolate::New(create_params);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      const v8::HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      Local<String> source = String::NewFromUtf8(isolate, js.c_str()).ToLocalChecked();
+      Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+      auto start = std::chrono::steady_clock::now();
+      Local<Value> sum = script->Run(context).ToLocalChecked();
+      double ms = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start).count();
+      // Every array was zeroed.
+      EXPECT_EQ(0, sum->Int32Value(context).FromJust());
+      std::cout << entry.name << " allocator, JavaScript: " << ms << "ms\n";
+    }
+    isolate->Dispose();
+  }
+  PooledArrayBufferAllocator::Stats stats = pooled_allocator.stats();
+  std::cout << "pooled: hit rate " << stats.hit_rate() << ", "
+            << stats.bytes_live << " bytes live, " << stats.bytes_cached
+            << " bytes cached, " << stats.bytes_reserved << " bytes reserved\n";
+
+  for (auto& entry : allocators) {
+    void* keep[64] = {};
+    size_t lengths[64] = {};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations * 4; i++) {
+      size_t length = 128u << (i % 10);
+      int slot = i & 63;
+      if (keep[slot] != nullptr) {
+        entry.allocator->Free(keep[slot], lengths[slot]);
+      }
+      keep[slot] = entry.allocator->Allocate(length);
+      lengths[slot] = length;
+    }
+    for (int slot = 0; slot < 64; slot++) {
+      entry.allocator->Free(keep[slot], lengths[slot]);
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << entry.name << " allocator, native: " << ms << "ms\n";
+  }
+}
@@ -0,0 +1,95 @@
+#include <chrono>
+#include <iostream>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/bindings-snapshot.h"
+
+using namespace v8;
+
+class BindingsSnapshotTest : public V8TestFixture {
+};
+
+static std::string RunPerson(Isolate* isolate, Local<Context> context) {
+  Context::Scope context_scope(context);
+  Local<String> source = String::NewFromUtf8Literal(isolate,
+      "var p = new Person('Fletch'); p.name;");
+  Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+  String::Utf8Value value(isolate, script->Run(context).ToLocalChecked());
+  return *value;
+}
+
+TEST_F(BindingsSnapshotTest, ContextFromSnapshot) {
+  std::unique_ptr<BindingsSnapshot> snapshot = BindingsSnapshot::Create();
+  ASSERT_TRUE(snapshot);
+
+  Isolate::CreateParams create_params;
+  create_params.array_buffer_allocator = allocator_.get();
+  snapshot->Apply(&create_params);
+  Isolate* isolate = Isolate::New(create_params);
+  {
+    Isolate::Scope isolate_scope(isolate);
+    HandleScope handle_scope(isolate);
+    Local<Context> context = BindingsSnapshot::NewContext(isolate).ToLocalChecked();
+    EXPECT_EQ(RunPerson(isolate, context), "Fletch");
+  }
+  isolate->Dispose();
+}
+
+TEST_F(BindingsSnapshotTest, WriteAndRead) {
+  std::unique_ptr<BindingsSnapshot> snapshot = BindingsSnapshot::Create();
+  ASSERT_TRUE(snapshot);
+  char path[] = "/tmp/bindings_snapshot_test_XXXXXX";
+  close(mkstemp(path));
+  EXPECT_TRUE(snapshot->Write(path));
+  std::unique_ptr<BindingsSnapshot> read = BindingsSnapshot::Read(path);
+  ASSERT_TRUE(read);
+  EXPECT_EQ(read->blob()->raw_size, snapshot->blob()->raw_size);
+  EXPECT_EQ(memcmp(read->blob()->data, snapshot->blob()->data,
+                   snapshot->blob()->raw_size), 0);
+  unlink(path);
+}
+
+TEST_F(BindingsSnapshotTest, CreationTime) {
+  std::unique_ptr<BindingsSnapshot> snapshot = BindingsSnapshot::Create();
+  ASSERT_TRUE(snapshot);
+  const int iterations = 100;
+  using us = std::chrono::duration<double, std::micro>;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate, nullptr,
+                                            NewGlobalTemplate(isolate));
+      EXPECT_FALSE(context.IsEmpty());
+    }
+    isolate->Dispose();
+  }
+  auto templates = std::chrono::steady_clock::now() - start;
+
+  Isolate::CreateParams create_params;
+  create_params.array_buffer_allocator = allocator_.get();
+  snapshot->Apply(&create_params);
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    Isolate* isolate = Isolate::New(create_params);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = BindingsSnapshot::NewContext(isolate).ToLocalChecked();
+      EXPECT_FALSE(context.IsEmpty());
+    }
+    isolate->Dispose();
+  }
+  auto from_snapshot = std::chrono::steady_clock::now() - start;
+
+  std::cout << "snapshot size: " << snapshot->blob()->raw_size << " bytes\n";
+  std::cout << "isolate+context from templates: "
+            << us(templates).count() / iterations << " us\n";
+  std::cout << "isolate+context from snapshot:  "
+            << us(from_snapshot).count() / iterations << " us\n";
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/bulk-compile.h"
+
+using namespace v8;
+
+class BulkCompileTest : public V8TestFixture {
+ protected:
+  std::string RunToString(Local<Context> context, const char* js) {
+    Local<String> source = String::NewFromUtf8(isolate_, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    String::Utf8Value value(isolate_, script->Run(context).ToLocalChecked());
+    return *value;
+  }
+};
+
+TEST_F(BulkCompileTest, RunsInDependencyOrder) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+
+  BulkCompile compile(isolate_, platform_.get());
+  compile.Add("c.js", "order.push('c'); var c = b + 1;", {"b.js"});
+  compile.Add("order.js", "var order = [];");
+  compile.Add("b.js", "order.push('b'); var b = a + 1;", {"a.js", "order.js"});
+  compile.Add("a.js", "order.push('a'); var a = 1;", {"order.js"});
+  compile.Add("d.js", "order.push('d');", {"order.js"});
+  ASSERT_TRUE(compile.Compile(context)) << compile.error();
+  ASSERT_TRUE(compile.Run(context)) << compile.error();
+  // Scripts without a dependency between them keep the order they were
+  // added in.
+  EXPECT_EQ("a,b,c,d", RunToString(context, "order.join()"));
+  EXPECT_EQ("3", RunToString(context, "c"));
+  EXPECT_FALSE(compile.code_cache("a.js").empty());
+  EXPECT_FALSE(compile.script("b.js").IsEmpty());
+  EXPECT_TRUE(compile.script("e.js").IsEmpty());
+}
+
+TEST_F(BulkCompileTest, Errors) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+
+  {
+    BulkCompile compile(isolate_, platform_.get());
+    compile.Add("ok.js", "var ok = 1;");
+    compile.Add("broken.js", "var = ;");
+    EXPECT_FALSE(compile.Compile(context));
+    EXPECT_EQ(0, compile.error().find("broken.js: SyntaxError")) << compile.error();
+  }
+  {
+    BulkCompile compile(isolate_, platform_.get());
+    compile.Add("a.js", "", {"b.js"});
+    compile.Add("b.js", "", {"a.js"});
+    ASSERT_TRUE(compile.Compile(context));
+    EXPECT_FALSE(compile.Run(context));
+    EXPECT_EQ("dependency cycle", compile.error());
+  }
+  {
+    BulkCompile compile(isolate_, platform_.get());
+    compile.Add("a.js", "", {"missing.js"});
+    ASSERT_TRUE(compile.Compile(context));
+    EXPECT_FALSE(compile.Run(context));
+    EXPECT_EQ("a.js: unknown dependency missing.js", compile.error());
+  }
+  {
+    BulkCompile compile(isolate_, platform_.get());
+    compile.Add("throws.js", "throw new Error('oops');");
+    ASSERT_TRUE(compile.Compile(context));
+    EXPECT_FALSE(compile.Run(context));
+    EXPECT_EQ("throws.js: Error: oops", compile.error());
+  }
+}
+
+struct SyntheticModule {
+  std::string name;
+  std::string source;
+  std::vector<std::string> dependencies;
+};
+
+// Module i depends on modules i - 1 and i / 2, and defines a few functions
+// that use them.
+static std::vector<SyntheticModule> SyntheticModules(int count) {
+  std::vector<SyntheticModule> modules;
+  for (int i = 0; i < count; i++) {
+    std::string n = std::to_string(i);
+    SyntheticModule module;
+    module.name = "m" + n + ".js";
+    std::string base = "0";
+    if (i > 0) {
+      std::string prev = std::to_string(i - 1);
+      std::string half = std::to_string(i / 2);
+      module.dependencies.push_back("m" + prev + ".js");
+      if (i / 2 != i - 1) {
+        module.dependencies.push_back("m" + half + ".js");
+      }
+      base = "m" + prev + ".value + m" + half + ".value % 7";
+    }
+    module.source = "var m" + n + " = (function() {\n"
+                    "  var value = " + base + " + 1;\n";
+    for (int f = 0; f < 40; f++) {
+      std::string fn = std::to_string(f);
+      module.source +=
+          "  function f" + fn + "(a, b) {\n"
+          "    let s = 0;\n"
+          "    for (let i = 0; i < a; i++) {\n"
+          "      s += (i * b + " + fn + ") % (value + 1);\n"
+          "      if (s > 1000) { s = s - 1000; } else { s = s + " + n + "; }\n"
+          "    }\n"
+          "    return [s, { a: a, b: b, name: 'f" + fn + "' }];\n"
+          "  }\n";
+    }
+    module.source += "  return { value: value, f0: f0, f39: f39 };\n"
+                     "})();\n";
+    modules.push_back(module);
+  }
+  return modules;
+}
+
+// Compiles and runs 500 modules one after another on the main thread, then
+// with BulkCompile limited to 1, 2, 4, ... threads, and then from the code
+// caches that produced. Every run gets a new isolate so that V8's
+// compilation cache does not carry over.
+TEST_F(BulkCompileTest, Benchmark) {
+  const std::vector<SyntheticModule> modules = SyntheticModules(500);
+  std::string expected;
+
+  {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      const HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      auto start = std::chrono::steady_clock::now();
+      for (const SyntheticModule& module : modules) {
+        ScriptOrigin origin(String::NewFromUtf8(isolate, module.name.c_str()).ToLocalChecked());
+        ScriptCompiler::Source source(
+            String::NewFromUtf8(isolate, module.source.c_str()).ToLocalChecked(), origin);
+        Local<UnboundScript> unbound =
+            ScriptCompiler::CompileUnboundScript(isolate, &source).ToLocalChecked();
+        delete ScriptCompiler::CreateCodeCache(unbound);
+        unbound->BindToCurrentContext()->Run(context).ToLocalChecked();
+      }
+      double ms = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start).count();
+      std::cout << "one after another: " << ms << "ms\n";
+      Local<String> last = String::NewFromUtf8Literal(isolate, "m499.value");
+      String::Utf8Value value(isolate, Script::Compile(context, last)
+          .ToLocalChecked()->Run(context).ToLocalChecked());
+      expected = *value;
+    }
+    isolate->Dispose();
+  }
+
+  std::vector<std::vector<uint8_t>> caches(modules.size());
+  size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> thread_counts;
+  for (size_t threads = 1; threads < cores; threads *= 2) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(cores);
+  // And once more, from the code caches.
+  thread_counts.push_back(0);
+
+  for (size_t threads : thread_counts) {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      const HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      BulkCompile compile(isolate, platform_.get(), threads == 0 ? cores : threads);
+      for (size_t i = 0; i < modules.size(); i++) {
+        compile.Add(modules[i].name, modules[i].source, modules[i].dependencies,
+                    threads == 0 ? caches[i] : std::vector<uint8_t>());
+      }
+      ASSERT_TRUE(compile.Compile(context)) << compile.error();
+      ASSERT_TRUE(compile.Run(context)) << compile.error();
+      if (threads == 0) {
+        EXPECT_EQ(modules.size(), compile.cache_hits());
+        std::cout << "from code caches: ";
+      } else {
+        std::cout << threads << " threads: ";
+      }
+      std::cout << "compile " << compile.compile_ms() << "ms, run "
+                << compile.run_ms() << "ms\n";
+      for (size_t i = 0; i < modules.size(); i++) {
+        caches[i] = compile.code_cache(modules[i].name);
+      }
+      Local<String> last = String::NewFromUtf8Literal(isolate, "m499.value");
+      String::Utf8Value value(isolate, Script::Compile(context, last)
+          .ToLocalChecked()->Run(context).ToLocalChecked());
+      EXPECT_EQ(expected, *value);
+    }
+    isolate->Dispose();
+  }
+}
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <iostream>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/code-cache.h"
+
+using namespace v8;
+
+class CodeCacheTest : public V8TestFixture {
+ protected:
+  std::string dir_;
+
+  virtual void SetUp() {
+    V8TestFixture::SetUp();
+    char tmpl[] = "/tmp/code_cache_test_XXXXXX";
+    dir_ = mkdtemp(tmpl);
+  }
+
+  virtual void TearDown() {
+    std::string cmd = "rm -rf " + dir_;
+    EXPECT_EQ(system(cmd.c_str()), 0);
+    V8TestFixture::TearDown();
+  }
+
+  // Compiles and runs js in a new isolate so that the in-isolate
+  // compilation cache cannot hide a hit or a miss in the on-disk cache.
+  int32_t CompileAndRun(CodeCache* cache, const std::string& js) {
+    Isolate* isolate = Isolate::New(create_params_);
+    int32_t value = 0;
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      Local<String> source = String::NewFromUtf8(isolate, js.c_str()).ToLocalChecked();
+      Local<String> name = String::NewFromUtf8Literal(isolate, "test.js");
+      Local<Script> script;
+      if (cache != nullptr) {
+        script = cache->Compile(context, source, name).ToLocalChecked();
+      } else {
+        ScriptOrigin origin(name);
+        ScriptCompiler::Source script_source(source, origin);
+        script = ScriptCompiler::Compile(context, &script_source).ToLocalChecked();
+      }
+      Local<Value> result = script->Run(context).ToLocalChecked();
+      value = result->Int32Value(context).FromJust();
+      if (cache != nullptr) {
+        cache->Commit(script);
+      }
+    }
+    isolate->Dispose();
+    return value;
+  }
+};
+
+static std::string LargeScript(int functions) {
+  std::string js;
+  for (int i = 0; i < functions; i++) {
+    std::string n = std::to_string(i);
+    js += "function f" + n + "(a, b) { let s = 0; for (let i = 0; i < a; i++) {"
+          " s += (i * b) % " + n + " + 1; } return s; }\n";
+  }
+  js += "f1(2, 3);";
+  return js;
+}
+
+TEST_F(CodeCacheTest, MissThenHit) {
+  CodeCache cache(dir_);
+  EXPECT_EQ(CompileAndRun(&cache, "18 + 2"), 20);
+  EXPECT_EQ(cache.stats().misses, 1u);
+  EXPECT_EQ(cache.stats().hits, 0u);
+
+  EXPECT_EQ(CompileAndRun(&cache, "18 + 2"), 20);
+  EXPECT_EQ(cache.stats().misses, 1u);
+  EXPECT_EQ(cache.stats().hits, 1u);
+  EXPECT_EQ(cache.stats().rejected, 0u);
+}
+
+TEST_F(CodeCacheTest, DifferentSourceIsMiss) {
+  CodeCache cache(dir_);
+  CompileAndRun(&cache, "1 + 1");
+  CompileAndRun(&cache, "1 + 2");
+  EXPECT_EQ(cache.stats().misses, 2u);
+  EXPECT_EQ(cache.stats().hits, 0u);
+}
+
+TEST_F(CodeCacheTest, DifferentFlagsIsMiss) {
+  CodeCache cache(dir_, "--no-lazy");
+  CodeCache other(dir_, "--lazy");
+  CompileAndRun(&cache, "1 + 1");
+  CompileAndRun(&other, "1 + 1");
+  EXPECT_EQ(other.stats().misses, 1u);
+  EXPECT_EQ(other.stats().hits, 0u);
+}
+
+TEST_F(CodeCacheTest, StaleCacheIsRejected) {
+  CodeCache cache(dir_);
+  const std::string js = "3 * 7";
+  CompileAndRun(&cache, js);
+
+  // Clobber the magic number at the start of the cached data.
+  std::string path;
+  {
+    Isolate::Scope isolate_scope(isolate_);
+    HandleScope handle_scope(isolate_);
+    path = cache.PathFor(isolate_,
+        String::NewFromUtf8(isolate_, js.c_str()).ToLocalChecked());
+  }
+  FILE* file = fopen(path.c_str(), "r+b");
+  ASSERT_NE(file, nullptr);
+  const uint32_t garbage = 0xdeadbeef;
+  fwrite(&garbage, sizeof(garbage), 1, file);
+  fclose(file);
+
+  EXPECT_EQ(CompileAndRun(&cache, js), 21);
+  EXPECT_EQ(cache.stats().rejected, 1u);
+
+  // The rejected entry was replaced so the next run is a hit.
+  EXPECT_EQ(CompileAndRun(&cache, js), 21);
+  EXPECT_EQ(cache.stats().hits, 1u);
+}
+
+// Functions that only ran after compiling are in the entry too.
+TEST_F(CodeCacheTest, CommitAfterRunHasLazyFunctions) {
+  const std::string js = LargeScript(100) + "let t = 0;"
+      "for (let i = 0; i < 100; i++) t += this['f' + i](2, 3); t";
+  long sizes[2];
+  for (int run = 0; run <= 1; run++) {
+    CodeCache cache(dir_ + "/" + std::to_string(run));
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      Local<String> source = String::NewFromUtf8(isolate, js.c_str()).ToLocalChecked();
+      Local<Script> script = cache.Compile(context, source,
+          String::NewFromUtf8Literal(isolate, "test.js")).ToLocalChecked();
+      if (run) {
+        script->Run(context).ToLocalChecked();
+      }
+      cache.Commit(script);
+
+      struct stat st;
+      ASSERT_EQ(0, stat(cache.PathFor(isolate, source).c_str(), &st));
+      sizes[run] = static_cast<long>(st.st_size);
+    }
+    isolate->Dispose();
+  }
+  std::cout << "entry before run: " << sizes[0] << " bytes, after run: "
+            << sizes[1] << " bytes\n";
+  EXPECT_GT(sizes[1], sizes[0]);
+}
+
+TEST_F(CodeCacheTest, ColdVsWarmStart) {
+  const std::string js = LargeScript(5000);
+  const int runs = 5;
+  CodeCache cache(dir_);
+  // Populate the cache.
+  CompileAndRun(&cache, js);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; i++) {
+    CompileAndRun(nullptr, js);
+  }
+  auto cold = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; i++) {
+    CompileAndRun(&cache, js);
+  }
+  auto warm = std::chrono::steady_clock::now() - start;
+
+  using ms = std::chrono::duration<double, std::milli>;
+  std::cout << "script size: " << js.size() << " bytes\n";
+  std::cout << "cold start: " << ms(cold).count() / runs << " ms\n";
+  std::cout << "warm start: " << ms(warm).count() / runs << " ms\n";
+  cache.PrintStats(stdout);
+  EXPECT_EQ(cache.stats().hits, static_cast<size_t>(runs));
+}
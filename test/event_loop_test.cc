@@ -0,0 +1,309 @@
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/event-loop.h"
+
+using namespace v8;
+
+class EventLoopTest : public V8TestFixture {
+ protected:
+  Local<Value> RunScript(Local<Context> context, const char* js) {
+    Local<String> source = String::NewFromUtf8(isolate_, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    return script->Run(context).ToLocalChecked();
+  }
+
+  std::string RunToString(Local<Context> context, const char* js) {
+    String::Utf8Value value(isolate_, RunScript(context, js));
+    return *value;
+  }
+
+  // A high resolution clock for the scripts, in milliseconds.
+  static void Now(const FunctionCallbackInfo<Value>& args) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    args.GetReturnValue().Set(ts.tv_sec * 1e3 + ts.tv_nsec / 1e6);
+  }
+
+  void InstallNow(Local<Context> context) {
+    context->Global()->Set(context, String::NewFromUtf8Literal(isolate_, "now"),
+        Function::New(context, Now).ToLocalChecked()).Check();
+  }
+};
+
+TEST_F(EventLoopTest, TimeoutOrder) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+
+  RunScript(context,
+      "var log = [];"
+      "setTimeout(() => log.push('c'), 20);"
+      "setTimeout(() => log.push('a'), 0);"
+      "setTimeout(() => log.push('b'), 10);"
+      "setTimeout(() => log.push('a2'));"
+      "log.push('main');");
+  EXPECT_EQ(4, loop.pending_timers());
+  loop.Run();
+  EXPECT_EQ(0, loop.pending_timers());
+  EXPECT_EQ("main,a,a2,b,c", RunToString(context, "log.join()"));
+}
+
+TEST_F(EventLoopTest, Arguments) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+
+  RunScript(context,
+      "var result;"
+      "setTimeout((a, b) => result = a + b, 1, 18, 24);");
+  loop.Run();
+  EXPECT_EQ("42", RunToString(context, "result"));
+}
+
+TEST_F(EventLoopTest, ClearTimeoutAndInterval) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+
+  RunScript(context,
+      "var log = [];"
+      "const t = setTimeout(() => log.push('cleared'), 5);"
+      "clearTimeout(t);"
+      "clearTimeout(12345);"
+      "let count = 0;"
+      "const i = setInterval(() => {"
+      "  log.push('interval' + (++count));"
+      "  if (count === 3) clearInterval(i);"
+      "}, 2);");
+  loop.Run();
+  EXPECT_EQ("interval1,interval2,interval3", RunToString(context, "log.join()"));
+}
+
+TEST_F(EventLoopTest, MicrotasksRunAfterEachMacrotask) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+
+  RunScript(context,
+      "var log = [];"
+      "setTimeout(() => {"
+      "  log.push('t1');"
+      "  Promise.resolve().then(() => log.push('m1'));"
+      "}, 0);"
+      "setTimeout(() => log.push('t2'), 0);"
+      "Promise.resolve().then(() => log.push('main microtask'));");
+  loop.Run();
+  EXPECT_EQ("main microtask,t1,m1,t2", RunToString(context, "log.join()"));
+}
+
+TEST_F(EventLoopTest, ExceptionInCallback) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+
+  RunScript(context,
+      "var done = false;"
+      "setTimeout(() => { throw new Error('from timer'); }, 0);"
+      "setTimeout(() => done = true, 1);");
+  loop.Run();
+  EXPECT_EQ("true", RunToString(context, "done"));
+
+  TryCatch try_catch(isolate_);
+  Local<String> source = String::NewFromUtf8Literal(isolate_, "setTimeout(1)");
+  EXPECT_TRUE(Script::Compile(context, source).ToLocalChecked()->Run(context).IsEmpty());
+  EXPECT_TRUE(try_catch.HasCaught());
+}
+
+// How late timers fire compared to their delay, measured from JavaScript.
+TEST_F(EventLoopTest, LatencyBenchmark) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+  InstallNow(context);
+
+  RunScript(context,
+      "var lateness = [];"
+      "function next(remaining) {"
+      "  if (remaining === 0) return;"
+      "  const delay = remaining % 5;"
+      "  const start = now();"
+      "  setTimeout(() => {"
+      "    lateness.push(now() - start - delay);"
+      "    next(remaining - 1);"
+      "  }, delay);"
+      "}"
+      "next(500);");
+  loop.Run();
+
+  Local<Array> array = RunScript(context, "lateness").As<Array>();
+  std::vector<double> values;
+  for (uint32_t i = 0; i < array->Length(); i++) {
+    values.push_back(array->Get(context, i).ToLocalChecked()
+        .As<Number>()->Value());
+  }
+  ASSERT_EQ(500, values.size());
+  std::sort(values.begin(), values.end());
+  // Timers must never fire early.
+  EXPECT_GE(values.front(), 0);
+
+  double sum = 0;
+  for (double value : values) {
+    sum += value;
+  }
+  double mean = sum / values.size();
+  double variance = 0;
+  for (double value : values) {
+    variance += (value - mean) * (value - mean);
+  }
+  std::cout << "timer lateness (ms): mean " << mean
+            << ", p50 " << values[values.size() / 2]
+            << ", p99 " << values[values.size() * 99 / 100]
+            << ", max " << values.back()
+            << ", jitter (stddev) " << std::sqrt(variance / values.size()) << '\n';
+}
+
+// setTimeout and clearTimeout should cost the same with 100k timers pending
+// as with none.
+TEST_F(EventLoopTest, SchedulingWithManyPendingTimers) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+  InstallNow(context);
+
+  Local<Value> result = RunScript(context,
+      "var ids = [];"
+      "function f() {}"
+      "function batch(n) {"
+      "  const start = now();"
+      "  for (let i = 0; i < n; i++) ids.push(setTimeout(f, 1000 + (i * 7919) % 3600000));"
+      "  return (now() - start) * 1e6 / n;"
+      "}"
+      "const first = batch(10000);"
+      "batch(80000);"
+      "const last = batch(10000);"
+      "const start = now();"
+      "for (const id of ids) clearTimeout(id);"
+      "[first, last, (now() - start) * 1e6 / ids.length];");
+  Local<Array> times = result.As<Array>();
+  auto at = [&](uint32_t i) {
+    return times->Get(context, i).ToLocalChecked().As<Number>()->Value();
+  };
+  std::cout << "setTimeout with 0 pending: " << at(0) << " ns, "
+            << "with 90k pending: " << at(1) << " ns, "
+            << "clearTimeout: " << at(2) << " ns\n";
+  EXPECT_EQ(0, loop.pending_timers());
+}
+
+class TimerWheelTest : public ::testing::Test {
+ protected:
+  struct Node : public TimerNode {
+    uint64_t due;
+  };
+};
+
+TEST_F(TimerWheelTest, FiresOnExactTickAcrossLevels) {
+  TimerWheel wheel(1000);
+  // Deltas that land in each of the levels, and on slot boundaries.
+  const uint64_t deltas[] = {1, 2, 255, 256, 257, 1000, 65535, 65536, 65537,
+                             300000, 16777216, 20000000};
+  std::vector<Node> nodes(sizeof(deltas) / sizeof(deltas[0]));
+  for (size_t i = 0; i < nodes.size(); i++) {
+    nodes[i].due = 1000 + deltas[i];
+    wheel.Schedule(&nodes[i], nodes[i].due);
+  }
+  EXPECT_EQ(nodes.size(), wheel.size());
+
+  size_t fired = 0;
+  uint64_t now = 1000;
+  while (wheel.size() > 0) {
+    // Jump as far as the wheel allows, like the event loop does.
+    now += wheel.NextTimeout();
+    wheel.Advance(now, [&](TimerNode* node) {
+      EXPECT_EQ(static_cast<Node*>(node)->due, wheel.now());
+      EXPECT_FALSE(node->IsScheduled());
+      fired++;
+    });
+  }
+  EXPECT_EQ(nodes.size(), fired);
+}
+
+TEST_F(TimerWheelTest, CancelAndReschedule) {
+  TimerWheel wheel;
+  Node a, b;
+  wheel.Schedule(&a, 10);
+  wheel.Schedule(&b, 20);
+  wheel.Cancel(&a);
+  EXPECT_FALSE(a.IsScheduled());
+  wheel.Schedule(&b, 5);
+  EXPECT_EQ(1, wheel.size());
+
+  std::vector<uint64_t> ticks;
+  wheel.Advance(100, [&](TimerNode* node) {
+    ticks.push_back(wheel.now());
+    // Rescheduling from the callback, like an interval does.
+    if (ticks.size() < 3) {
+      wheel.Schedule(node, wheel.now() + 7);
+    }
+  });
+  EXPECT_EQ((std::vector<uint64_t>{5, 12, 19}), ticks);
+  EXPECT_EQ(-1, wheel.NextTimeout());
+}
+
+TEST_F(TimerWheelTest, ScheduleCost) {
+  const int pending = 100000;
+  std::vector<Node> nodes(pending);
+  TimerWheel wheel;
+  auto schedule = [&](int from, int to) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = from; i < to; i++) {
+      wheel.Schedule(&nodes[i], 1 + (i * 7919u) % 3600000);
+    }
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (to - from);
+  };
+  double empty = schedule(0, 10000);
+  schedule(10000, 90000);
+  double full = schedule(90000, pending);
+  EXPECT_EQ(pending, wheel.size());
+
+  auto start = std::chrono::steady_clock::now();
+  for (Node& node : nodes) {
+    wheel.Cancel(&node);
+  }
+  std::chrono::duration<double, std::nano> cancel =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "TimerWheel::Schedule with 0 pending: " << empty << " ns, "
+            << "with 90k pending: " << full << " ns, "
+            << "Cancel: " << cancel.count() / pending << " ns\n";
+  EXPECT_EQ(0, wheel.size());
+}
@@ -1,7 +1,9 @@
+#include <chrono>
 #include <iostream>
 #include "gtest/gtest.h"
 #include "v8_test_fixture.h"
 #include "v8-fast-api-calls.h"
+#include "../src/fast-bindings.h"
 
 using namespace v8;
 
@@ -40,3 +42,69 @@ TEST_F(FastApiTest, Basic) {
   }
 }
 
+
+// Runs hot(n) after it has been optimized by TurboFan and returns the number
+// of iterations per second. Every iteration makes two API calls.
+static double RunHotLoop(Isolate* isolate, bool fast, bool* optimized) {
+  HandleScope handle_scope(isolate);
+  Local<ObjectTemplate> global = ObjectTemplate::New(isolate);
+  fast_bindings::Install(isolate, global, fast);
+  Local<Context> context = Context::New(isolate, nullptr, global);
+  Context::Scope context_scope(context);
+
+  const char* setup = R"(
+    function hot(n) {
+      let sum = 0;
+      for (let i = 0; i < n; i++) {
+        setAge(i);
+        sum += getAge();
+      }
+      return sum;
+    }
+    %PrepareFunctionForOptimization(hot);
+    hot(10);
+    %OptimizeFunctionOnNextCall(hot);
+    hot(10);
+    // Bit 4 (value 16) of the status means the function is optimized by
+    // TurboFan.
+    (%GetOptimizationStatus(hot) & 16) != 0;)";
+  Local<Script> script = Script::Compile(context,
+      String::NewFromUtf8(isolate, setup).ToLocalChecked()).ToLocalChecked();
+  *optimized = script->Run(context).ToLocalChecked()->IsTrue();
+
+  const int iterations = 10000000;
+  fast_bindings::call_counts() = fast_bindings::CallCounts();
+  Local<Function> hot = Local<Function>::Cast(context->Global()->Get(context,
+      String::NewFromUtf8Literal(isolate, "hot")).ToLocalChecked());
+  Local<Value> args[1] = {Number::New(isolate, iterations)};
+  auto start = std::chrono::steady_clock::now();
+  hot->Call(context, context->Global(), 1, args).ToLocalChecked();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return 2 * iterations / elapsed.count();
+}
+
+TEST_F(FastApiTest, FastBindingsBenchmark) {
+  const char* flags = "--allow-natives-syntax --turbo-fast-api-calls";
+  V8::SetFlagsFromString(flags);
+  Isolate::Scope isolate_scope(isolate_);
+
+  bool optimized;
+  double slow_calls_per_sec = RunHotLoop(isolate_, false, &optimized);
+  fast_bindings::CallCounts slow_counts = fast_bindings::call_counts();
+  std::cout << "slow path: " << slow_calls_per_sec << " calls/sec"
+            << ", optimized: " << optimized
+            << ", fast calls: " << slow_counts.fast
+            << ", slow calls: " << slow_counts.slow << '\n';
+  EXPECT_EQ(slow_counts.fast, 0u);
+
+  double fast_calls_per_sec = RunHotLoop(isolate_, true, &optimized);
+  fast_bindings::CallCounts fast_counts = fast_bindings::call_counts();
+  std::cout << "fast path: " << fast_calls_per_sec << " calls/sec"
+            << ", optimized: " << optimized
+            << ", fast calls: " << fast_counts.fast
+            << ", slow calls: " << fast_counts.slow << '\n';
+  std::cout << "fast path taken after tier-up: "
+            << (fast_counts.fast > 0 ? "yes" : "no") << '\n';
+  EXPECT_TRUE(optimized);
+  EXPECT_GT(fast_counts.fast, 0u);
+}
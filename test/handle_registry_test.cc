@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/handle-registry.h"
+#include "../src/histogram.h"
+
+using namespace v8;
+
+class HandleRegistryTest : public V8TestFixture {
+};
+
+struct Native {
+  int value;
+};
+
+static void DeleteNative(void* native, void* data) {
+  delete static_cast<Native*>(native);
+  (*static_cast<int*>(data))++;
+}
+
+TEST_F(HandleRegistryTest, BatchedWeakProcessing) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  int finalized = 0;
+  HandleRegistry registry(isolate_, DeleteNative, &finalized);
+
+  std::vector<HandleRegistry::Id> ids;
+  {
+    HandleScope scope(isolate_);
+    for (int i = 0; i < 100; i++) {
+      ids.push_back(registry.Add(Object::New(isolate_), new Native{i}));
+      if (i % 2 == 0) {
+        registry.MakeWeak(ids.back());
+      }
+    }
+  }
+  EXPECT_EQ(50u, registry.counts().strong);
+  EXPECT_EQ(50u, registry.counts().weak);
+  // No garbage collection yet, nothing to do.
+  EXPECT_EQ(0u, registry.ProcessWeak());
+
+  isolate_->LowMemoryNotification();
+  EXPECT_EQ(0, finalized);
+  EXPECT_TRUE(registry.Get(ids[0]).IsEmpty());
+  EXPECT_FALSE(registry.Get(ids[1]).IsEmpty());
+  EXPECT_EQ(1, static_cast<Native*>(registry.native(ids[1]))->value);
+
+  EXPECT_EQ(10u, registry.ProcessWeak(10));
+  EXPECT_EQ(10, finalized);
+  EXPECT_EQ(40u, registry.counts().pending);
+  EXPECT_EQ(0u, registry.counts().weak);
+  EXPECT_EQ(40u, registry.ProcessWeak());
+  EXPECT_EQ(50, finalized);
+  EXPECT_EQ(0u, registry.counts().pending);
+
+  // Strong again before it is collected.
+  registry.MakeWeak(ids[1]);
+  EXPECT_TRUE(registry.ClearWeak(ids[1]));
+  isolate_->LowMemoryNotification();
+  EXPECT_EQ(0u, registry.ProcessWeak());
+  EXPECT_EQ(50u, registry.counts().strong);
+
+  // Freed slots are reused.
+  size_t capacity = registry.capacity();
+  Native* removed = static_cast<Native*>(registry.native(ids[1]));
+  registry.Remove(ids[1]);
+  delete removed;
+  EXPECT_EQ(49u, registry.counts().strong);
+  EXPECT_EQ(ids[1], registry.Add(Object::New(isolate_), new Native{1}));
+  EXPECT_EQ(capacity, registry.capacity());
+
+  for (size_t i = 1; i < ids.size(); i += 2) {
+    delete static_cast<Native*>(registry.native(ids[i]));
+  }
+}
+
+// Records garbage collection pauses by type.
+struct GcPauses {
+  Histogram scavenges;
+  Histogram mark_compacts;
+  std::chrono::steady_clock::time_point start;
+
+  static void OnPrologue(Isolate* isolate, GCType type, GCCallbackFlags flags,
+                         void* data) {
+    static_cast<GcPauses*>(data)->start = std::chrono::steady_clock::now();
+  }
+
+  static void OnEpilogue(Isolate* isolate, GCType type, GCCallbackFlags flags,
+                         void* data) {
+    GcPauses* pauses = static_cast<GcPauses*>(data);
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - pauses->start).count();
+    if (type == kGCTypeScavenge) {
+      pauses->scavenges.Record(us);
+    } else if (type == kGCTypeMarkSweepCompact) {
+      pauses->mark_compacts.Record(us);
+    }
+  }
+
+  void Print(const char* label) {
+    std::cout << label << ": scavenge " << scavenges.count() << " pauses, p50 "
+              << scavenges.Percentile(50) << " us, max " << scavenges.max()
+              << " us; mark-compact " << mark_compacts.count()
+              << " pauses, p50 " << mark_compacts.Percentile(50) << " us, max "
+              << mark_compacts.max() << " us\n";
+  }
+};
+
+struct PersistentWrapper {
+  Persistent<Object> handle;
+  Native native;
+};
+
+static int persistent_finalized = 0;
+
+static void PersistentWeakCallback(
+    const WeakCallbackInfo<PersistentWrapper>& info) {
+  PersistentWrapper* wrapper = info.GetParameter();
+  wrapper->handle.Reset();
+  delete wrapper;
+  persistent_finalized++;
+}
+
+// Makes a million wrappers (or HANDLE_REGISTRY_BENCHMARK_WRAPPERS), all
+// weak and kept alive from JavaScript by an array, which is then dropped,
+// once with a Persistent and weak callback each and once in a registry.
+// Reports the garbage collection pauses along the way.
+TEST_F(HandleRegistryTest, PauseBenchmark) {
+  int wrappers = 1000000;
+  if (const char* env = getenv("HANDLE_REGISTRY_BENCHMARK_WRAPPERS")) {
+    wrappers = atoi(env);
+  }
+  using ms = std::chrono::duration<double, std::milli>;
+
+  for (int registered = 0; registered <= 1; registered++) {
+    Isolate* isolate = Isolate::New(create_params_);
+    GcPauses pauses;
+    isolate->AddGCPrologueCallback(GcPauses::OnPrologue, &pauses);
+    isolate->AddGCEpilogueCallback(GcPauses::OnEpilogue, &pauses);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      int finalized = 0;
+      HandleRegistry registry(isolate, DeleteNative, &finalized);
+      persistent_finalized = 0;
+
+      auto start = std::chrono::steady_clock::now();
+      Global<Array> keep(isolate, Array::New(isolate, wrappers));
+      for (int i = 0; i < wrappers;) {
+        HandleScope scope(isolate);
+        Local<Array> array = keep.Get(isolate);
+        for (int end = std::min(i + 1024, wrappers); i < end; i++) {
+          Local<Object> object = Object::New(isolate);
+          array->Set(context, i, object).Check();
+          if (registered) {
+            registry.MakeWeak(registry.Add(object, new Native{i}));
+          } else {
+            PersistentWrapper* wrapper = new PersistentWrapper;
+            wrapper->native.value = i;
+            wrapper->handle.Reset(isolate, object);
+            wrapper->handle.SetWeak(wrapper, PersistentWeakCallback,
+                                    WeakCallbackType::kParameter);
+          }
+        }
+      }
+      auto created = std::chrono::steady_clock::now();
+      // With every wrapper alive, and with every one dead.
+      isolate->LowMemoryNotification();
+      keep.Reset();
+      isolate->LowMemoryNotification();
+      auto collected = std::chrono::steady_clock::now();
+      size_t processed = registry.ProcessWeak();
+      auto processed_at = std::chrono::steady_clock::now();
+
+      pauses.Print(registered ? "registry  " : "persistent");
+      std::cout << "  create " << ms(created - start).count()
+                << " ms, collect " << ms(collected - created).count() << " ms";
+      if (registered) {
+        std::cout << ", ProcessWeak " << ms(processed_at - collected).count()
+                  << " ms";
+        EXPECT_EQ(static_cast<size_t>(wrappers), processed);
+        EXPECT_EQ(wrappers, finalized);
+        EXPECT_EQ(0u, registry.counts().weak);
+        EXPECT_EQ(0u, registry.counts().pending);
+      } else {
+        EXPECT_EQ(wrappers, persistent_finalized);
+      }
+      std::cout << '\n';
+    }
+    isolate->Dispose();
+  }
+}
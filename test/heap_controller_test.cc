@@ -0,0 +1,104 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/heap-controller.h"
+
+using namespace v8;
+
+class HeapControllerTest : public V8TestFixture {
+ protected:
+  // An isolate whose heap is sized by options.
+  Isolate* NewIsolate(const HeapController::Options& options) {
+    Isolate::CreateParams params;
+    params.array_buffer_allocator = allocator_.get();
+    HeapController::Configure(&params, options);
+    return Isolate::New(params);
+  }
+
+  MaybeLocal<Value> Run(Isolate* isolate, Local<Context> context,
+                        const char* js) {
+    Local<String> source = String::NewFromUtf8(isolate, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    return script->Run(context);
+  }
+
+  HeapController::Options SmallBudget() {
+    HeapController::Options options;
+    options.initial_limit = 16 << 20;
+    options.max_limit = 48 << 20;
+    options.extension = 8 << 20;
+    options.shrink_after = 3;
+    options.log = stdout;
+    return options;
+  }
+};
+
+TEST_F(HeapControllerTest, TerminatesOverBudget) {
+  HeapController::Options options = SmallBudget();
+  Isolate* isolate = NewIsolate(options);
+  {
+    Isolate::Scope isolate_scope(isolate);
+    HandleScope handle_scope(isolate);
+    Local<Context> context = Context::New(isolate);
+    Context::Scope context_scope(context);
+    HeapController controller(isolate, options);
+
+    TryCatch try_catch(isolate);
+    EXPECT_TRUE(Run(isolate, context,
+        "var leak = [];"
+        "while (true) leak.push(new Array(1000).fill(leak.length));").IsEmpty());
+    EXPECT_TRUE(try_catch.HasTerminated());
+    EXPECT_GE(controller.stats().extensions, 1u);
+    EXPECT_EQ(1u, controller.stats().terminations);
+    EXPECT_LE(controller.limit(),
+              options.max_limit + options.max_termination_headroom);
+
+    // The process, and the isolate, are still there.
+    EXPECT_TRUE(controller.TakeTermination());
+    EXPECT_FALSE(controller.TakeTermination());
+    try_catch.Reset();
+    Local<Value> result;
+    ASSERT_TRUE(Run(isolate, context, "leak = null; 'ok'").ToLocal(&result));
+    EXPECT_EQ("ok", std::string(*String::Utf8Value(isolate, result)));
+  }
+  isolate->Dispose();
+}
+
+TEST_F(HeapControllerTest, ExtendsWithinBudgetAndShrinks) {
+  HeapController::Options options = SmallBudget();
+  Isolate* isolate = NewIsolate(options);
+  {
+    Isolate::Scope isolate_scope(isolate);
+    HandleScope handle_scope(isolate);
+    Local<Context> context = Context::New(isolate);
+    Context::Scope context_scope(context);
+    HeapController controller(isolate, options);
+
+    // More than the initial limit, less than the budget.
+    ASSERT_FALSE(Run(isolate, context,
+        "var data = [];"
+        "for (let i = 0; i < 6000; i++) data.push(new Array(1000).fill(i));"
+        "data.length").IsEmpty());
+    EXPECT_GE(controller.stats().extensions, 1u);
+    EXPECT_EQ(0u, controller.stats().terminations);
+    size_t extended = controller.limit();
+    EXPECT_GT(extended, 0u);
+
+    // Still in use.
+    for (int i = 0; i < options.shrink_after; i++) {
+      EXPECT_FALSE(controller.Sample());
+    }
+
+    Run(isolate, context, "data = null").ToLocalChecked();
+    isolate->LowMemoryNotification();
+    for (int i = 1; i < options.shrink_after; i++) {
+      EXPECT_FALSE(controller.Sample());
+    }
+    EXPECT_TRUE(controller.Sample());
+    EXPECT_EQ(1u, controller.stats().shrinks);
+    EXPECT_LT(controller.limit(), extended);
+  }
+  isolate->Dispose();
+}
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/idle-gc-scheduler.h"
+#include "../src/work-stealing-platform.h"
+
+using namespace v8;
+
+class IdleGcTest : public V8TestFixture {
+ protected:
+  Local<Value> RunScript(Local<Context> context, const char* js) {
+    Local<String> source = String::NewFromUtf8(isolate_, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    return script->Run(context).ToLocalChecked();
+  }
+};
+
+class IdleDeadlineTask : public IdleTask {
+ public:
+  explicit IdleDeadlineTask(std::vector<double>* deadlines)
+      : deadlines_(deadlines) {}
+  void Run(double deadline_in_seconds) override {
+    deadlines_->push_back(deadline_in_seconds);
+  }
+
+ private:
+  std::vector<double>* deadlines_;
+};
+
+TEST_F(IdleGcTest, PlatformRunsIdleTasks) {
+  WorkStealingPlatform platform(1);
+  // Only for isolates that run them.
+  EXPECT_FALSE(platform.IdleTasksEnabled(isolate_));
+  std::shared_ptr<TaskRunner> runner = platform.GetForegroundTaskRunner(isolate_);
+  EXPECT_FALSE(runner->IdleTasksEnabled());
+  SetPlatformIdleTasksEnabled(&platform, isolate_, true);
+  EXPECT_TRUE(platform.IdleTasksEnabled(isolate_));
+  EXPECT_TRUE(runner->IdleTasksEnabled());
+
+  std::vector<double> deadlines;
+  runner->PostIdleTask(std::unique_ptr<IdleTask>(new IdleDeadlineTask(&deadlines)));
+  runner->PostIdleTask(std::unique_ptr<IdleTask>(new IdleDeadlineTask(&deadlines)));
+  // Idle tasks are not run by the message loop, only when there is idle time.
+  EXPECT_FALSE(PumpPlatformMessageLoop(&platform, isolate_));
+  EXPECT_EQ(0, deadlines.size());
+
+  double before = platform.MonotonicallyIncreasingTime();
+  RunPlatformIdleTasks(&platform, isolate_, 0.05);
+  ASSERT_EQ(2, deadlines.size());
+  EXPECT_GE(deadlines[0], before + 0.05);
+  EXPECT_LE(deadlines[0], platform.MonotonicallyIncreasingTime() + 0.05);
+  EXPECT_EQ(deadlines[0], deadlines[1]);
+  NotifyPlatformIsolateShutdown(&platform, isolate_);
+}
+
+TEST_F(IdleGcTest, SchedulerEnablesIdleTasks) {
+  WorkStealingPlatform platform(1);
+  {
+    IdleGcScheduler scheduler(isolate_, &platform);
+    EXPECT_TRUE(platform.IdleTasksEnabled(isolate_));
+  }
+  EXPECT_FALSE(platform.IdleTasksEnabled(isolate_));
+  NotifyPlatformIsolateShutdown(&platform, isolate_);
+}
+
+TEST_F(IdleGcTest, BudgetFromGaps) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  IdleGcScheduler scheduler(isolate_, platform_.get());
+
+  // Nothing is known about the gaps yet.
+  EXPECT_FALSE(scheduler.OnIdle());
+  EXPECT_EQ(0, scheduler.stats().idle_periods);
+  // Too short to be worth it.
+  EXPECT_FALSE(scheduler.OnIdle(0.5));
+  EXPECT_TRUE(scheduler.OnIdle(5));
+  EXPECT_EQ(1, scheduler.stats().idle_periods);
+
+  for (int i = 0; i < 3; i++) {
+    scheduler.JobStarted();
+    scheduler.JobFinished();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  scheduler.JobStarted();
+  EXPECT_GE(scheduler.average_gap_ms(), 19);
+  scheduler.JobFinished();
+  EXPECT_TRUE(scheduler.OnIdle());
+  EXPECT_EQ(2, scheduler.stats().idle_periods);
+  // The budget is capped at max_budget_ms.
+  EXPECT_LT(scheduler.stats().idle_ms, 5 + 10 + 10);
+}
+
+TEST_F(IdleGcTest, SignalsMemoryPressure) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  IdleGcScheduler::Options options;
+  options.moderate_pressure = 0;
+  options.critical_pressure = 2;
+  IdleGcScheduler scheduler(isolate_, platform_.get(), options);
+
+  EXPECT_TRUE(scheduler.OnIdle(2));
+  EXPECT_EQ(1, scheduler.stats().pressure_notifications);
+  // Only changes of the level are signaled.
+  EXPECT_TRUE(scheduler.OnIdle(2));
+  EXPECT_EQ(1, scheduler.stats().pressure_notifications);
+}
+
+class RequestLoop {
+ public:
+  RequestLoop(Isolate* isolate, Local<Context> context)
+      : isolate_(isolate), context_(context) {
+    isolate_->AddGCPrologueCallback(OnGC, this);
+  }
+
+  ~RequestLoop() {
+    isolate_->RemoveGCPrologueCallback(OnGC, this);
+  }
+
+  // Runs requests with a gap between them, like a server that is not fully
+  // loaded, and records how long each request took and how many garbage
+  // collections happened while a request was running.
+  void Run(int requests, int gap_ms, IdleGcScheduler* scheduler) {
+    Local<String> source = String::NewFromUtf8Literal(isolate_,
+        "var retained = retained || [];"
+        "(function() {"
+        "  var garbage = [];"
+        "  for (var i = 0; i < 20000; i++) {"
+        "    garbage.push({ index: i, name: 'item' + i, values: [i, i + 1] });"
+        "  }"
+        "  retained.push(garbage.slice(0, 2000));"
+        "  if (retained.length > 50) retained.shift();"
+        "  return garbage.length;"
+        "})()");
+    Local<Script> script = Script::Compile(context_, source).ToLocalChecked();
+    for (int i = 0; i < requests; i++) {
+      HandleScope handle_scope(isolate_);
+      if (scheduler != nullptr) {
+        scheduler->JobStarted();
+      }
+      auto start = std::chrono::steady_clock::now();
+      in_request_ = true;
+      script->Run(context_).ToLocalChecked();
+      in_request_ = false;
+      latencies_.push_back(std::chrono::duration<double, std::micro>(
+          std::chrono::steady_clock::now() - start).count());
+      auto idle_until = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(gap_ms);
+      if (scheduler != nullptr) {
+        scheduler->JobFinished();
+        scheduler->OnIdle();
+      }
+      std::this_thread::sleep_until(idle_until);
+    }
+  }
+
+  void Print(const char* name) {
+    std::sort(latencies_.begin(), latencies_.end());
+    size_t n = latencies_.size();
+    std::cout << name << ": p50 " << latencies_[n / 2]
+              << "us, p99 " << latencies_[n * 99 / 100]
+              << "us, max " << latencies_[n - 1]
+              << "us, GCs during requests " << gcs_in_request_
+              << ", GCs while idle " << gcs_idle_ << '\n';
+  }
+
+  double p99() const { return latencies_[latencies_.size() * 99 / 100]; }
+  int gcs_in_request() const { return gcs_in_request_; }
+
+ private:
+  static void OnGC(Isolate* isolate, GCType type, GCCallbackFlags flags,
+                   void* data) {
+    RequestLoop* loop = static_cast<RequestLoop*>(data);
+    if (loop->in_request_) {
+      loop->gcs_in_request_++;
+    } else {
+      loop->gcs_idle_++;
+    }
+  }
+
+  Isolate* isolate_;
+  Local<Context> context_;
+  bool in_request_ = false;
+  int gcs_in_request_ = 0;
+  int gcs_idle_ = 0;
+  std::vector<double> latencies_;
+};
+
+TEST_F(IdleGcTest, RequestLatencyBenchmark) {
+  const int requests = 300;
+  const int gap_ms = 10;
+  double p99[2];
+  int gcs[2];
+  for (int with_scheduler = 0; with_scheduler < 2; with_scheduler++) {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      const HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      IdleGcScheduler scheduler(isolate, platform_.get());
+      RequestLoop loop(isolate, context);
+      loop.Run(requests, gap_ms, with_scheduler ? &scheduler : nullptr);
+      loop.Print(with_scheduler ? "with idle GC   " : "without idle GC");
+      if (with_scheduler) {
+        std::cout << "idle periods " << scheduler.stats().idle_periods
+                  << ", idle time used " << scheduler.stats().idle_ms << "ms\n";
+        EXPECT_EQ(requests - 1, scheduler.stats().idle_periods);
+      }
+      p99[with_scheduler] = loop.p99();
+      gcs[with_scheduler] = loop.gcs_in_request();
+    }
+    NotifyPlatformIsolateShutdown(platform_.get(), isolate);
+    isolate->Dispose();
+  }
+  std::cout << "p99 " << p99[0] << "us -> " << p99[1] << "us\n";
+  // Most of the collections should have moved out of the requests.
+  EXPECT_LT(gcs[1], gcs[0]);
+}
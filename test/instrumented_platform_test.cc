@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/instrumented-platform.h"
+#include "../src/work-stealing-platform.h"
+
+using namespace v8;
+
+class InstrumentedPlatformTest : public V8TestFixture {
+ protected:
+  class SpinTask : public Task {
+   public:
+    SpinTask(std::atomic<int>* done, int iterations)
+        : done_(done), iterations_(iterations) {}
+    void Run() override {
+      volatile int sink = 0;
+      for (int i = 0; i < iterations_; i++) {
+        sink += i;
+      }
+      done_->fetch_add(1);
+    }
+
+   private:
+    std::atomic<int>* done_;
+    int iterations_;
+  };
+
+  class OtherTask : public Task {
+   public:
+    explicit OtherTask(std::atomic<int>* done) : done_(done) {}
+    void Run() override { done_->fetch_add(1); }
+
+   private:
+    std::atomic<int>* done_;
+  };
+
+  static void WaitFor(std::atomic<int>* done, int expected) {
+    while (done->load() < expected) {
+      std::this_thread::yield();
+    }
+  }
+};
+
+TEST_F(InstrumentedPlatformTest, Histogram) {
+  Histogram histogram;
+  EXPECT_EQ(0, histogram.Percentile(99));
+  for (uint64_t i = 1; i <= 1000; i++) {
+    histogram.Record(i);
+  }
+  EXPECT_EQ(1000, histogram.count());
+  EXPECT_EQ(1000, histogram.max());
+  EXPECT_DOUBLE_EQ(500.5, histogram.mean());
+  // Buckets are 12.5% wide.
+  EXPECT_NEAR(500, histogram.Percentile(50), 500 * 0.125);
+  EXPECT_NEAR(990, histogram.Percentile(99), 990 * 0.125);
+  EXPECT_EQ(1000, histogram.Percentile(100));
+  for (uint64_t value : {0ULL, 7ULL, 8ULL, 100ULL, 12345678ULL}) {
+    EXPECT_GE(Histogram::BucketUpperBound(Histogram::BucketIndex(value)), value);
+  }
+}
+
+TEST_F(InstrumentedPlatformTest, RecordsPerPriorityKindAndType) {
+  InstrumentedPlatform platform(
+      std::unique_ptr<Platform>(new WorkStealingPlatform(2)));
+  std::atomic<int> done{0};
+  for (int i = 0; i < 10; i++) {
+    platform.CallOnWorkerThread(std::make_unique<SpinTask>(&done, 1000));
+  }
+  for (int i = 0; i < 5; i++) {
+    platform.CallBlockingTaskOnWorkerThread(std::make_unique<OtherTask>(&done));
+  }
+  platform.CallLowPriorityTaskOnWorkerThread(std::make_unique<OtherTask>(&done));
+  platform.CallDelayedOnWorkerThread(std::make_unique<OtherTask>(&done), 0.01);
+  WaitFor(&done, 17);
+
+  std::shared_ptr<TaskRunner> runner = platform.GetForegroundTaskRunner(isolate_);
+  runner->PostTask(std::make_unique<OtherTask>(&done));
+  EXPECT_TRUE(PumpPlatformMessageLoop(&platform, isolate_));
+
+  EXPECT_EQ(10, platform.stats(TaskPriority::kUserVisible).run.count());
+  EXPECT_EQ(5, platform.stats(TaskPriority::kUserBlocking).run.count());
+  EXPECT_EQ(1, platform.stats(TaskPriority::kBestEffort).run.count());
+  EXPECT_EQ(16, platform.stats(InstrumentedPlatform::kWorker).wait.count());
+  EXPECT_EQ(1, platform.stats(InstrumentedPlatform::kDelayedWorker).lateness.count());
+  EXPECT_GE(platform.stats(InstrumentedPlatform::kDelayedWorker).wait.max(), 10000000);
+  EXPECT_EQ(1, platform.stats(InstrumentedPlatform::kForeground).run.count());
+  EXPECT_EQ(0, platform.stats(InstrumentedPlatform::kForeground).lateness.count());
+  NotifyPlatformIsolateShutdown(&platform, isolate_);
+
+  // SpinTask and OtherTask, named or not depending on the symbols.
+  EXPECT_EQ(2, platform.type_stats().size());
+
+  char path[] = "/tmp/instrumented_platform_test_XXXXXX";
+  int fd = mkstemp(path);
+  FILE* file = fdopen(fd, "w+");
+  platform.Dump(file);
+  rewind(file);
+  char line[256];
+  int lines = 0;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    lines++;
+  }
+  fclose(file);
+  unlink(path);
+  // The header and a wait and run line for each of the 3 priorities, 3
+  // kinds and 2 types, plus the lateness lines for the delayed task.
+  EXPECT_EQ(1 + 2 * (3 + 3 + 2) + 2, lines);
+}
+
+TEST_F(InstrumentedPlatformTest, PeriodicDump) {
+  InstrumentedPlatform platform(
+      std::unique_ptr<Platform>(new WorkStealingPlatform(1)));
+  std::atomic<int> done{0};
+  platform.CallOnWorkerThread(std::make_unique<OtherTask>(&done));
+  WaitFor(&done, 1);
+  char path[] = "/tmp/instrumented_platform_test_XXXXXX";
+  int fd = mkstemp(path);
+  FILE* file = fdopen(fd, "w+");
+  platform.StartPeriodicDump(file, std::chrono::milliseconds(10));
+  std::this_thread::sleep_for(std::chrono::milliseconds(55));
+  platform.StopPeriodicDump();
+  rewind(file);
+  char line[256];
+  int headers = 0;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    headers += strncmp(line, "group", 5) == 0;
+  }
+  fclose(file);
+  unlink(path);
+  EXPECT_GE(headers, 3);
+}
+
+// The same workload on the same platform with and without instrumentation.
+// The tasks are about 20us, which is short for a GC or compile task. Each
+// side is run several times, interleaved, and the fastest run counts, which
+// takes out most of the noise; the overhead has to stay under 1% with 2
+// points of tolerance for what is left.
+TEST_F(InstrumentedPlatformTest, Overhead) {
+  const int tasks = 50000;
+  const int rounds = 5;
+  auto run = [tasks](Platform* platform) {
+    std::atomic<int> done{0};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < tasks; i++) {
+      platform->CallOnWorkerThread(std::make_unique<SpinTask>(&done, 20000));
+    }
+    WaitFor(&done, tasks);
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+  };
+
+  WorkStealingPlatform plain(4);
+  InstrumentedPlatform instrumented(
+      std::unique_ptr<Platform>(new WorkStealingPlatform(4)));
+  run(&plain);
+  run(&instrumented);
+  double plain_ms = 0;
+  double instrumented_ms = 0;
+  for (int i = 0; i < rounds; i++) {
+    double ms = run(&plain);
+    plain_ms = i == 0 ? ms : std::min(plain_ms, ms);
+    ms = run(&instrumented);
+    instrumented_ms = i == 0 ? ms : std::min(instrumented_ms, ms);
+  }
+  instrumented.Dump(stdout);
+  double overhead = (instrumented_ms - plain_ms) / plain_ms * 100;
+  std::cout << tasks << " tasks: " << plain_ms << " ms plain, "
+            << instrumented_ms << " ms instrumented, overhead "
+            << overhead << "%\n";
+  EXPECT_LT(overhead, 1.0 + 2.0);
+}
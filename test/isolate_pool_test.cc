@@ -0,0 +1,62 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/isolate-pool.h"
+
+using namespace v8;
+
+class IsolatePoolTest : public V8TestFixture {
+};
+
+TEST_F(IsolatePoolTest, RunsScripts) {
+  IsolatePool pool(platform_.get(), 2);
+  std::future<ScriptResult> person = pool.Submit(
+      "var p = new Person('Fletch'); p.name;");
+  std::future<ScriptResult> sum = pool.Submit("18 + 2");
+  std::future<ScriptResult> error = pool.Submit("throw new Error('bajja')");
+
+  ScriptResult r = person.get();
+  EXPECT_TRUE(r.success);
+  EXPECT_EQ(r.value, "Fletch");
+  r = sum.get();
+  EXPECT_TRUE(r.success);
+  EXPECT_EQ(r.value, "20");
+  r = error.get();
+  EXPECT_FALSE(r.success);
+  EXPECT_EQ(r.value, "Error: bajja");
+}
+
+TEST_F(IsolatePoolTest, Throughput) {
+  // Jobs on the same worker share its context, so the script must not
+  // declare anything at the top level.
+  const char* js = R"(
+    (function() {
+      let sum = 0;
+      for (let i = 0; i < 10000; i++) {
+        sum += new Person('p' + i).name.length;
+      }
+      return sum;
+    })();)";
+  const int jobs = 2000;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    IsolatePool pool(platform_.get(), threads);
+    std::vector<std::future<ScriptResult>> results;
+    results.reserve(jobs);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < jobs; i++) {
+      results.push_back(pool.Submit(js));
+    }
+    for (std::future<ScriptResult>& result : results) {
+      ScriptResult r = result.get();
+      EXPECT_TRUE(r.success) << r.value;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "threads: " << threads << ", scripts/sec: "
+              << jobs / elapsed.count() << '\n';
+  }
+}
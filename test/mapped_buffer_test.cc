@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/mapped-buffer.h"
+#include "../src/memory-usage.h"
+
+using namespace v8;
+
+class MappedBufferTest : public V8TestFixture {
+ protected:
+  std::string WriteTempFile(const std::string& content) {
+    char tmpl[] = "/tmp/mapped_buffer_test_XXXXXX";
+    int fd = mkstemp(tmpl);
+    EXPECT_NE(fd, -1);
+    size_t written = 0;
+    while (written < content.size()) {
+      ssize_t n = write(fd, content.data() + written, content.size() - written);
+      EXPECT_GT(n, 0);
+      written += static_cast<size_t>(n);
+    }
+    close(fd);
+    return tmpl;
+  }
+
+  std::string ReadWholeFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+  }
+
+  // Whether path is mapped into this process.
+  bool IsMapped(const std::string& path) {
+    return ReadWholeFile("/proc/self/maps").find(path) != std::string::npos;
+  }
+
+  std::string RunToString(Local<Context> context, const char* js) {
+    Local<String> source = String::NewFromUtf8(isolate_, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    String::Utf8Value value(isolate_, script->Run(context).ToLocalChecked());
+    return *value;
+  }
+};
+
+TEST_F(MappedBufferTest, ReadOnly) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  std::string path = WriteTempFile("bajja");
+
+  Local<Uint8Array> array = Uint8ArrayFromFile(isolate_, path.c_str()).ToLocalChecked();
+  EXPECT_EQ(5u, array->Length());
+  EXPECT_TRUE(IsMapped(path));
+  context->Global()->Set(context, String::NewFromUtf8Literal(isolate_, "file"),
+                         array).Check();
+  EXPECT_EQ("bajja", RunToString(context, "String.fromCharCode(...file)"));
+
+  // Detaching drops the last reference to the backing store, and its
+  // deleter unmaps the file.
+  array->Buffer()->Detach();
+  EXPECT_FALSE(IsMapped(path));
+  unlink(path.c_str());
+}
+
+TEST_F(MappedBufferTest, CopyOnWrite) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  std::string path = WriteTempFile("bajja");
+
+  Local<ArrayBuffer> buffer = ArrayBufferFromFile(isolate_, path.c_str(),
+      MappedFile::kCopyOnWrite, MappedFile::kRandom).ToLocalChecked();
+  context->Global()->Set(context, String::NewFromUtf8Literal(isolate_, "buffer"),
+                         buffer).Check();
+  EXPECT_EQ("Bajja", RunToString(context,
+      "var bytes = new Uint8Array(buffer);"
+      "bytes[0] = 'B'.charCodeAt(0);"
+      "String.fromCharCode(...bytes)"));
+  // The file itself is unchanged.
+  EXPECT_EQ("bajja", ReadWholeFile(path));
+  unlink(path.c_str());
+}
+
+TEST_F(MappedBufferTest, EmptyAndMissing) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  std::string path = WriteTempFile("");
+  EXPECT_EQ(0u, ArrayBufferFromFile(isolate_, path.c_str())
+                    .ToLocalChecked()->ByteLength());
+  EXPECT_EQ(0u, Uint8ArrayFromFile(isolate_, path.c_str())
+                    .ToLocalChecked()->Length());
+  unlink(path.c_str());
+  EXPECT_TRUE(ArrayBufferFromFile(isolate_, "/nonexistent/file").IsEmpty());
+}
+
+// Hands a file to JavaScript as a Uint8Array, mapped and read into a new
+// ArrayBuffer, and sums one byte of every page from JavaScript. The file is
+// 64MB, small enough for every test run; MAPPED_BUFFER_BENCHMARK_MB sets
+// another size, 2048 for example to see the difference at 2GB.
+TEST_F(MappedBufferTest, Benchmark) {
+  size_t megabytes = 64;
+  if (const char* env = getenv("MAPPED_BUFFER_BENCHMARK_MB")) {
+    megabytes = strtoul(env, nullptr, 10);
+  }
+  const size_t size = megabytes << 20;
+  char tmpl[] = "/tmp/mapped_buffer_benchmark_XXXXXX";
+  int fd = mkstemp(tmpl);
+  ASSERT_NE(fd, -1);
+  std::string path = tmpl;
+  {
+    std::vector<char> chunk(1 << 20);
+    for (size_t i = 0; i < chunk.size(); i++) {
+      chunk[i] = static_cast<char>(i * 31);
+    }
+    for (size_t written = 0; written < size; written += chunk.size()) {
+      ASSERT_EQ(static_cast<ssize_t>(chunk.size()),
+                write(fd, chunk.data(), chunk.size()));
+    }
+    close(fd);
+  }
+
+  const char* sum_pages =
+      "(function() {"
+      "  let sum = 0;"
+      "  for (let i = 0; i < file.length; i += 4096) {"
+      "    sum += file[i];"
+      "  }"
+      "  return sum;"
+      "})()";
+
+  using ms = std::chrono::duration<double, std::milli>;
+  std::string expected;
+  auto run = [&](const char* label, MaybeLocal<Uint8Array> (*open)(Isolate*, const char*)) {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      size_t rss_before = CurrentRssBytes();
+      auto start = std::chrono::steady_clock::now();
+      Local<Uint8Array> file = open(isolate, path.c_str()).ToLocalChecked();
+      auto opened = std::chrono::steady_clock::now();
+      context->Global()->Set(context, String::NewFromUtf8Literal(isolate, "file"),
+                             file).Check();
+      Local<Script> script = Script::Compile(context,
+          String::NewFromUtf8(isolate, sum_pages).ToLocalChecked()).ToLocalChecked();
+      String::Utf8Value sum(isolate, script->Run(context).ToLocalChecked());
+      auto summed = std::chrono::steady_clock::now();
+      size_t rss_after = CurrentRssBytes();
+      if (expected.empty()) {
+        expected = *sum;
+      }
+      EXPECT_EQ(expected, *sum);
+      EXPECT_EQ(size, file->Length());
+      std::cout << label << ": open " << ms(opened - start).count()
+                << " ms, sum pages " << ms(summed - opened).count()
+                << " ms, rss delta " << (static_cast<long>(rss_after) -
+                                         static_cast<long>(rss_before)) / 1024
+                << " KB\n";
+    }
+    isolate->Dispose();
+  };
+
+  run("mapped, sequential", [](Isolate* isolate, const char* name) {
+    return Uint8ArrayFromFile(isolate, name, MappedFile::kReadOnly,
+                              MappedFile::kSequential);
+  });
+  run("mapped, random    ", [](Isolate* isolate, const char* name) {
+    return Uint8ArrayFromFile(isolate, name, MappedFile::kReadOnly,
+                              MappedFile::kRandom);
+  });
+  run("read into buffer  ", [](Isolate* isolate, const char* name) {
+    FILE* file = fopen(name, "rb");
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    rewind(file);
+    Local<ArrayBuffer> buffer = ArrayBuffer::New(isolate, size);
+    char* data = static_cast<char*>(buffer->GetBackingStore()->Data());
+    for (size_t i = 0; i < size;) {
+      size_t n = fread(data + i, 1, size - i, file);
+      if (n == 0) {
+        break;
+      }
+      i += n;
+    }
+    fclose(file);
+    return MaybeLocal<Uint8Array>(Uint8Array::New(buffer, 0, size));
+  });
+  unlink(path.c_str());
+}
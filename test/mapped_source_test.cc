@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/mapped-source.h"
+#include "../src/memory-usage.h"
+
+using namespace v8;
+
+class MappedSourceTest : public V8TestFixture {
+ protected:
+  std::string WriteTempFile(const std::string& content) {
+    char tmpl[] = "/tmp/mapped_source_test_XXXXXX";
+    int fd = mkstemp(tmpl);
+    EXPECT_NE(fd, -1);
+    size_t written = 0;
+    while (written < content.size()) {
+      ssize_t n = write(fd, content.data() + written, content.size() - written);
+      EXPECT_GT(n, 0);
+      written += static_cast<size_t>(n);
+    }
+    close(fd);
+    return tmpl;
+  }
+};
+
+// This is the ReadFile function that run-script.cc used before it switched
+// to ReadFileMapped, kept here to compare against.
+static MaybeLocal<String> ReadFileCopy(Isolate* isolate, const char* name) {
+  FILE* file = fopen(name, "rb");
+  if (file == NULL) {
+    return MaybeLocal<String>();
+  }
+  fseek(file, 0, SEEK_END);
+  size_t size = ftell(file);
+  rewind(file);
+  char* chars = new char[size + 1];
+  chars[size] = '\0';
+  for (size_t i = 0; i < size;) {
+    i += fread(&chars[i], 1, size - i, file);
+    if (ferror(file)) {
+      fclose(file);
+      delete[] chars;
+      return MaybeLocal<String>();
+    }
+  }
+  fclose(file);
+  MaybeLocal<String> result = String::NewFromUtf8(isolate, chars,
+      NewStringType::kNormal, static_cast<int>(size));
+  delete[] chars;
+  return result;
+}
+
+TEST_F(MappedSourceTest, Ascii) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  std::string path = WriteTempFile("var x = 'bajja';");
+  Local<String> str = ReadFileMapped(isolate_, path.c_str()).ToLocalChecked();
+  EXPECT_TRUE(str->IsExternalOneByte());
+  String::Utf8Value value(isolate_, str);
+  EXPECT_STREQ("var x = 'bajja';", *value);
+  unlink(path.c_str());
+}
+
+TEST_F(MappedSourceTest, Latin1) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  std::string path = WriteTempFile("var x = 'åäö';");
+  Local<String> str = ReadFileMapped(isolate_, path.c_str()).ToLocalChecked();
+  EXPECT_TRUE(str->IsExternalOneByte());
+  EXPECT_EQ(str->Length(), 14);
+  String::Utf8Value value(isolate_, str);
+  EXPECT_STREQ("var x = 'åäö';", *value);
+  unlink(path.c_str());
+}
+
+TEST_F(MappedSourceTest, TwoByte) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  // U+20AC (euro sign) and U+1F600 which needs a surrogate pair.
+  std::string path = WriteTempFile("'\xe2\x82\xac \xf0\x9f\x98\x80'");
+  Local<String> str = ReadFileMapped(isolate_, path.c_str()).ToLocalChecked();
+  EXPECT_TRUE(str->IsExternal());
+  EXPECT_FALSE(str->IsOneByte());
+  EXPECT_EQ(str->Length(), 6);
+  String::Utf8Value value(isolate_, str);
+  EXPECT_STREQ("'\xe2\x82\xac \xf0\x9f\x98\x80'", *value);
+  unlink(path.c_str());
+}
+
+TEST_F(MappedSourceTest, InvalidUtf8IsCopied) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  std::string path = WriteTempFile("'\xc3'");
+  Local<String> str = ReadFileMapped(isolate_, path.c_str()).ToLocalChecked();
+  EXPECT_FALSE(str->IsExternal());
+  unlink(path.c_str());
+}
+
+TEST_F(MappedSourceTest, EmptyAndMissing) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  std::string path = WriteTempFile("");
+  EXPECT_EQ(ReadFileMapped(isolate_, path.c_str()).ToLocalChecked()->Length(), 0);
+  unlink(path.c_str());
+  EXPECT_TRUE(ReadFileMapped(isolate_, "/nonexistent/file.js").IsEmpty());
+}
+
+TEST_F(MappedSourceTest, LoadTimeAndRss) {
+  const size_t size = 64 * 1024 * 1024;
+  std::string content;
+  content.reserve(size);
+  while (content.size() < size) {
+    content += "function f() { return 'some padding to make a large bundle'; }\n";
+  }
+  content.resize(size);
+  std::string path = WriteTempFile(content);
+  content = std::string();
+
+  using ms = std::chrono::duration<double, std::milli>;
+  auto load = [&](const char* label,
+                  MaybeLocal<String> (*read)(Isolate*, const char*)) {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      size_t rss_before = CurrentRssBytes();
+      auto start = std::chrono::steady_clock::now();
+      Local<String> str = read(isolate, path.c_str()).ToLocalChecked();
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      size_t rss_after = CurrentRssBytes();
+      EXPECT_EQ(static_cast<size_t>(str->Length()), size);
+      std::cout << label << ": " << ms(elapsed).count() << " ms, rss delta: "
+                << (static_cast<long>(rss_after) - static_cast<long>(rss_before)) / 1024 << " KB, peak rss: "
+                << PeakRssBytes() / 1024 << " KB\n";
+    }
+    isolate->Dispose();
+  };
+  // Run the mapped version first as peak RSS can only grow.
+  load("mapped", ReadFileMapped);
+  load("copy  ", ReadFileCopy);
+  unlink(path.c_str());
+}
@@ -1,4 +1,6 @@
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include "gtest/gtest.h"
 #include "v8.h"
 #include "libplatform/libplatform.h"
@@ -7,6 +9,7 @@
 #include "src/objects/objects-inl.h"
 #include "src/api/api.h"
 #include "src/objects/elements-kind.h"
+#include "../src/microtask-scheduler.h"
 
 using namespace v8;
 namespace i = v8::internal;
@@ -48,3 +51,187 @@ TEST_F(MicrotaskTest, EnqueueMicrotaskCallback) {
   isolate_->EnqueueMicrotask(callback, nullptr);
   isolate_->PerformMicrotaskCheckpoint();
 }
+
+void count_callback(void* data) {
+  (*static_cast<int*>(data))++;
+}
+
+TEST_F(MicrotaskTest, BatchedCheckpoint) {
+  Isolate::Scope isolate_scope(isolate_);
+  const v8::HandleScope handle_scope(isolate_);
+  MicrotaskScheduler::Options options;
+  options.max_batch = 4;
+  options.max_delay_ms = 0;
+  MicrotaskScheduler scheduler(isolate_, options);
+  Local<Context> context = scheduler.NewContext();
+  Context::Scope context_scope(context);
+
+  int count = 0;
+  for (int i = 0; i < 3; i++) {
+    scheduler.Enqueue(count_callback, &count);
+  }
+  EXPECT_EQ(0, count);
+  EXPECT_EQ(3, scheduler.pending());
+  // The isolate's checkpoint only drains the default queue.
+  isolate_->PerformMicrotaskCheckpoint();
+  EXPECT_EQ(0, count);
+
+  scheduler.Enqueue(count_callback, &count);
+  EXPECT_EQ(4, count);
+  EXPECT_EQ(0, scheduler.pending());
+  scheduler.Enqueue(count_callback, &count);
+  scheduler.Checkpoint();
+  EXPECT_EQ(5, count);
+
+  EXPECT_EQ(2, scheduler.depth().count());
+  EXPECT_EQ(4, scheduler.depth().max());
+  EXPECT_EQ(2, scheduler.drain_time().count());
+}
+
+TEST_F(MicrotaskTest, BatchTimeBudget) {
+  Isolate::Scope isolate_scope(isolate_);
+  const v8::HandleScope handle_scope(isolate_);
+  MicrotaskScheduler::Options options;
+  options.max_batch = 1000;
+  options.max_delay_ms = 5;
+  MicrotaskScheduler scheduler(isolate_, options);
+  Local<Context> context = scheduler.NewContext();
+  Context::Scope context_scope(context);
+
+  int count = 0;
+  scheduler.Enqueue(count_callback, &count);
+  EXPECT_FALSE(scheduler.MaybeCheckpoint());
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(0, count);
+  EXPECT_TRUE(scheduler.MaybeCheckpoint());
+  EXPECT_EQ(1, count);
+}
+
+TEST_F(MicrotaskTest, PromiseReactionsOnContextQueue) {
+  Isolate::Scope isolate_scope(isolate_);
+  const v8::HandleScope handle_scope(isolate_);
+  MicrotaskScheduler scheduler(isolate_);
+  Local<Context> context = scheduler.NewContext();
+  Context::Scope context_scope(context);
+
+  Local<String> source = String::NewFromUtf8Literal(isolate_,
+      "var done = false; Promise.resolve().then(() => done = true);");
+  Script::Compile(context, source).ToLocalChecked()->Run(context).ToLocalChecked();
+  // V8 queues the reaction itself, the scheduler cannot count it.
+  EXPECT_EQ(0, scheduler.pending());
+  Local<String> done = String::NewFromUtf8Literal(isolate_, "done");
+  EXPECT_FALSE(context->Global()->Get(context, done).ToLocalChecked()->BooleanValue(isolate_));
+  EXPECT_TRUE(scheduler.Checkpoint());
+  EXPECT_TRUE(context->Global()->Get(context, done).ToLocalChecked()->BooleanValue(isolate_));
+}
+
+TEST_F(MicrotaskTest, ScopedPolicy) {
+  Isolate::Scope isolate_scope(isolate_);
+  const v8::HandleScope handle_scope(isolate_);
+  MicrotaskScheduler::Options options;
+  options.policy = MicrotasksPolicy::kScoped;
+  options.max_batch = 2;
+  options.max_delay_ms = 0;
+  MicrotaskScheduler scheduler(isolate_, options);
+  Local<Context> context = scheduler.NewContext();
+  Context::Scope context_scope(context);
+
+  int count = 0;
+  {
+    MicrotaskScheduler::Scope outer(&scheduler);
+    {
+      MicrotaskScheduler::Scope inner(&scheduler);
+      scheduler.Enqueue(count_callback, &count);
+      scheduler.Enqueue(count_callback, &count);
+    }
+    // Only leaving the outermost scope checkpoints.
+    EXPECT_EQ(0, count);
+  }
+  EXPECT_EQ(2, count);
+  {
+    MicrotaskScheduler::Scope scope(&scheduler);
+    scheduler.Enqueue(count_callback, &count);
+  }
+  // Below max_batch.
+  EXPECT_EQ(2, count);
+  scheduler.Checkpoint();
+  EXPECT_EQ(3, count);
+}
+
+// Dispatches events to JavaScript the way an embedder would, each one
+// queueing a microtask that resolves a promise with a couple of reactions,
+// and compares the checkpoint per microtask pattern above with batched
+// checkpoints.
+TEST_F(MicrotaskTest, CheckpointPolicyBenchmark) {
+  const int events = 100000;
+  const char* js =
+      "var sum = 0, next = 0;"
+      "function onEvent() {"
+      "  Promise.resolve(next++).then(v => v * 2).then(v => { sum += v; });"
+      "}";
+  const double expected = static_cast<double>(events - 1) * events;
+
+  struct Policy {
+    const char* name;
+    bool default_queue;
+    MicrotasksPolicy policy;
+    int max_batch;
+    double max_delay_ms;
+  };
+  const Policy policies[] = {
+    {"default queue, checkpoint per microtask", true, MicrotasksPolicy::kExplicit, 1, 0},
+    {"explicit, batch 1", false, MicrotasksPolicy::kExplicit, 1, 0},
+    {"explicit, batch 64", false, MicrotasksPolicy::kExplicit, 64, 0},
+    {"explicit, batch 1024 or 1ms", false, MicrotasksPolicy::kExplicit, 1024, 1},
+    {"scoped, batch 64", false, MicrotasksPolicy::kScoped, 64, 0},
+  };
+
+  for (const Policy& policy : policies) {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      const v8::HandleScope handle_scope(isolate);
+      MicrotaskScheduler::Options options;
+      options.policy = policy.policy;
+      options.max_batch = policy.max_batch;
+      options.max_delay_ms = policy.max_delay_ms;
+      MicrotaskScheduler scheduler(isolate, options);
+      Local<Context> context = policy.default_queue
+          ? Context::New(isolate) : scheduler.NewContext();
+      Context::Scope context_scope(context);
+      {
+        MicrotaskScheduler::Scope scope(&scheduler);
+        Local<String> source = String::NewFromUtf8(isolate, js).ToLocalChecked();
+        Script::Compile(context, source).ToLocalChecked()->Run(context).ToLocalChecked();
+      }
+      Local<Function> on_event = context->Global()->Get(context,
+          String::NewFromUtf8Literal(isolate, "onEvent")).ToLocalChecked().As<Function>();
+
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < events; i++) {
+        if (policy.default_queue) {
+          isolate->EnqueueMicrotask(on_event);
+          isolate->PerformMicrotaskCheckpoint();
+        } else if (policy.policy == MicrotasksPolicy::kScoped) {
+          MicrotaskScheduler::Scope scope(&scheduler);
+          scheduler.Enqueue(on_event);
+        } else {
+          scheduler.Enqueue(on_event);
+        }
+      }
+      scheduler.Checkpoint();
+      double ms = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start).count();
+
+      Local<Value> sum = context->Global()->Get(context,
+          String::NewFromUtf8Literal(isolate, "sum")).ToLocalChecked();
+      EXPECT_EQ(expected, sum.As<Number>()->Value()) << policy.name;
+      std::cout << policy.name << ": " << ms << "ms, "
+                << events / ms * 1000 << " events/s\n";
+      if (!policy.default_queue) {
+        scheduler.Dump(stdout);
+      }
+    }
+    isolate->Dispose();
+  }
+}
@@ -0,0 +1,88 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/bindings.h"
+#include "../src/memory-usage.h"
+
+using namespace v8;
+
+class ObjectWrapTest : public V8TestFixture {
+ protected:
+  void RunScript(Local<Context> context, const char* js) {
+    // The result must not outlive the call or it would keep it alive.
+    HandleScope handle_scope(isolate_);
+    Local<String> source = String::NewFromUtf8(isolate_, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    script->Run(context).ToLocalChecked();
+  }
+};
+
+TEST_F(ObjectWrapTest, PersonIsFreedWhenCollected) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_, nullptr, NewGlobalTemplate(isolate_));
+  Context::Scope context_scope(context);
+
+  size_t live = Person::allocator().live();
+  RunScript(context, "var p = new Person('Fletch'); new Person('Dr.Rosen');");
+  EXPECT_EQ(Person::allocator().live(), live + 2);
+
+  // Only the unreachable Person is collected.
+  isolate_->LowMemoryNotification();
+  EXPECT_EQ(Person::allocator().live(), live + 1);
+
+  RunScript(context, "p = undefined;");
+  isolate_->LowMemoryNotification();
+  EXPECT_EQ(Person::allocator().live(), live);
+}
+
+TEST_F(ObjectWrapTest, CallWithoutNewThrows) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_, nullptr, NewGlobalTemplate(isolate_));
+  Context::Scope context_scope(context);
+
+  TryCatch try_catch(isolate_);
+  Local<String> source = String::NewFromUtf8Literal(isolate_, "Person('Fletch')");
+  Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+  EXPECT_TRUE(script->Run(context).IsEmpty());
+  EXPECT_TRUE(try_catch.HasCaught());
+}
+
+TEST_F(ObjectWrapTest, TenMillionPersonsFlatRss) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_, nullptr, NewGlobalTemplate(isolate_));
+  Context::Scope context_scope(context);
+
+  const int rounds = 10;
+  // Each round creates a million Persons, all of them garbage right away.
+  const char* js = R"(
+    for (let i = 0; i < 1000000; i++) {
+      new Person('person with a name that does not fit in SSO ' + i);
+    })";
+  // A round that leaked its Persons would add well over 100MB, the heap and
+  // the slabs settling after the first rounds much less.
+  const size_t allowed_growth = 64 << 20;
+  size_t baseline = 0;
+  for (int i = 0; i < rounds; i++) {
+    RunScript(context, js);
+    size_t rss = CurrentRssBytes();
+    std::cout << "round " << i << ": rss " << rss / 1024
+              << " KB, live Persons: " << Person::allocator().live()
+              << ", slab bytes: " << Person::allocator().reserved_bytes()
+              << '\n';
+    // The first round warms up the heap and the slabs.
+    if (i == 1) {
+      baseline = rss;
+    } else if (i > 1) {
+      EXPECT_LE(rss, baseline + allowed_growth) << "round " << i;
+    }
+  }
+  isolate_->LowMemoryNotification();
+  std::cout << "after full gc: rss " << CurrentRssBytes() / 1024
+            << " KB, live Persons: " << Person::allocator().live() << '\n';
+  EXPECT_LT(Person::allocator().live(), 1000000u);
+}
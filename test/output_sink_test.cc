@@ -0,0 +1,149 @@
+#include <fcntl.h>
+#include <chrono>
+#include <iostream>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/bindings.h"
+#include "../src/output-sink.h"
+
+using namespace v8;
+
+class OutputSinkTest : public V8TestFixture {
+ protected:
+  void RunScript(const char* js) {
+    Local<Context> context = isolate_->GetCurrentContext();
+    Local<String> source = String::NewFromUtf8(isolate_, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    script->Run(context).ToLocalChecked();
+  }
+
+  static std::string ReadAll(const char* path) {
+    std::string content;
+    FILE* file = fopen(path, "rb");
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+      content.append(buf, n);
+    }
+    fclose(file);
+    return content;
+  }
+};
+
+TEST_F(OutputSinkTest, Print) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_, nullptr, NewGlobalTemplate(isolate_));
+  Context::Scope context_scope(context);
+
+  char path[] = "/tmp/output_sink_test_XXXXXX";
+  int fd = mkstemp(path);
+  {
+    OutputSink sink(isolate_, fd);
+    EXPECT_EQ(OutputSink::From(isolate_), &sink);
+    RunScript("print('åäö', 18, {}); print('€');");
+  }
+  EXPECT_EQ(OutputSink::From(isolate_), nullptr);
+  close(fd);
+  EXPECT_EQ(ReadAll(path), "åäö 18 [object Object]\n€\n");
+  unlink(path);
+}
+
+TEST_F(OutputSinkTest, FlushAtThreshold) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_, nullptr, NewGlobalTemplate(isolate_));
+  Context::Scope context_scope(context);
+
+  char path[] = "/tmp/output_sink_test_XXXXXX";
+  int fd = mkstemp(path);
+  OutputSink sink(isolate_, fd, 16);
+  RunScript("print('0123456789'); print('0123456789');");
+  // The second line did not fit so the first one has been written.
+  EXPECT_EQ(ReadAll(path), "0123456789\n");
+  sink.Flush();
+  EXPECT_EQ(ReadAll(path), "0123456789\n0123456789\n");
+  close(fd);
+  unlink(path);
+}
+
+TEST_F(OutputSinkTest, FlushAtMicrotaskCheckpoint) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_, nullptr, NewGlobalTemplate(isolate_));
+  Context::Scope context_scope(context);
+
+  char path[] = "/tmp/output_sink_test_XXXXXX";
+  int fd = mkstemp(path);
+  OutputSink sink(isolate_, fd);
+  RunScript("print('bajja');");
+  isolate_->PerformMicrotaskCheckpoint();
+  EXPECT_EQ(ReadAll(path), "bajja\n");
+  close(fd);
+  unlink(path);
+}
+
+TEST_F(OutputSinkTest, BackgroundWriter) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_, nullptr, NewGlobalTemplate(isolate_));
+  Context::Scope context_scope(context);
+
+  char path[] = "/tmp/output_sink_test_XXXXXX";
+  int fd = mkstemp(path);
+  {
+    OutputSink sink(isolate_, fd, 64, true);
+    RunScript("for (let i = 0; i < 1000; i++) print(i);");
+  }
+  std::string expected;
+  for (int i = 0; i < 1000; i++) {
+    expected += std::to_string(i) + "\n";
+  }
+  EXPECT_EQ(ReadAll(path), expected);
+  close(fd);
+  unlink(path);
+}
+
+TEST_F(OutputSinkTest, PrintMillionLines) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_, nullptr, NewGlobalTemplate(isolate_));
+  Context::Scope context_scope(context);
+
+  const char* js = "for (let i = 0; i < 1000000; i++) print('line', i);";
+  int dev_null = open("/dev/null", O_WRONLY);
+  using ms = std::chrono::duration<double, std::milli>;
+
+  // The printf path writes to stdout, so point stdout at /dev/null while
+  // it runs.
+  fflush(stdout);
+  int saved_stdout = dup(STDOUT_FILENO);
+  dup2(dev_null, STDOUT_FILENO);
+  auto start = std::chrono::steady_clock::now();
+  RunScript(js);
+  auto printf_time = std::chrono::steady_clock::now() - start;
+  fflush(stdout);
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(saved_stdout);
+
+  start = std::chrono::steady_clock::now();
+  {
+    OutputSink sink(isolate_, dev_null);
+    RunScript(js);
+  }
+  auto sink_time = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  {
+    OutputSink sink(isolate_, dev_null, 64 * 1024, true);
+    RunScript(js);
+  }
+  auto background_time = std::chrono::steady_clock::now() - start;
+  close(dev_null);
+
+  std::cout << "printf:            " << ms(printf_time).count() << " ms\n";
+  std::cout << "sink:              " << ms(sink_time).count() << " ms\n";
+  std::cout << "sink (background): " << ms(background_time).count() << " ms\n";
+}
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <iostream>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/pooled-page-allocator.h"
+
+using namespace v8;
+
+// V8 gets its page allocator from the platform, so these tests run on a
+// PageAllocatorPlatform instead of the fixture's default platform.
+class PageAllocatorTest : public V8TestFixture {
+ protected:
+  static PageAllocatorPlatform* pooled_platform_;
+
+  static void SetUpTestCase() {
+    V8::InitializeExternalStartupData("fixture");
+    pooled_platform_ = new PageAllocatorPlatform(platform::NewDefaultPlatform());
+    platform_.reset(pooled_platform_);
+    allocator_.reset(ArrayBuffer::Allocator::NewDefaultAllocator());
+    create_params_.array_buffer_allocator = allocator_.get();
+    V8::InitializePlatform(platform_.get());
+    V8::Initialize();
+  }
+};
+
+PageAllocatorPlatform* PageAllocatorTest::pooled_platform_;
+
+static long MinorFaults() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+TEST_F(PageAllocatorTest, ReusesReservations) {
+  PageAllocator* base = pooled_platform_->platform()->GetPageAllocator();
+  PooledPageAllocator page_allocator(base);
+  const size_t length = 4 << 20;
+  const size_t alignment = page_allocator.AllocatePageSize();
+
+  void* region = page_allocator.AllocatePages(nullptr, length, alignment,
+                                              PageAllocator::kNoAccess);
+  ASSERT_NE(nullptr, region);
+  ASSERT_TRUE(page_allocator.SetPermissions(region, length,
+                                            PageAllocator::kReadWrite));
+  memset(region, 0xab, length);
+  EXPECT_TRUE(page_allocator.FreePages(region, length));
+  EXPECT_EQ(length, page_allocator.stats().pooled_bytes);
+
+  // The same reservation again, inaccessible and reading as zero once it
+  // is committed, like a new one.
+  void* again = page_allocator.AllocatePages(nullptr, length, alignment,
+                                             PageAllocator::kNoAccess);
+  EXPECT_EQ(region, again);
+  ASSERT_TRUE(page_allocator.SetPermissions(again, length,
+                                            PageAllocator::kReadWrite));
+  EXPECT_EQ(0, static_cast<char*>(again)[0]);
+  EXPECT_EQ(0, static_cast<char*>(again)[length - 1]);
+
+  // Other lengths and small reservations come from the wrapped allocator.
+  void* other = page_allocator.AllocatePages(nullptr, 2 * length, alignment,
+                                             PageAllocator::kNoAccess);
+  void* small = page_allocator.AllocatePages(nullptr, alignment, alignment,
+                                             PageAllocator::kNoAccess);
+  EXPECT_NE(region, other);
+  EXPECT_TRUE(page_allocator.FreePages(small, alignment));
+  EXPECT_TRUE(page_allocator.FreePages(other, 2 * length));
+  EXPECT_TRUE(page_allocator.FreePages(again, length));
+
+  PooledPageAllocator::Stats stats = page_allocator.stats();
+  EXPECT_EQ(1u, stats.reused);
+  EXPECT_EQ(2u, stats.reserved);
+  EXPECT_EQ(3 * length, stats.pooled_bytes);
+  page_allocator.Trim();
+  EXPECT_EQ(0u, page_allocator.stats().pooled_bytes);
+}
+
+TEST_F(PageAllocatorTest, Prefault) {
+  PageAllocator* base = pooled_platform_->platform()->GetPageAllocator();
+  PooledPageAllocator::Options options;
+  options.prefault = true;
+  PooledPageAllocator page_allocator(base, options);
+  const size_t length = 8 << 20;
+  void* region = page_allocator.AllocatePages(nullptr, length,
+      page_allocator.AllocatePageSize(), PageAllocator::kNoAccess);
+  ASSERT_NE(nullptr, region);
+  ASSERT_TRUE(page_allocator.SetPermissions(region, length,
+                                            PageAllocator::kReadWrite));
+  // Already faulted in by SetPermissions.
+  long faults = MinorFaults();
+  memset(region, 1, length);
+  std::cout << "minor faults writing " << length / 1024
+            << " KB of prefaulted pages: " << MinorFaults() - faults << '\n';
+  EXPECT_TRUE(page_allocator.FreePages(region, length));
+}
+
+// Creates and disposes isolates, each with a context that runs a little
+// script, with the platform's page allocator and with the pool. 200 cycles
+// unless PAGE_ALLOCATOR_BENCHMARK_CYCLES says otherwise.
+TEST_F(PageAllocatorTest, IsolateChurnBenchmark) {
+  int cycles = 200;
+  if (const char* env = getenv("PAGE_ALLOCATOR_BENCHMARK_CYCLES")) {
+    cycles = atoi(env);
+  }
+  PooledPageAllocator* page_allocator = pooled_platform_->page_allocator();
+
+  auto cycle = [] {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      Local<String> source = String::NewFromUtf8Literal(isolate,
+          "let a = []; for (let i = 0; i < 1000; i++) a.push({i}); a.length");
+      Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+      EXPECT_EQ(1000, script->Run(context).ToLocalChecked()
+                          ->Int32Value(context).FromJust());
+    }
+    NotifyPlatformIsolateShutdown(platform_.get(), isolate);
+    isolate->Dispose();
+  };
+
+  using seconds = std::chrono::duration<double>;
+  for (int pooled = 0; pooled <= 1; pooled++) {
+    page_allocator->set_enabled(pooled);
+    page_allocator->Trim();
+    // Fills the pool, and warms up the default.
+    cycle();
+    PooledPageAllocator::Stats before = page_allocator->stats();
+    long faults = MinorFaults();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < cycles; i++) {
+      cycle();
+    }
+    seconds elapsed = std::chrono::steady_clock::now() - start;
+    PooledPageAllocator::Stats after = page_allocator->stats();
+    std::cout << (pooled ? "pooled  " : "default ") << ": "
+              << cycles / elapsed.count() << " isolates/s, "
+              << (MinorFaults() - faults) / cycles << " minor faults/isolate";
+    if (pooled) {
+      std::cout << ", " << after.reused - before.reused << " reused, "
+                << after.reserved - before.reserved << " new reservations, "
+                << after.pooled_bytes / (1 << 20) << " MB pooled";
+    }
+    std::cout << '\n';
+  }
+}
@@ -1,4 +1,13 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "gtest/gtest.h"
 #include "v8.h"
 #include "libplatform/libplatform.h"
@@ -7,6 +16,7 @@
 #include "src/objects/objects-inl.h"
 #include "src/api/api.h"
 #include "src/objects/elements-kind.h"
+#include "../src/work-stealing-platform.h"
 
 using namespace v8;
 namespace i = v8::internal;
@@ -35,3 +45,328 @@ TEST_F(PlatformTest, Jobs) {
   auto task = std::make_unique<SomeTask>("doit");
   platform_->CallOnWorkerThread(std::move(task));
 }
+
+class WorkStealingPlatformTest : public V8TestFixture {
+ protected:
+  struct Counter {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::string> order;
+    size_t count = 0;
+
+    void Add(const std::string& name) {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(name);
+      count++;
+      cv.notify_all();
+    }
+
+    void WaitFor(size_t expected) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return count >= expected; });
+    }
+  };
+
+  class CountingTask : public Task {
+   public:
+    CountingTask(Counter* counter, std::string name)
+        : counter_(counter), name_(std::move(name)) {}
+    void Run() override { counter_->Add(name_); }
+
+   private:
+    Counter* counter_;
+    std::string name_;
+  };
+
+  // Keeps a worker busy until Release is called.
+  class BlockingTask : public Task {
+   public:
+    explicit BlockingTask(std::promise<void>* started, std::shared_future<void> release)
+        : started_(started), release_(release) {}
+    void Run() override {
+      started_->set_value();
+      release_.wait();
+    }
+
+   private:
+    std::promise<void>* started_;
+    std::shared_future<void> release_;
+  };
+
+  // Processes a number of work items with as many workers as there are
+  // items left.
+  class ItemsJob : public JobTask {
+   public:
+    explicit ItemsJob(size_t items) : remaining_(items) {}
+
+    void Run(JobDelegate* delegate) override {
+      size_t active = ++active_;
+      size_t max = max_active_.load();
+      while (active > max && !max_active_.compare_exchange_weak(max, active)) {
+      }
+      while (!delegate->ShouldYield()) {
+        size_t left = remaining_.load();
+        if (left == 0 || !remaining_.compare_exchange_weak(left, left - 1)) {
+          if (left == 0) {
+            break;
+          }
+          continue;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        processed_++;
+      }
+      --active_;
+    }
+
+    size_t GetMaxConcurrency(size_t worker_count) const override {
+      return remaining_.load();
+    }
+
+    std::atomic<size_t> remaining_;
+    std::atomic<size_t> processed_{0};
+    std::atomic<size_t> active_{0};
+    std::atomic<size_t> max_active_{0};
+  };
+};
+
+TEST_F(WorkStealingPlatformTest, WorkerTasks) {
+  WorkStealingPlatform platform(4);
+  EXPECT_EQ(4, platform.NumberOfWorkerThreads());
+  Counter counter;
+  for (int i = 0; i < 1000; i++) {
+    platform.CallOnWorkerThread(std::make_unique<CountingTask>(&counter, "task"));
+  }
+  counter.WaitFor(1000);
+  EXPECT_EQ(1000, counter.count);
+}
+
+TEST_F(WorkStealingPlatformTest, Priorities) {
+  WorkStealingPlatform platform(1);
+  // Block the only worker so that the tasks below are all queued before
+  // any of them runs.
+  std::promise<void> started;
+  std::promise<void> release;
+  platform.CallOnWorkerThread(std::make_unique<BlockingTask>(
+      &started, release.get_future().share()));
+  started.get_future().wait();
+
+  Counter counter;
+  platform.CallLowPriorityTaskOnWorkerThread(
+      std::make_unique<CountingTask>(&counter, "best effort"));
+  platform.CallOnWorkerThread(
+      std::make_unique<CountingTask>(&counter, "user visible"));
+  platform.CallBlockingTaskOnWorkerThread(
+      std::make_unique<CountingTask>(&counter, "user blocking"));
+  release.set_value();
+  counter.WaitFor(3);
+  EXPECT_EQ((std::vector<std::string>{"user blocking", "user visible", "best effort"}),
+            counter.order);
+}
+
+TEST_F(WorkStealingPlatformTest, DelayedTasks) {
+  WorkStealingPlatform platform(2);
+  Counter counter;
+  auto start = std::chrono::steady_clock::now();
+  platform.CallDelayedOnWorkerThread(
+      std::make_unique<CountingTask>(&counter, "delayed"), 0.05);
+  counter.WaitFor(1);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+TEST_F(WorkStealingPlatformTest, ForegroundTasks) {
+  WorkStealingPlatform platform(1);
+  Counter counter;
+  std::shared_ptr<TaskRunner> runner = platform.GetForegroundTaskRunner(isolate_);
+  runner->PostTask(std::make_unique<CountingTask>(&counter, "first"));
+  runner->PostDelayedTask(std::make_unique<CountingTask>(&counter, "delayed"), 0.02);
+  runner->PostTask(std::make_unique<CountingTask>(&counter, "second"));
+
+  // Foreground tasks only run when the loop is pumped.
+  EXPECT_EQ(0, counter.count);
+  EXPECT_TRUE(PumpPlatformMessageLoop(&platform, isolate_));
+  EXPECT_TRUE(PumpPlatformMessageLoop(&platform, isolate_));
+  EXPECT_FALSE(PumpPlatformMessageLoop(&platform, isolate_));
+  EXPECT_TRUE(PumpPlatformMessageLoop(&platform, isolate_, true));
+  EXPECT_EQ((std::vector<std::string>{"first", "second", "delayed"}), counter.order);
+  NotifyPlatformIsolateShutdown(&platform, isolate_);
+}
+
+// An isolate created at the address of a disposed one starts without its
+// tasks.
+TEST_F(WorkStealingPlatformTest, IsolateShutdownDropsForegroundTasks) {
+  WorkStealingPlatform platform(1);
+  Counter counter;
+  std::shared_ptr<TaskRunner> runner = platform.GetForegroundTaskRunner(isolate_);
+  runner->PostTask(std::make_unique<CountingTask>(&counter, "task"));
+  runner->PostDelayedTask(std::make_unique<CountingTask>(&counter, "delayed"), 0.01);
+  NotifyPlatformIsolateShutdown(&platform, isolate_);
+
+  EXPECT_NE(runner, platform.GetForegroundTaskRunner(isolate_));
+  EXPECT_FALSE(PumpPlatformMessageLoop(&platform, isolate_));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(PumpPlatformMessageLoop(&platform, isolate_));
+  EXPECT_EQ(0, counter.count);
+  NotifyPlatformIsolateShutdown(&platform, isolate_);
+}
+
+TEST_F(WorkStealingPlatformTest, PostJob) {
+  WorkStealingPlatform platform(4);
+  auto job = std::make_unique<ItemsJob>(200);
+  ItemsJob* items = job.get();
+  std::unique_ptr<JobHandle> handle =
+      platform.PostJob(TaskPriority::kUserVisible, std::move(job));
+  handle->Join();
+  EXPECT_EQ(200, items->processed_);
+  // The joining thread takes part too.
+  EXPECT_LE(items->max_active_, 5);
+  EXPECT_GT(items->max_active_, 1);
+}
+
+// Throughput and queueing latency of the DefaultPlatform and the
+// WorkStealingPlatform with many isolates posting at the same time.
+//
+// V8 can only be initialized with one platform per process, so the
+// isolates are simulated: each one is a thread that posts short tasks with
+// mixed priorities through the v8::Platform interface, like V8 does for GC
+// and compile tasks, plus a job. The time from posting a task until it
+// starts running is its queueing latency.
+class PlatformBenchmark {
+ public:
+  struct Result {
+    double tasks_per_second;
+    double p50_us;
+    double p99_us;
+    double max_us;
+  };
+
+  static Result Run(Platform* platform, int isolates, int tasks_per_isolate) {
+    PlatformBenchmark benchmark(isolates * tasks_per_isolate);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < isolates; i++) {
+      threads.emplace_back([&benchmark, platform, tasks_per_isolate] {
+        std::unique_ptr<JobHandle> job = platform->PostJob(
+            TaskPriority::kUserVisible, std::make_unique<SpinJob>(100));
+        for (int j = 0; j < tasks_per_isolate; j++) {
+          auto task = std::make_unique<TimedTask>(&benchmark);
+          switch (j % 3) {
+            case 0:
+              platform->CallOnWorkerThread(std::move(task));
+              break;
+            case 1:
+              platform->CallBlockingTaskOnWorkerThread(std::move(task));
+              break;
+            case 2:
+              platform->CallLowPriorityTaskOnWorkerThread(std::move(task));
+              break;
+          }
+        }
+        job->Join();
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    benchmark.Wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<double>& latencies = benchmark.latencies_;
+    std::sort(latencies.begin(), latencies.end());
+    return Result{latencies.size() / elapsed.count(),
+                  latencies[latencies.size() / 2],
+                  latencies[latencies.size() * 99 / 100],
+                  latencies.back()};
+  }
+
+ private:
+  explicit PlatformBenchmark(size_t tasks) : expected_(tasks) {
+    latencies_.reserve(tasks);
+  }
+
+  static void Spin(int iterations) {
+    volatile int sink = 0;
+    for (int i = 0; i < iterations; i++) {
+      sink += i;
+    }
+  }
+
+  class TimedTask : public Task {
+   public:
+    explicit TimedTask(PlatformBenchmark* benchmark)
+        : benchmark_(benchmark), posted_(std::chrono::steady_clock::now()) {}
+    void Run() override {
+      std::chrono::duration<double, std::micro> latency =
+          std::chrono::steady_clock::now() - posted_;
+      Spin(200);
+      benchmark_->Add(latency.count());
+    }
+
+   private:
+    PlatformBenchmark* benchmark_;
+    std::chrono::steady_clock::time_point posted_;
+  };
+
+  class SpinJob : public JobTask {
+   public:
+    explicit SpinJob(size_t items) : remaining_(items) {}
+    void Run(JobDelegate* delegate) override {
+      while (!delegate->ShouldYield()) {
+        size_t left = remaining_.load();
+        if (left == 0) {
+          return;
+        }
+        if (remaining_.compare_exchange_weak(left, left - 1)) {
+          Spin(1000);
+        }
+      }
+    }
+    size_t GetMaxConcurrency(size_t worker_count) const override {
+      return remaining_.load();
+    }
+
+   private:
+    std::atomic<size_t> remaining_;
+  };
+
+  void Add(double latency) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencies_.push_back(latency);
+    if (latencies_.size() == expected_) {
+      cv_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return latencies_.size() == expected_; });
+  }
+
+  size_t expected_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<double> latencies_;
+};
+
+TEST_F(PlatformTest, JobsBenchmark) {
+  const int workers = std::max(2, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+  const int isolates = 32;
+  const int tasks_per_isolate = 5000;
+  auto print = [](const char* name, const PlatformBenchmark::Result& result) {
+    std::cout << name << ": " << static_cast<uint64_t>(result.tasks_per_second)
+              << " tasks/s, latency p50 " << result.p50_us << " us, p99 "
+              << result.p99_us << " us, max " << result.max_us << " us\n";
+  };
+  std::cout << isolates << " isolates, " << workers << " worker threads\n";
+  {
+    std::unique_ptr<Platform> platform = platform::NewDefaultPlatform(workers);
+    print("DefaultPlatform     ",
+          PlatformBenchmark::Run(platform.get(), isolates, tasks_per_isolate));
+  }
+  {
+    WorkStealingPlatform platform(workers);
+    print("WorkStealingPlatform",
+          PlatformBenchmark::Run(&platform, isolates, tasks_per_isolate));
+    std::cout << "stolen: " << platform.stats().stolen << " of "
+              << platform.stats().executed << " tasks\n";
+  }
+}
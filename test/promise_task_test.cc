@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/event-loop.h"
+#include "../src/promise-task.h"
+#include "../src/task-injector.h"
+
+using namespace v8;
+
+// Counts every allocation made through operator new in this binary, V8's
+// included, for the benchmark.
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* pointer = malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr) {
+    abort();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t size) noexcept {
+  free(pointer);
+}
+
+class PromiseTaskTest : public V8TestFixture {
+ protected:
+  Local<Value> RunScript(Local<Context> context, const char* js) {
+    Local<String> source = String::NewFromUtf8(isolate_, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    return script->Run(context).ToLocalChecked();
+  }
+
+  std::string RunToString(Local<Context> context, const char* js) {
+    String::Utf8Value value(isolate_, RunScript(context, js));
+    return *value;
+  }
+
+  void SetFunction(Local<Context> context, const char* name,
+                   FunctionCallback callback, void* data) {
+    context->Global()->Set(context,
+        String::NewFromUtf8(isolate_, name).ToLocalChecked(),
+        Function::New(context, callback, External::New(isolate_, data))
+            .ToLocalChecked()).Check();
+  }
+};
+
+struct Bindings {
+  Platform* platform;
+  TaskInjector* injector;
+};
+
+// Doubles n on a worker thread, rejects negative numbers.
+PromiseTask DoubleOnWorker(Platform* platform, TaskInjector* injector, int n) {
+  Isolate* isolate = Isolate::GetCurrent();
+  if (n < 0) {
+    co_return PromiseTask::Reject(
+        String::NewFromUtf8Literal(isolate, "negative"));
+  }
+  int doubled = co_await OnWorkerThread(platform, injector, [n] {
+    return n * 2;
+  });
+  co_return Integer::New(isolate, doubled);
+}
+
+void DoubleOnWorker(const FunctionCallbackInfo<Value>& info) {
+  Bindings* bindings = static_cast<Bindings*>(info.Data().As<External>()->Value());
+  int n = info[0]->Int32Value(info.GetIsolate()->GetCurrentContext()).FromJust();
+  info.GetReturnValue().Set(
+      DoubleOnWorker(bindings->platform, bindings->injector, n).promise());
+}
+
+TEST_F(PromiseTaskTest, ResolvesFromNativeWork) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  TaskInjector injector(isolate_);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+  loop.SetTaskInjector(&injector);
+  Bindings bindings = {platform_.get(), &injector};
+  SetFunction(context, "double", DoubleOnWorker, &bindings);
+
+  RunScript(context,
+      "var results = [];"
+      "double(21).then(value => results[0] = value);"
+      "double(-1).catch(error => results[1] = error);"
+      "(async () => results[2] = await double(await double(1)))();");
+  // Returns once no completion is awaited anymore.
+  loop.Run();
+  EXPECT_EQ("42,negative,4", RunToString(context, "results.join()"));
+}
+
+// Doubles what promise is fulfilled with, and rejects with its reason.
+PromiseTask DoublePromise(Isolate* isolate, Local<Promise> promise) {
+  Settled settled = co_await AwaitPromise(isolate, promise);
+  if (!settled.fulfilled) {
+    co_return PromiseTask::Reject(settled.value);
+  }
+  Local<Context> context = isolate->GetCurrentContext();
+  double value = settled.value->NumberValue(context).FromJust();
+  co_return Number::New(isolate, value * 2);
+}
+
+void DoublePromise(const FunctionCallbackInfo<Value>& info) {
+  info.GetReturnValue().Set(
+      DoublePromise(info.GetIsolate(), info[0].As<Promise>()).promise());
+}
+
+TEST_F(PromiseTaskTest, AwaitsJavaScriptPromise) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+  SetFunction(context, "doublePromise", DoublePromise, nullptr);
+
+  RunScript(context,
+      "var log = [];"
+      "var later = new Promise(resolve => setTimeout(() => resolve(21), 5));"
+      "doublePromise(later).then(value => log.push('later ' + value));"
+      "doublePromise(Promise.resolve(1)).then(value => log.push('now ' + value));"
+      "doublePromise(Promise.reject('no')).catch(error => log.push(error));");
+  loop.Run();
+  EXPECT_EQ("now 2,no,later 42", RunToString(context, "log.join()"));
+}
+
+// Stands in for native I/O: a thread that answers one request at a time
+// with the value it was given.
+class EchoService {
+ public:
+  typedef void (*Callback)(void* data, int value);
+
+  explicit EchoService(TaskInjector* injector)
+      : injector_(injector), thread_([this] { Serve(); }) {}
+
+  ~EchoService() {
+    stop_.store(true);
+    thread_.join();
+  }
+
+  void Submit(Callback callback, void* data, int value) {
+    callback_ = callback;
+    data_ = data;
+    value_ = value;
+    pending_.store(true, std::memory_order_release);
+  }
+
+  TaskInjector* injector() const { return injector_; }
+
+ private:
+  void Serve() {
+    while (!stop_.load(std::memory_order_relaxed)) {
+      if (pending_.load(std::memory_order_acquire)) {
+        pending_.store(false, std::memory_order_relaxed);
+        callback_(data_, value_);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  TaskInjector* injector_;
+  std::atomic<bool> pending_{false};
+  std::atomic<bool> stop_{false};
+  Callback callback_ = nullptr;
+  void* data_ = nullptr;
+  int value_ = 0;
+  std::thread thread_;
+};
+
+PromiseTask EchoCoroutine(EchoService* service, int value) {
+  NativeCompletion<int> echoed(service->injector());
+  service->Submit([](void* data, int value) {
+    static_cast<NativeCompletion<int>*>(data)->Complete(value);
+  }, &echoed, value);
+  int result = co_await echoed;
+  co_return Integer::New(Isolate::GetCurrent(), result);
+}
+
+void EchoCoroutine(const FunctionCallbackInfo<Value>& info) {
+  EchoService* service = static_cast<EchoService*>(info.Data().As<External>()->Value());
+  int value = info[0]->Int32Value(info.GetIsolate()->GetCurrentContext()).FromJust();
+  info.GetReturnValue().Set(EchoCoroutine(service, value).promise());
+}
+
+// The same by hand: a Resolver kept in a Global of a heap allocated task
+// that is posted when the echo comes back.
+class ResolveTask : public InjectedTask {
+ public:
+  ResolveTask(Isolate* isolate, Local<Promise::Resolver> resolver,
+              TaskInjector* injector)
+      : resolver_(isolate, resolver), injector_(injector) {}
+
+  void Complete(int value) {
+    value_ = value;
+    injector_->Post(std::unique_ptr<InjectedTask>(this));
+  }
+
+  void Run(Isolate* isolate) override {
+    injector_->UnrefFromTask();
+    Local<Context> context = isolate->GetCurrentContext();
+    resolver_.Get(isolate)->Resolve(context, Integer::New(isolate, value_))
+        .Check();
+  }
+
+ private:
+  Global<Promise::Resolver> resolver_;
+  TaskInjector* injector_;
+  int value_ = 0;
+};
+
+void EchoResolver(const FunctionCallbackInfo<Value>& info) {
+  EchoService* service = static_cast<EchoService*>(info.Data().As<External>()->Value());
+  Isolate* isolate = info.GetIsolate();
+  Local<Context> context = isolate->GetCurrentContext();
+  int value = info[0]->Int32Value(context).FromJust();
+  Local<Promise::Resolver> resolver = Promise::Resolver::New(context).ToLocalChecked();
+  service->injector()->Ref();
+  service->Submit([](void* data, int value) {
+    static_cast<ResolveTask*>(data)->Complete(value);
+  }, new ResolveTask(isolate, resolver, service->injector()), value);
+  info.GetReturnValue().Set(resolver->GetPromise());
+}
+
+// An async JavaScript function awaits 1M echoes one after another, each a
+// round trip from the isolate's thread to the echo thread and back. Reports
+// round trips per second and allocations per await, for PromiseTask and for
+// hand written Resolver plumbing.
+TEST_F(PromiseTaskTest, Benchmark) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  TaskInjector injector(isolate_);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+  loop.SetTaskInjector(&injector);
+  EchoService service(&injector);
+  SetFunction(context, "echoCoroutine", EchoCoroutine, &service);
+  SetFunction(context, "echoResolver", EchoResolver, &service);
+  RunScript(context,
+      "async function run(echo, n) {"
+      "  let sum = 0;"
+      "  for (let i = 0; i < n; i++) {"
+      "    sum += await echo(i & 1023);"
+      "  }"
+      "  return sum;"
+      "}");
+
+  const int round_trips = 1000000;
+  uint64_t expected_sum = 0;
+  for (int i = 0; i < round_trips; i++) {
+    expected_sum += i & 1023;
+  }
+  const char* names[] = {"echoCoroutine", "echoResolver"};
+  for (const char* name : names) {
+    // Warm up, so that caches (the coroutine frame cache too) are filled.
+    std::string warm_up = std::string("run(") + name + ", 10000);";
+    RunScript(context, warm_up.c_str());
+    loop.Run();
+
+    std::string js = std::string("var sum; run(") + name + ", " +
+                     std::to_string(round_trips) + ").then(s => sum = s);";
+    uint64_t allocations_before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    RunScript(context, js.c_str());
+    loop.Run();
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    uint64_t count = allocations.load() - allocations_before;
+    EXPECT_EQ(std::to_string(expected_sum), RunToString(context, "String(sum)"));
+    std::cout << name << ": " << round_trips / ms * 1000 << " round trips/s, "
+              << static_cast<double>(count) / round_trips
+              << " allocations per await\n";
+  }
+}
@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/memory-usage.h"
+#include "../src/shared-backing-store.h"
+
+using namespace v8;
+
+class SharedBackingStoreTest : public V8TestFixture {
+};
+
+// A dataset of size bytes, byte i being i % 251, and a count of how often
+// datasets were freed.
+static std::atomic<int> datasets_freed{0};
+
+static void FreeDataset(void* data, size_t length, void* deleter_data) {
+  free(data);
+  datasets_freed++;
+}
+
+static std::shared_ptr<BackingStore> NewDataset(size_t size) {
+  char* data = static_cast<char*>(malloc(size));
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<char>(i % 251);
+  }
+  return SharedBackingStores::Wrap(data, size, FreeDataset, nullptr);
+}
+
+// Sums one byte of every page of the global Uint8Array data, touching all
+// of them.
+static int64_t SumPages(Isolate* isolate, Local<Context> context) {
+  const char* js =
+      "(function() {"
+      "  let sum = 0;"
+      "  for (let i = 0; i < data.length; i += 4096) {"
+      "    sum += data[i];"
+      "  }"
+      "  return sum;"
+      "})()";
+  Local<Script> script = Script::Compile(context,
+      String::NewFromUtf8(isolate, js).ToLocalChecked()).ToLocalChecked();
+  return script->Run(context).ToLocalChecked()->IntegerValue(context).FromJust();
+}
+
+static void SetData(Isolate* isolate, Local<Context> context,
+                    Local<ArrayBuffer> buffer) {
+  context->Global()->Set(context, String::NewFromUtf8Literal(isolate, "data"),
+      Uint8Array::New(buffer, 0, buffer->ByteLength())).Check();
+}
+
+TEST_F(SharedBackingStoreTest, OneStoreForAllIsolates) {
+  SharedBackingStores stores;
+  int freed_before = datasets_freed;
+  auto create = [] { return NewDataset(1 << 20); };
+  Isolate* other = Isolate::New(create_params_);
+  {
+    Isolate::Scope isolate_scope(isolate_);
+    const HandleScope handle_scope(isolate_);
+    Local<Context> context = Context::New(isolate_);
+    Context::Scope context_scope(context);
+    Local<ArrayBuffer> buffer = stores.NewArrayBuffer(isolate_, "dataset", create);
+    SetData(isolate_, context, buffer);
+    int64_t sum = SumPages(isolate_, context);
+    {
+      Isolate::Scope other_scope(other);
+      const HandleScope other_handle_scope(other);
+      Local<Context> other_context = Context::New(other);
+      Context::Scope other_context_scope(other_context);
+      Local<ArrayBuffer> other_buffer = stores.NewArrayBuffer(other, "dataset", create);
+      EXPECT_EQ(buffer->GetBackingStore()->Data(),
+                other_buffer->GetBackingStore()->Data());
+      SetData(other, other_context, other_buffer);
+      EXPECT_EQ(sum, SumPages(other, other_context));
+    }
+    EXPECT_EQ(1u, stores.loads());
+    EXPECT_EQ(1u, stores.live());
+    buffer->Detach();
+  }
+  // Still used by the other isolate.
+  EXPECT_EQ(freed_before, datasets_freed);
+  EXPECT_EQ(1u, stores.live());
+  other->Dispose();
+  EXPECT_EQ(freed_before + 1, datasets_freed);
+  EXPECT_EQ(0u, stores.live());
+}
+
+// Threads with an isolate each repeatedly get the dataset, read it from
+// JavaScript and drop it again, by detaching, by garbage collection or by
+// disposing their isolate. Meant to be run under ASAN (see the Makefile).
+TEST_F(SharedBackingStoreTest, Stress) {
+  SharedBackingStores stores;
+  int freed_before = datasets_freed;
+  const int threads = 8;
+  const int rounds = 200;
+  std::vector<std::thread> workers;
+  std::atomic<int> mismatches{0};
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([t, &stores, &mismatches] {
+      Isolate* isolate = Isolate::New(create_params_);
+      {
+        Isolate::Scope isolate_scope(isolate);
+        const HandleScope handle_scope(isolate);
+        Local<Context> context = Context::New(isolate);
+        Context::Scope context_scope(context);
+        int64_t expected = -1;
+        for (int round = 0; round < rounds; round++) {
+          HandleScope round_scope(isolate);
+          std::string name = "dataset" + std::to_string(round % 3);
+          Local<ArrayBuffer> buffer = stores.NewArrayBuffer(isolate, name, [] {
+            return NewDataset(256 * 1024);
+          });
+          SetData(isolate, context, buffer);
+          int64_t sum = SumPages(isolate, context);
+          if (expected == -1) {
+            expected = sum;
+          } else if (sum != expected) {
+            mismatches++;
+          }
+          if ((round + t) % 4 == 0) {
+            buffer->Detach();
+          } else if ((round + t) % 7 == 0) {
+            isolate->LowMemoryNotification();
+          }
+        }
+      }
+      isolate->Dispose();
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  EXPECT_EQ(0, mismatches);
+  EXPECT_EQ(0u, stores.live());
+  // Every store that was loaded was freed, once.
+  EXPECT_EQ(static_cast<int>(stores.loads()), datasets_freed - freed_before);
+}
+
+// RSS of 64 isolates that each read the whole dataset, sharing one store
+// and with a copy each. The dataset is 16MB unless
+// SHARED_BACKING_STORE_BENCHMARK_MB says otherwise.
+TEST_F(SharedBackingStoreTest, RssWith64Isolates) {
+  size_t megabytes = 16;
+  if (const char* env = getenv("SHARED_BACKING_STORE_BENCHMARK_MB")) {
+    megabytes = strtoul(env, nullptr, 10);
+  }
+  const size_t size = megabytes << 20;
+  const int isolate_count = 64;
+
+  for (int shared = 1; shared >= 0; shared--) {
+    SharedBackingStores stores;
+    std::shared_ptr<BackingStore> original = NewDataset(size);
+    std::vector<Isolate*> isolates;
+    size_t rss_before = CurrentRssBytes();
+    int64_t expected = -1;
+    for (int i = 0; i < isolate_count; i++) {
+      Isolate* isolate = Isolate::New(create_params_);
+      isolates.push_back(isolate);
+      Isolate::Scope isolate_scope(isolate);
+      const HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      Local<ArrayBuffer> buffer;
+      if (shared) {
+        buffer = stores.NewArrayBuffer(isolate, "dataset", [&original] {
+          return original;
+        });
+      } else {
+        buffer = ArrayBuffer::New(isolate, size);
+        memcpy(buffer->GetBackingStore()->Data(), original->Data(), size);
+      }
+      SetData(isolate, context, buffer);
+      int64_t sum = SumPages(isolate, context);
+      if (expected == -1) {
+        expected = sum;
+      }
+      EXPECT_EQ(expected, sum);
+    }
+    size_t rss_after = CurrentRssBytes();
+    std::cout << (shared ? "shared store" : "copy each   ") << ": "
+              << isolate_count << " isolates, rss delta "
+              << (static_cast<long>(rss_after) - static_cast<long>(rss_before)) / 1024
+              << " KB for a " << size / 1024 << " KB dataset\n";
+    for (Isolate* isolate : isolates) {
+      isolate->Dispose();
+    }
+    original.reset();
+    EXPECT_EQ(0u, stores.live());
+  }
+}
@@ -0,0 +1,277 @@
+#include <time.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/shared-channel.h"
+
+using namespace v8;
+
+class SharedChannelTest : public V8TestFixture {
+ protected:
+  static Local<Value> RunScript(Local<Context> context, const char* js) {
+    Isolate* isolate = context->GetIsolate();
+    Local<String> source = String::NewFromUtf8(isolate, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    return script->Run(context).ToLocalChecked();
+  }
+
+  // A clock that is the same for all threads, in milliseconds.
+  static void Now(const FunctionCallbackInfo<Value>& args) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    args.GetReturnValue().Set(ts.tv_sec * 1e3 + ts.tv_nsec / 1e6);
+  }
+
+  // A context with the SharedChannel class, now() and the channel in
+  // backing_store as `channel`.
+  static Local<Context> NewChannelContext(
+      Isolate* isolate, const std::shared_ptr<BackingStore>& backing_store) {
+    Local<Context> context = Context::New(isolate);
+    Context::Scope context_scope(context);
+    SharedChannel::Install(context);
+    Local<Object> global = context->Global();
+    global->Set(context, String::NewFromUtf8Literal(isolate, "channel"),
+                SharedChannel::NewEndpoint(context, backing_store)
+                    .ToLocalChecked()).Check();
+    global->Set(context, String::NewFromUtf8Literal(isolate, "now"),
+                Function::New(context, Now).ToLocalChecked()).Check();
+    return context;
+  }
+};
+
+TEST_F(SharedChannelTest, NativeWrapAround) {
+  SharedChannel producer(64);
+  std::unique_ptr<SharedChannel> consumer_end =
+      SharedChannel::FromBackingStore(producer.backing_store());
+  ASSERT_TRUE(consumer_end);
+  SharedChannel& consumer = *consumer_end;
+  EXPECT_EQ(64, producer.capacity());
+
+  std::string message;
+  EXPECT_FALSE(consumer.TryReceive(&message));
+  for (int i = 0; i < 100; i++) {
+    std::string sent(i % 30, static_cast<char>('a' + i % 26));
+    ASSERT_TRUE(producer.TrySend(sent.data(), sent.size())) << i;
+    ASSERT_TRUE(consumer.TryReceive(&message)) << i;
+    EXPECT_EQ(sent, message);
+  }
+  EXPECT_EQ(0, producer.size());
+
+  // Full.
+  std::string big(40, 'x');
+  EXPECT_TRUE(producer.TrySend(big.data(), big.size()));
+  EXPECT_FALSE(producer.TrySend(big.data(), big.size()));
+  // Never fits.
+  std::string too_big(100, 'x');
+  EXPECT_FALSE(producer.Send(too_big.data(), too_big.size()));
+
+  producer.Close();
+  EXPECT_TRUE(consumer.closed());
+  EXPECT_FALSE(producer.TrySend("a", 1));
+  EXPECT_TRUE(consumer.Receive(&message));
+  EXPECT_EQ(big, message);
+  EXPECT_FALSE(consumer.Receive(&message));
+}
+
+// Messages up to max_send are sent after a smaller one, with the head at
+// any offset, instead of waiting for room that never comes.
+TEST_F(SharedChannelTest, SendAfterSmallMessage) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  SharedChannel channel(64);
+  EXPECT_EQ(28, channel.max_send());
+  std::string message;
+  std::string large(channel.max_send(), 'x');
+  for (int i = 0; i < 16; i++) {
+    std::string small(i, 's');
+    ASSERT_TRUE(channel.Send(small.data(), small.size()));
+    ASSERT_TRUE(channel.TryReceive(&message));
+    ASSERT_TRUE(channel.Send(large.data(), large.size())) << i;
+    ASSERT_TRUE(channel.TryReceive(&message));
+    EXPECT_EQ(large, message);
+  }
+  std::string too_large(56, 'x');
+  EXPECT_TRUE(channel.Send("abcd", 4));
+  EXPECT_TRUE(channel.TryReceive(&message));
+  EXPECT_FALSE(channel.Send(too_large.data(), too_large.size()));
+
+  Local<Context> context = NewChannelContext(isolate_, channel.backing_store());
+  Context::Scope context_scope(context);
+  EXPECT_TRUE(RunScript(context,
+      "let ok = true;"
+      "for (let i = 0; i < 16; i++) {"
+      "  channel.send(new Uint8Array(i));"
+      "  channel.tryReceive();"
+      "  channel.send(new Uint8Array(28).fill(i));"
+      "  ok = ok && channel.tryReceive().every(b => b === i);"
+      "}"
+      "try {"
+      "  channel.send(new Uint8Array(4));"
+      "  channel.tryReceive();"
+      "  channel.send(new Uint8Array(56));"
+      "  ok = false;"
+      "} catch (e) {"
+      "  ok = ok && e instanceof RangeError;"
+      "}"
+      "ok")->IsTrue());
+}
+
+TEST_F(SharedChannelTest, RejectsOtherSizes) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  std::unique_ptr<BackingStore> odd =
+      SharedArrayBuffer::NewBackingStore(isolate_, SharedChannel::kHeaderSize + 100);
+  EXPECT_FALSE(SharedChannel::FromBackingStore(std::move(odd)));
+  std::unique_ptr<BackingStore> header_only =
+      SharedArrayBuffer::NewBackingStore(isolate_, SharedChannel::kHeaderSize);
+  EXPECT_FALSE(SharedChannel::FromBackingStore(std::move(header_only)));
+  std::unique_ptr<BackingStore> good =
+      SharedArrayBuffer::NewBackingStore(isolate_, SharedChannel::kHeaderSize + 256);
+  EXPECT_TRUE(SharedChannel::FromBackingStore(std::move(good)));
+
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  SharedChannel::Install(context);
+  EXPECT_TRUE(RunScript(context,
+      "try {"
+      "  new SharedChannel(new SharedArrayBuffer(128 + 100));"
+      "  false;"
+      "} catch (e) {"
+      "  e instanceof RangeError;"
+      "}")->IsTrue());
+}
+
+// A JavaScript end that is already blocked in receive when the C++ end
+// first sends, or closes, is still woken up.
+TEST_F(SharedChannelTest, NativeWakesBlockedJavaScript) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  SharedChannel channel(1024);
+  Local<Context> context = NewChannelContext(isolate_, channel.backing_store());
+  Context::Scope context_scope(context);
+
+  std::thread native([&channel] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    channel.Send("abc", 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    channel.Close();
+  });
+  EXPECT_TRUE(RunScript(context, "channel.receive().join()")->StrictEquals(
+      String::NewFromUtf8Literal(isolate_, "97,98,99")));
+  EXPECT_TRUE(RunScript(context, "channel.receive()")->IsUndefined());
+  native.join();
+}
+
+TEST_F(SharedChannelTest, JavaScriptAndNative) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  SharedChannel channel(1024);
+  Local<Context> context = NewChannelContext(isolate_, channel.backing_store());
+  Context::Scope context_scope(context);
+
+  RunScript(context,
+      "channel.send(new Uint8Array([104, 105]));"
+      "channel.trySend(new Uint8Array(0));"
+      "channel.send(new Uint8Array(300).fill(7));");
+  std::string message;
+  ASSERT_TRUE(channel.TryReceive(&message));
+  EXPECT_EQ("hi", message);
+  ASSERT_TRUE(channel.TryReceive(&message));
+  EXPECT_EQ("", message);
+  ASSERT_TRUE(channel.TryReceive(&message));
+  EXPECT_EQ(std::string(300, 7), message);
+  EXPECT_FALSE(channel.TryReceive(&message));
+
+  EXPECT_TRUE(channel.Send("abc", 3));
+  EXPECT_TRUE(RunScript(context, "channel.tryReceive().join()")->StrictEquals(
+      String::NewFromUtf8Literal(isolate_, "97,98,99")));
+  EXPECT_TRUE(RunScript(context, "channel.tryReceive()")->IsUndefined());
+  channel.Close();
+  EXPECT_TRUE(RunScript(context, "channel.receive()")->IsUndefined());
+  EXPECT_TRUE(RunScript(context, "channel.send(new Uint8Array(1))")->IsFalse());
+}
+
+// A producer and a consumer isolate on two threads. Every message carries
+// the time it was sent, the consumer records how long it took to arrive.
+TEST_F(SharedChannelTest, Benchmark) {
+  const int messages = 500000;
+  // No C++ end, so that the JavaScript ends wait without polling.
+  std::shared_ptr<BackingStore> channel = SharedChannel::NewBackingStore(64 * 1024);
+
+  std::thread consumer([&channel, messages] {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      const HandleScope handle_scope(isolate);
+      Local<Context> context = NewChannelContext(isolate, channel);
+      Context::Scope context_scope(context);
+      auto start = std::chrono::steady_clock::now();
+      Local<Value> result = RunScript(context,
+          "var latencies = [], message, count = 0;"
+          "while ((message = channel.receive()) !== undefined) {"
+          "  var sent = new Float64Array(message.buffer, 0, 1)[0];"
+          "  if (count++ % 16 == 0) latencies.push(now() - sent);"
+          "}"
+          "latencies.sort((a, b) => a - b);"
+          "var n = latencies.length;"
+          "[count, latencies[n >> 1] * 1000, latencies[Math.floor(n * 0.99)] * 1000,"
+          " latencies[n - 1] * 1000].join()");
+      double ms = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start).count();
+      String::Utf8Value stats(isolate, result);
+      std::cout << "JavaScript to JavaScript: " << messages / ms * 1000
+                << " messages/s, received,p50,p99,max(us) " << *stats << '\n';
+      EXPECT_EQ(messages, std::stoi(*stats));
+    }
+    isolate->Dispose();
+  });
+
+  std::thread producer([&channel, messages] {
+    Isolate* isolate = Isolate::New(create_params_);
+    {
+      Isolate::Scope isolate_scope(isolate);
+      const HandleScope handle_scope(isolate);
+      Local<Context> context = NewChannelContext(isolate, channel);
+      Context::Scope context_scope(context);
+      std::string js =
+          "var message = new Uint8Array(64);"
+          "var time = new Float64Array(message.buffer, 0, 1);"
+          "for (var i = 0; i < " + std::to_string(messages) + "; i++) {"
+          "  time[0] = now();"
+          "  channel.send(message);"
+          "}"
+          "channel.close();";
+      RunScript(context, js.c_str());
+    }
+    isolate->Dispose();
+  });
+  producer.join();
+  consumer.join();
+
+  // The same with C++ at both ends.
+  SharedChannel native(64 * 1024);
+  std::unique_ptr<SharedChannel> native_peer_end =
+      SharedChannel::FromBackingStore(native.backing_store());
+  SharedChannel& native_peer = *native_peer_end;
+  auto start = std::chrono::steady_clock::now();
+  std::thread native_consumer([&native_peer] {
+    std::string message;
+    while (native_peer.Receive(&message)) {
+    }
+  });
+  char message[64] = {};
+  for (int i = 0; i < messages; i++) {
+    native.Send(message, sizeof(message));
+  }
+  native.Close();
+  native_consumer.join();
+  double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+  std::cout << "C++ to C++: " << messages / ms * 1000 << " messages/s\n";
+}
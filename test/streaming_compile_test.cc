@@ -0,0 +1,142 @@
+#include <chrono>
+#include <iostream>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/streaming-compile.h"
+
+using namespace v8;
+
+class StreamingCompileTest : public V8TestFixture {
+ protected:
+  std::string WriteTempFile(const std::string& content) {
+    char tmpl[] = "/tmp/streaming_compile_test_XXXXXX";
+    int fd = mkstemp(tmpl);
+    EXPECT_NE(fd, -1);
+    EXPECT_EQ(write(fd, content.data(), content.size()),
+              static_cast<ssize_t>(content.size()));
+    close(fd);
+    return tmpl;
+  }
+};
+
+static std::string LargeScript(int functions) {
+  std::string js;
+  for (int i = 0; i < functions; i++) {
+    std::string n = std::to_string(i);
+    js += "function f" + n + "(a, b) { let s = 0; for (let i = 0; i < a; i++) {"
+          " s += (i * b) % " + n + " + 1; } return s; }\n";
+  }
+  js += "f1(2, 3);";
+  return js;
+}
+
+TEST_F(StreamingCompileTest, CompileAndRun) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+
+  // Small chunks so that the script spans several of them.
+  std::string path = WriteTempFile("var a = 'åäö';\nvar b = 18;\na + b;");
+  StreamingCompile compile(isolate_, platform_.get(), path, 4);
+  ASSERT_TRUE(compile.Start());
+  Local<Script> script = compile.Finish(context,
+      String::NewFromUtf8Literal(isolate_, "test.js")).ToLocalChecked();
+  String::Utf8Value value(isolate_, script->Run(context).ToLocalChecked());
+  EXPECT_STREQ("åäö18", *value);
+  unlink(path.c_str());
+}
+
+TEST_F(StreamingCompileTest, SyntaxError) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+
+  std::string path = WriteTempFile("var a = ;");
+  StreamingCompile compile(isolate_, platform_.get(), path);
+  ASSERT_TRUE(compile.Start());
+  TryCatch try_catch(isolate_);
+  EXPECT_TRUE(compile.Finish(context,
+      String::NewFromUtf8Literal(isolate_, "test.js")).IsEmpty());
+  EXPECT_TRUE(try_catch.HasCaught());
+  unlink(path.c_str());
+}
+
+TEST_F(StreamingCompileTest, MissingFile) {
+  StreamingCompile compile(isolate_, platform_.get(), "/nonexistent/file.js");
+  EXPECT_FALSE(compile.Start());
+}
+
+TEST_F(StreamingCompileTest, BlockedTime) {
+  Isolate::Scope isolate_scope(isolate_);
+  const std::string js = LargeScript(50000);
+  std::string path = WriteTempFile(js);
+  using ms = std::chrono::duration<double, std::milli>;
+
+  // Each compile uses a new isolate so that the compilation cache does not
+  // turn the second one into a lookup.
+  auto synchronous = [&]() {
+    Isolate* isolate = Isolate::New(create_params_);
+    double blocked;
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      auto start = std::chrono::steady_clock::now();
+      Local<String> source = ReadFileMapped(isolate, path.c_str()).ToLocalChecked();
+      ScriptOrigin origin(String::NewFromUtf8Literal(isolate, "test.js"));
+      ScriptCompiler::Source script_source(source, origin);
+      EXPECT_FALSE(ScriptCompiler::Compile(context, &script_source).IsEmpty());
+      blocked = ms(std::chrono::steady_clock::now() - start).count();
+    }
+    isolate->Dispose();
+    return blocked;
+  };
+
+  // The main thread runs a script for work_ms between Start and Finish,
+  // which is what it would have been doing instead of waiting for the
+  // parse.
+  auto streaming = [&](double work_ms, double* total) {
+    Isolate* isolate = Isolate::New(create_params_);
+    double blocked;
+    {
+      Isolate::Scope isolate_scope(isolate);
+      HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      StreamingCompile compile(isolate, platform_.get(), path);
+      EXPECT_TRUE(compile.Start());
+      std::string work = "const end = Date.now() + " + std::to_string(work_ms) +
+          "; let n = 0; while (Date.now() < end) n++; n";
+      Local<String> work_source =
+          String::NewFromUtf8(isolate, work.c_str()).ToLocalChecked();
+      EXPECT_FALSE(Script::Compile(context, work_source).ToLocalChecked()
+                       ->Run(context).IsEmpty());
+      EXPECT_FALSE(compile.Finish(context,
+          String::NewFromUtf8Literal(isolate, "test.js")).IsEmpty());
+      blocked = compile.blocked_ms();
+      *total = compile.total_ms();
+    }
+    isolate->Dispose();
+    return blocked;
+  };
+
+  double sync_ms = synchronous();
+  // As long as the synchronous compile, so the parse can be done by the
+  // time the main thread gets to Finish.
+  double work_ms = sync_ms;
+  double total_ms;
+  double blocked_ms = streaming(work_ms, &total_ms);
+  std::cout << "script size: " << js.size() << " bytes\n";
+  std::cout << "synchronous: main thread blocked " << sync_ms << " ms\n";
+  std::cout << "streaming:   main thread blocked " << blocked_ms
+            << " ms in Finish, after " << work_ms << " ms of other work; "
+            << total_ms << " ms from Start to Finish\n";
+  // Only finalizing is left for the main thread.
+  EXPECT_LT(blocked_ms, sync_ms);
+  unlink(path.c_str());
+}
@@ -1,8 +1,13 @@
+#include <stdlib.h>
 #include <iostream>
+#include <string>
+#include <vector>
 #include "gtest/gtest.h"
 #include "v8.h"
 #include "libplatform/libplatform.h"
 #include "v8_test_fixture.h"
+#include "../src/memory-usage.h"
+#include "../src/shared-string-table.h"
 
 using namespace v8;
 
@@ -85,3 +90,99 @@ TEST_F(StringTest, compare) {
   v8::String::Utf8Value second_utf8(isolate_, second);
   EXPECT_STREQ(*first_utf8, *second_utf8);
 }
+
+TEST_F(StringTest, sharedExternal) {
+  SharedStringTable table;
+  Isolate* other = Isolate::New(create_params_);
+  {
+    Isolate::Scope isolate_scope(isolate_);
+    const v8::HandleScope handle_scope(isolate_);
+    Local<String> str = table.NewString(isolate_, "template", [] {
+      return std::string("<p>{{name}}</p>");
+    }).ToLocalChecked();
+    EXPECT_EQ(str->Length(), 15);
+    EXPECT_EQ(str->IsOneByte(), true);
+    EXPECT_EQ(str->IsExternalOneByte(), true);
+    EXPECT_STREQ("<p>{{name}}</p>", *String::Utf8Value(isolate_, str));
+
+    Local<String> wide = table.NewString(isolate_, "wide", [] {
+      return std::string("\xe2\x82\xac 5");
+    }).ToLocalChecked();
+    EXPECT_EQ(wide->Length(), 3);
+    EXPECT_EQ(wide->IsExternal(), true);
+    EXPECT_EQ(wide->IsExternalOneByte(), false);
+
+    EXPECT_TRUE(table.NewString(isolate_, "invalid", [] {
+      return std::string("\xff");
+    }).IsEmpty());
+    {
+      Isolate::Scope other_scope(other);
+      const v8::HandleScope other_handle_scope(other);
+      Local<String> other_str = table.NewString(other, "template", [] {
+        return std::string("not loaded again");
+      }).ToLocalChecked();
+      EXPECT_EQ(other_str->IsExternalOneByte(), true);
+      // The same characters, not a copy.
+      EXPECT_EQ(str->GetExternalOneByteStringResource()->data(),
+                other_str->GetExternalOneByteStringResource()->data());
+    }
+    EXPECT_EQ(2u, table.loads());
+    EXPECT_EQ(2u, table.live());
+  }
+  other->Dispose();
+  // The strings in isolate_ are garbage now.
+  isolate_->LowMemoryNotification();
+  EXPECT_EQ(0u, table.live());
+}
+
+// RSS of 32 isolates that each keep a constant string, copied into every
+// heap and shared from the table. The string is 8MB unless
+// STRING_TABLE_BENCHMARK_MB says otherwise.
+TEST_F(StringTest, sharedExternalMemory) {
+  size_t megabytes = 8;
+  if (const char* env = getenv("STRING_TABLE_BENCHMARK_MB")) {
+    megabytes = strtoul(env, nullptr, 10);
+  }
+  std::string text;
+  text.reserve(megabytes << 20);
+  while (text.size() < megabytes << 20) {
+    text += "<li class=\"item\">{{item.name}}: {{item.value}}</li>\n";
+  }
+  const int isolate_count = 32;
+
+  for (int shared = 1; shared >= 0; shared--) {
+    SharedStringTable table;
+    std::vector<Isolate*> isolates;
+    size_t rss_before = CurrentRssBytes();
+    for (int i = 0; i < isolate_count; i++) {
+      Isolate* isolate = Isolate::New(create_params_);
+      isolates.push_back(isolate);
+      Isolate::Scope isolate_scope(isolate);
+      const v8::HandleScope handle_scope(isolate);
+      Local<Context> context = Context::New(isolate);
+      Context::Scope context_scope(context);
+      Local<String> str;
+      if (shared) {
+        str = table.NewString(isolate, "template", [&text] {
+          return text;
+        }).ToLocalChecked();
+        EXPECT_EQ(str->IsExternalOneByte(), true);
+      } else {
+        str = String::NewFromUtf8(isolate, text.data(), NewStringType::kNormal,
+                                  static_cast<int>(text.size())).ToLocalChecked();
+        EXPECT_EQ(str->IsExternalOneByte(), false);
+      }
+      context->Global()->Set(context,
+          String::NewFromUtf8Literal(isolate, "template"), str).Check();
+    }
+    size_t rss_after = CurrentRssBytes();
+    std::cout << (shared ? "shared table" : "copy each   ") << ": "
+              << isolate_count << " isolates, rss delta "
+              << (static_cast<long>(rss_after) - static_cast<long>(rss_before)) / 1024
+              << " KB for a " << text.size() / 1024 << " KB string\n";
+    for (Isolate* isolate : isolates) {
+      isolate->Dispose();
+    }
+    EXPECT_EQ(0u, table.live());
+  }
+}
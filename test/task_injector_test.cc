@@ -0,0 +1,237 @@
+#include <poll.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "v8.h"
+#include "libplatform/libplatform.h"
+#include "v8_test_fixture.h"
+#include "../src/event-loop.h"
+#include "../src/histogram.h"
+#include "../src/task-injector.h"
+
+using namespace v8;
+
+class TaskInjectorTest : public V8TestFixture {
+ protected:
+  Local<Value> RunScript(Local<Context> context, const char* js) {
+    Local<String> source = String::NewFromUtf8(isolate_, js).ToLocalChecked();
+    Local<Script> script = Script::Compile(context, source).ToLocalChecked();
+    return script->Run(context).ToLocalChecked();
+  }
+
+  std::string RunToString(Local<Context> context, const char* js) {
+    String::Utf8Value value(isolate_, RunScript(context, js));
+    return *value;
+  }
+};
+
+// Calls the global function `onResult` with a value computed on another
+// thread.
+class ResultTask : public InjectedTask {
+ public:
+  explicit ResultTask(int value) : value_(value) {}
+
+  void Run(Isolate* isolate) override {
+    Local<Context> context = isolate->GetCurrentContext();
+    Local<Value> callback = context->Global()->Get(context,
+        String::NewFromUtf8Literal(isolate, "onResult")).ToLocalChecked();
+    Local<Value> argv[] = {Integer::New(isolate, value_)};
+    callback.As<Function>()->Call(context, context->Global(), 1, argv)
+        .ToLocalChecked();
+  }
+
+ private:
+  int value_;
+};
+
+TEST_F(TaskInjectorTest, EventLoopRunsInjectedTasks) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  TaskInjector injector(isolate_);
+  EventLoop loop(isolate_, platform_.get());
+  loop.Install(context);
+  loop.SetTaskInjector(&injector);
+
+  RunScript(context,
+      "var log = [];"
+      "function onResult(value) {"
+      "  log.push(value);"
+      "  Promise.resolve().then(() => log.push('then ' + value));"
+      "}"
+      "setTimeout(() => log.push('timeout'), 5);");
+
+  injector.Ref();
+  std::thread worker([&injector] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    injector.Post(std::unique_ptr<InjectedTask>(new ResultTask(1)));
+    injector.Post(std::unique_ptr<InjectedTask>(new ResultTask(2)));
+    injector.Unref();
+  });
+  // Returns once the timer has fired and the worker has unreffed.
+  loop.Run();
+  worker.join();
+  // Microtasks run after each injected task, like after a timer.
+  EXPECT_EQ("timeout,1,then 1,2,then 2", RunToString(context, "log.join()"));
+}
+
+void CountMicrotask(void* data) {
+  (*static_cast<int*>(data))++;
+}
+
+TEST_F(TaskInjectorTest, PostMicrotask) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  TaskInjector injector(isolate_);
+
+  int count = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&injector, &count] {
+      for (int j = 0; j < 100; j++) {
+        injector.PostMicrotask(CountMicrotask, &count);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  pollfd fd = {injector.fd(), POLLIN, 0};
+  EXPECT_EQ(1, poll(&fd, 1, 0));
+  EXPECT_EQ(400, injector.Drain());
+  // Queued, not run.
+  EXPECT_EQ(0, count);
+  isolate_->PerformMicrotaskCheckpoint();
+  EXPECT_EQ(400, count);
+  EXPECT_EQ(0, poll(&fd, 1, 0));
+}
+
+// The task of the benchmark, which records how long it waited to be run.
+class TimedTask : public InjectedTask {
+ public:
+  explicit TimedTask(Histogram* latency)
+      : latency_(latency), posted_(std::chrono::steady_clock::now()) {}
+
+  void Run(Isolate* isolate) override {
+    latency_->Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - posted_).count()));
+  }
+
+ private:
+  Histogram* latency_;
+  std::chrono::steady_clock::time_point posted_;
+};
+
+// The usual alternative: a deque under a mutex, with a condition variable
+// to wake the consumer.
+class MutexTaskQueue {
+ public:
+  void Post(std::unique_ptr<InjectedTask> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+  // Waits for tasks and takes all of them.
+  void TakeAll(std::deque<std::unique_ptr<InjectedTask>>* out) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !tasks_.empty(); });
+    out->swap(tasks_);
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::unique_ptr<InjectedTask>> tasks_;
+};
+
+// 16 threads post tasks as fast as they can and the isolate's thread runs
+// them, through a TaskInjector and through a MutexTaskQueue. Reports
+// throughput and how long tasks waited to be run.
+TEST_F(TaskInjectorTest, Benchmark) {
+  Isolate::Scope isolate_scope(isolate_);
+  const HandleScope handle_scope(isolate_);
+  Local<Context> context = Context::New(isolate_);
+  Context::Scope context_scope(context);
+  const int producers = 16;
+  const int tasks_per_producer = 100000;
+  const size_t total = static_cast<size_t>(producers) * tasks_per_producer;
+
+  auto report = [total](const char* name, double ms, const Histogram& latency) {
+    std::cout << name << ": " << total / ms * 1000 << " tasks/s, latency p50 "
+              << latency.Percentile(50) / 1000.0 << "us p99 "
+              << latency.Percentile(99) / 1000.0 << "us max "
+              << latency.max() / 1000.0 << "us\n";
+  };
+
+  {
+    TaskInjector injector(isolate_);
+    Histogram latency;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; i++) {
+      threads.emplace_back([&injector, &latency, tasks_per_producer] {
+        for (int j = 0; j < tasks_per_producer; j++) {
+          injector.Post(std::unique_ptr<InjectedTask>(new TimedTask(&latency)));
+        }
+      });
+    }
+    size_t done = 0;
+    while (done < total) {
+      pollfd fd = {injector.fd(), POLLIN, 0};
+      poll(&fd, 1, -1);
+      done += injector.Drain();
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(total, done);
+    EXPECT_EQ(total, latency.count());
+    report("mpsc queue + eventfd", ms, latency);
+  }
+
+  {
+    MutexTaskQueue queue;
+    Histogram latency;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; i++) {
+      threads.emplace_back([&queue, &latency, tasks_per_producer] {
+        for (int j = 0; j < tasks_per_producer; j++) {
+          queue.Post(std::unique_ptr<InjectedTask>(new TimedTask(&latency)));
+        }
+      });
+    }
+    size_t done = 0;
+    std::deque<std::unique_ptr<InjectedTask>> tasks;
+    while (done < total) {
+      queue.TakeAll(&tasks);
+      for (std::unique_ptr<InjectedTask>& task : tasks) {
+        HandleScope task_scope(isolate_);
+        task->Run(isolate_);
+      }
+      done += tasks.size();
+      tasks.clear();
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(total, done);
+    report("mutex + condition variable", ms, latency);
+  }
+}